@@ -0,0 +1,2677 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <thread>
+
+#include "Benchmark.h"
+#include "BlockAccessor.h"
+#include "BlockTicker.h"
+#include "ChunkClient.h"
+#include "ChunkScheduler.h"
+#include "ChunkServer.h"
+#include "EditJournal.h"
+#include "FrameGovernor.h"
+#include "MeshCache.h"
+#include "Physics.h"
+#include "PngWriter.h"
+#include "Raymarcher.h"
+#include "Replay.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "VoxelDAG.h"
+#include "World.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+// Generates every chunk of the world up front instead of lazily while rendering.
+static void generate_all(World *world) {
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				world->generate(world->getChunk(x, y, z));
+}
+
+// Highest non-air block in the column at (x, z) found by walking down the column,
+// WORLD::NO_SURFACE if there is none.
+static int surface(World *world, int x, int z) {
+	for (int y = CHUNK::Y * (WORLD::Y / 2) - 1; y >= -CHUNK::Y * (WORLD::Y / 2); --y)
+		if (world->findChunk(x, y, z)->getBlock(x & (CHUNK::X - 1), y & (CHUNK::Y - 1), z & (CHUNK::Z - 1)))
+			return y;
+	return WORLD::NO_SURFACE;
+}
+
+// Pours water and drops sand over the terrain, then runs the block ticker at its fixed rate.
+// Arguments: [ticks] [threads]
+static int bench_ticks(int argc, char *argv[]) {
+	int ticks = argc > 0 ? atoi(argv[0]) : 400;
+	int threads = argc > 1 ? atoi(argv[1]) : 0;
+
+	World world;
+	ThreadPool pool(threads);
+	BlockTicker ticker(&world, &pool);
+
+	double t = now_ms();
+	generate_all(&world);
+	printf("generated %d chunks in %.1f ms\n", WORLD::X * WORLD::Y * WORLD::Z, now_ms() - t);
+
+	// Stay one chunk away from the world border
+	int lo = -CHUNK::X * (WORLD::X / 2 - 1);
+	int hi = CHUNK::X * (WORLD::X / 2 - 1);
+	int sources = 0, sand = 0;
+
+	for (int x = lo; x < hi; x += 3) {
+		for (int z = lo; z < hi; z += 3) {
+			int y = surface(&world, x, z) + 4;
+			if ((x / 3 + z / 3) & 1) {
+				world.setBlock(x, y, z, BLOCK::WATER);
+				++sources;
+			}
+			else {
+				for (int i = 0; i < 3; ++i)
+					world.setBlock(x, y + i, z, BLOCK::SAND);
+				sand += 3;
+			}
+			ticker.activate(x, y, z);
+		}
+	}
+
+	printf("%d water sources, %d sand blocks, %d threads, %d ticks at %d Hz\n", sources, sand, pool.size(), ticks, TICK::RATE);
+
+	double total = 0, worst = 0;
+	long cells = 0;
+	int peak = 0, over = 0;
+	static const double budget = 1000.0 / TICK::RATE;
+
+	for (int i = 0; i < ticks; ++i) {
+		t = now_ms();
+		ticker.tick();
+		t = now_ms() - t;
+
+		total += t;
+		if (t > worst)
+			worst = t;
+		if (t > budget)
+			++over;
+		cells += ticker.getActiveCells();
+		if (ticker.getActiveCells() > peak)
+			peak = ticker.getActiveCells();
+	}
+
+	printf("tick: avg %.3f ms, max %.3f ms, budget %.1f ms, %d over budget\n", total / ticks, worst, budget, over);
+	printf("active cells: avg %.0f, peak %d; %.0f cells/ms\n", (double)cells / ticks, peak, total > 0 ? cells / total : 0.0);
+	return over ? 1 : 0;
+}
+
+// Sweeps one box by delta and checks where it ends up and whether it was stopped.
+static int expect_sweep(const World &world, const char *name, const glm::vec3 &from, const glm::vec3 &half, const glm::vec3 &delta, const glm::vec3 &to, bool stopped) {
+	VoxelQuery query(&world);
+	bool hit[3];
+	glm::vec3 at = Physics::sweep(query, from, half, delta, hit);
+	bool any = hit[0] || hit[1] || hit[2];
+	if (glm::length(at - to) < 1e-3f && any == stopped)
+		return 0;
+
+	printf("%s: ended at (%.4f, %.4f, %.4f) %s, expected (%.4f, %.4f, %.4f) %s\n", name, at.x, at.y, at.z, any ? "stopped" : "free",
+		to.x, to.y, to.z, stopped ? "stopped" : "free");
+	return 1;
+}
+
+// Collision cases in an empty world with a few blocks placed: boxes sliding along faces
+// they touch, walls on chunk borders and at negative coordinates, moves longer than the
+// world is wide, and a box coming to rest on the floor. Returns the cases that failed.
+static int physics_cases() {
+	World world(1);
+	std::vector<uint8_t> air(CHUNK::X * CHUNK::Y * CHUNK::Z, BLOCK::AIR);
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				world.getChunk(x, y, z)->setBlocks(&air[0], 1);
+
+	// A floor at y = 0 from x = 0 to 7, a wall at x = 10 and walls on both sides of the
+	// chunk border at x = 16
+	for (int x = 0; x < 8; ++x)
+		world.setBlock(x, 0, 0, 6);
+	for (int y = 0; y < 4; ++y) {
+		world.setBlock(10, y, 4, 6);
+		world.setBlock(16, y, 8, 6);
+		world.setBlock(15, y, 12, 6);
+		world.setBlock(-17, y, -20, 6);
+		world.setBlock(0, y, 30, 6);
+	}
+	world.setBlock(-30, -17, -30, 6);
+
+	const float S = PHYSICS::SKIN;
+	glm::vec3 half(0.5f);
+	int failed = 0;
+
+	// Touching a face isn't overlapping it: sliding over the floor and along the wall
+	failed += expect_sweep(world, "slide on floor", glm::vec3(0.5f, 1.5f, 0.5f), half, glm::vec3(3, 0, 0), glm::vec3(3.5f, 1.5f, 0.5f), false);
+	failed += expect_sweep(world, "slide along wall", glm::vec3(9.5f, 1.5f, 2.5f), half, glm::vec3(0, 0, 4), glm::vec3(9.5f, 1.5f, 6.5f), false);
+	failed += expect_sweep(world, "push into touched wall", glm::vec3(9.5f, 1.5f, 4.5f), half, glm::vec3(1, 0, 0), glm::vec3(9.5f - S, 1.5f, 4.5f), true);
+
+	// Walls in the chunk past the border, and in the chunk before it
+	failed += expect_sweep(world, "wall after border", glm::vec3(12.5f, 1.5f, 8.5f), half, glm::vec3(10, 0, 0), glm::vec3(15.5f - S, 1.5f, 8.5f), true);
+	failed += expect_sweep(world, "wall before border", glm::vec3(20.5f, 1.5f, 12.5f), half, glm::vec3(-10, 0, 0), glm::vec3(16.5f + S, 1.5f, 12.5f), true);
+	failed += expect_sweep(world, "across border", glm::vec3(12.5f, 1.5f, 20.5f), half, glm::vec3(10, 0, 0), glm::vec3(22.5f, 1.5f, 20.5f), false);
+
+	// Negative coordinates, where truncating towards zero would be a block off
+	failed += expect_sweep(world, "negative x", glm::vec3(-10.5f, 1.5f, -19.5f), half, glm::vec3(-20, 0, 0), glm::vec3(-15.5f + S, 1.5f, -19.5f), true);
+	failed += expect_sweep(world, "negative y", glm::vec3(-29.5f, -10.5f, -29.5f), half, glm::vec3(0, -20, 0), glm::vec3(-29.5f, -15.5f + S, -29.5f), true);
+
+	// A move far longer than the box, through a one block wall
+	failed += expect_sweep(world, "tunnelling", glm::vec3(0.5f, 1.5f, 20.5f), half, glm::vec3(0, 0, 40), glm::vec3(0.5f, 1.5f, 29.5f - S), true);
+	failed += expect_sweep(world, "tunnelling back", glm::vec3(0.5f, 1.5f, 40.5f), half, glm::vec3(0, 0, -40), glm::vec3(0.5f, 1.5f, 31.5f + S), true);
+
+	// Dropped onto the floor, the box stays on it without sinking or bouncing
+	ThreadPool pool(1);
+	Physics physics(&world, &pool);
+	int id = physics.entities.add(glm::vec3(4.5f, 5.5f, 0.5f), glm::vec3(0.3f, 0.4f, 0.3f));
+	int resting = 0;
+	for (int i = 0; i < 100; ++i) {
+		physics.step(1.0f / TICK::RATE);
+		if (i >= 40)
+			resting += physics.entities.ground[id] && fabsf(physics.entities.py[id] - (1.4f + S)) < 1e-4f && physics.entities.vy[id] == 0;
+	}
+	if (resting != 60) {
+		printf("resting contact: at y %.4f, on the ground %d of the last 60 ticks\n", physics.entities.py[id], resting);
+		++failed;
+	}
+
+	return failed;
+}
+
+// Drops boxes onto the terrain and steps them with the physics module, after
+// checking collision cases.
+// Arguments: [entities] [ticks] [threads]
+static int bench_physics(int argc, char *argv[]) {
+	int count = argc > 0 ? atoi(argv[0]) : 10000;
+	int ticks = argc > 1 ? atoi(argv[1]) : 200;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+
+	int failed = physics_cases();
+	if (failed)
+		printf("%d collision cases failed\n", failed);
+
+	World world;
+	ThreadPool pool(threads);
+	Physics physics(&world, &pool);
+	generate_all(&world);
+
+	// Spread them over the world, a few blocks above ground
+	int lo = -CHUNK::X * (WORLD::X / 2 - 1);
+	int span = CHUNK::X * (WORLD::X - 2);
+	srand(1);
+	for (int i = 0; i < count; ++i) {
+		int x = lo + rand() % span;
+		int z = lo + rand() % span;
+		glm::vec3 position(x + 0.5f, surface(&world, x, z) + 2 + rand() % 8, z + 0.5f);
+		int id = physics.entities.add(position, glm::vec3(0.3f, 0.4f, 0.3f));
+		physics.entities.vx[id] = (rand() % 200 - 100) * 0.05f;
+		physics.entities.vz[id] = (rand() % 200 - 100) * 0.05f;
+	}
+
+	printf("%d entities, %d threads, %d ticks at %d Hz\n", count, pool.size(), ticks, TICK::RATE);
+
+	double total = 0, worst = 0;
+	for (int i = 0; i < ticks; ++i) {
+		double t = now_ms();
+		physics.step(1.0f / TICK::RATE);
+		t = now_ms() - t;
+
+		total += t;
+		if (t > worst)
+			worst = t;
+	}
+
+	int grounded = 0;
+	for (int i = 0; i < count; ++i)
+		grounded += physics.entities.ground[i];
+
+	printf("step: avg %.3f ms, max %.3f ms; %.0f entities/ms\n", total / ticks, worst, total > 0 ? (double)count * ticks / total : 0.0);
+	printf("%d of %d entities resting on the ground\n", grounded, count);
+	return failed ? 1 : 0;
+}
+
+// Generates a square of chunk columns and compares dense storage with a shared voxel DAG.
+// Arguments: [columns per side]
+static int bench_dag(int argc, char *argv[]) {
+	int columns = argc > 0 ? atoi(argv[0]) : 32;
+
+	std::vector<Chunk *> chunks;
+	for (int x = 0; x < columns; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < columns; ++z)
+				chunks.push_back(new Chunk(x - columns / 2, y - WORLD::Y / 2, z - columns / 2));
+
+	// Far chunks are generated and meshed before they get compacted
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	double t = now_ms();
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		chunks[i]->noise(0);
+		chunks[i]->mesh(&vertices[0]);
+	}
+	printf("generated and meshed %u chunks in %.1f ms\n", (unsigned)chunks.size(), now_ms() - t);
+
+	// Remember some blocks to check the round trip
+	static const int samples = 1000000;
+	std::vector<int> where(samples);
+	std::vector<uint8_t> expected(samples);
+	srand(1);
+	for (int i = 0; i < samples; ++i) {
+		where[i] = rand() % (int)chunks.size() * CHUNK::X * CHUNK::Y * CHUNK::Z + rand() % (CHUNK::X * CHUNK::Y * CHUNK::Z);
+		int c = where[i] / (CHUNK::X * CHUNK::Y * CHUNK::Z), b = where[i] % (CHUNK::X * CHUNK::Y * CHUNK::Z);
+		expected[i] = chunks[c]->getBlock(b / (CHUNK::Y * CHUNK::Z), b / CHUNK::Z % CHUNK::Y, b % CHUNK::Z);
+	}
+
+	VoxelDAG dag;
+	t = now_ms();
+	for (size_t i = 0; i < chunks.size(); ++i)
+		chunks[i]->compact(&dag);
+	double build = now_ms() - t;
+
+	// Point queries straight out of the DAG
+	int wrong = 0;
+	t = now_ms();
+	for (int i = 0; i < samples; ++i) {
+		int c = where[i] / (CHUNK::X * CHUNK::Y * CHUNK::Z), b = where[i] % (CHUNK::X * CHUNK::Y * CHUNK::Z);
+		wrong += chunks[c]->getBlock(b / (CHUNK::Y * CHUNK::Z), b / CHUNK::Z % CHUNK::Y, b % CHUNK::Z) != expected[i];
+	}
+	double query = now_ms() - t;
+
+	size_t dense = chunks.size() * CHUNK::X * CHUNK::Y * CHUNK::Z;
+	size_t sparse = dag.getBytes() + chunks.size() * sizeof(uint32_t);
+	double km2 = 1.0e6 / ((double)columns * CHUNK::X * columns * CHUNK::Z);
+
+	printf("dense: %u bytes, %.1f MB/km2\n", (unsigned)dense, dense * km2 / 1.0e6);
+	printf("dag:   %u bytes in %d nodes, %.2f MB/km2 (%.1fx smaller)\n", (unsigned)sparse, dag.getNodes(), sparse * km2 / 1.0e6, (double)dense / sparse);
+	printf("build %.1f ms (%.3f ms/chunk), %d point queries in %.1f ms (%.1f ns each)\n", build, build / chunks.size(), samples, query, query * 1.0e6 / samples);
+
+	t = now_ms();
+	for (size_t i = 0; i < chunks.size(); ++i)
+		chunks[i]->expand();
+	t = now_ms() - t;
+	printf("expand %.1f ms (%.3f ms/chunk), %d nodes left\n", t, t / chunks.size(), dag.getNodes());
+
+	for (int i = 0; i < samples; ++i) {
+		int c = where[i] / (CHUNK::X * CHUNK::Y * CHUNK::Z), b = where[i] % (CHUNK::X * CHUNK::Y * CHUNK::Z);
+		wrong += chunks[c]->getBlock(b / (CHUNK::Y * CHUNK::Z), b / CHUNK::Z % CHUNK::Y, b % CHUNK::Z) != expected[i];
+	}
+	if (wrong)
+		printf("%d blocks differ after the round trip\n", wrong);
+
+	for (size_t i = 0; i < chunks.size(); ++i)
+		delete chunks[i];
+	return wrong ? 1 : 0;
+}
+
+// Raymarches a view across the world and a top-down map of all of it.
+// Arguments: [width] [height] [threads] [png prefix]
+static int bench_raymarch(int argc, char *argv[]) {
+	int width = argc > 0 ? atoi(argv[0]) : 640;
+	int height = argc > 1 ? atoi(argv[1]) : 480;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	const char *prefix = argc > 3 ? argv[3] : 0;
+
+	World world(1);
+	ThreadPool pool(threads);
+	Raymarcher raymarcher(&world, &pool);
+	generate_all(&world);
+
+	float half = (float)CHUNK::X * (WORLD::X / 2);
+	std::vector<uint8_t> view, map;
+	int runs = 5;
+
+	double t = now_ms();
+	for (int i = 0; i < runs; ++i)
+		raymarcher.renderView(glm::vec3(-half, (float)CHUNK::Y, -half), glm::vec3(0, 0, 0), 1.0f, width, height, view);
+	t = now_ms() - t;
+	long long rays = raymarcher.getRays();
+	printf("view %dx%d on %d threads: %.1f ms/image, %.2f Mrays/s\n", width, height, pool.size(), t / runs, rays / t / 1000);
+
+	t = now_ms();
+	for (int i = 0; i < runs; ++i)
+		raymarcher.renderMap(-half, -half, 2 * half, height, map);
+	t = now_ms() - t;
+	rays = raymarcher.getRays() - rays;
+	printf("map %dx%d: %.1f ms/tile, %.2f Mrays/s\n", height, height, t / runs, rays / t / 1000);
+
+	if (prefix) {
+		write_png((std::string(prefix) + "view.png").c_str(), width, height, &view[0], false);
+		write_png((std::string(prefix) + "map.png").c_str(), height, height, &map[0], false);
+	}
+	return 0;
+}
+
+// Surface heights from the heightmap against walking down columns, checked against each
+// other after random edits that dig out and stack up blocks, and after sand has fallen.
+// Arguments: [queries]
+static int bench_heights(int argc, char *argv[]) {
+	int queries = argc > 0 ? atoi(argv[0]) : 1000000;
+
+	World world(1);
+	ThreadPool pool;
+	BlockTicker ticker(&world, &pool);
+	generate_all(&world);
+
+	int lo = -CHUNK::X * (WORLD::X / 2);
+	int size = CHUNK::X * WORLD::X;
+	srand(1);
+
+	for (int i = 0; i < 20000; ++i) {
+		int x = lo + rand() % size;
+		int z = lo + rand() % size;
+		int top = world.getHeight(x, z);
+		if (rand() % 3)
+			world.setBlock(x, top, z, BLOCK::AIR);
+		else if (top < -lo - 4)
+			world.setBlock(x, top + 1 + rand() % 3, z, rand() % 2 ? 6 : BLOCK::SAND);
+		ticker.activate(x, top + 2, z);
+	}
+
+	for (int i = 0; i < 100; ++i)
+		ticker.tick();
+
+	int wrong = 0;
+	for (int x = lo; x < lo + size; ++x)
+		for (int z = lo; z < lo + size; ++z)
+			wrong += world.getHeight(x, z) != surface(&world, x, z);
+
+	std::vector<int> xs(queries), zs(queries);
+	for (int i = 0; i < queries; ++i) {
+		xs[i] = lo + rand() % size;
+		zs[i] = lo + rand() % size;
+	}
+
+	long long sum = 0;
+	double t = now_ms();
+	for (int i = 0; i < queries; ++i)
+		sum += world.getHeight(xs[i], zs[i]);
+	t = now_ms() - t;
+	printf("heightmap: %.1f M queries/s\n", queries / t / 1000);
+
+	int walks = std::max(queries / 100, 1);
+	t = now_ms();
+	for (int i = 0; i < walks; ++i)
+		sum += surface(&world, xs[i], zs[i]);
+	t = now_ms() - t;
+	printf("column walk: %.3f M queries/s\n", walks / t / 1000);
+
+	std::vector<int> rect(CHUNK::X * CHUNK::Z);
+	int rects = std::max(queries / (CHUNK::X * CHUNK::Z), 1);
+	t = now_ms();
+	for (int i = 0; i < rects; ++i) {
+		world.getHeights(xs[i], zs[i], CHUNK::X, CHUNK::Z, &rect[0]);
+		sum += rect[i % rect.size()];
+	}
+	t = now_ms() - t;
+	printf("%dx%d rectangles: %.1f M columns/s (checksum %lld)\n", CHUNK::X, CHUNK::Z, rects * rect.size() / t / 1000, sum);
+
+	if (wrong)
+		printf("%d columns differ from walking down the column\n", wrong);
+	return wrong ? 1 : 0;
+}
+
+// Steps of a random walk through the world, one block along one axis each, turned back at
+// the edges: (dx, dy, dz) per step.
+static std::vector<int> random_walk(int steps) {
+	int lo[3] = { -CHUNK::X * (WORLD::X / 2), -CHUNK::Y * (WORLD::Y / 2), -CHUNK::Z * (WORLD::Z / 2) };
+	int size[3] = { CHUNK::X * WORLD::X, CHUNK::Y * WORLD::Y, CHUNK::Z * WORLD::Z };
+	int at[3] = { 0, 0, 0 };
+	std::vector<int> walk(steps * 3, 0);
+	for (int i = 0; i < steps; ++i) {
+		int axis = rand() % 3;
+		int step = rand() % 2 ? 1 : -1;
+		if (at[axis] + step < lo[axis] || at[axis] + step >= lo[axis] + size[axis])
+			step = -step;
+		at[axis] += step;
+		walk[i * 3 + axis] = step;
+	}
+	return walk;
+}
+
+// Block reads along a random walk and along every line of blocks through the world, with
+// World::getBlock against a BlockAccessor that keeps the chunk it is in. Checks that both
+// read the same blocks, that writes through either leave the same blocks and heights, and
+// that blocks just past the low edges of the world, which truncating division put into
+// its first chunks, read as air and can't be written. Arguments: [steps]
+static int bench_accessor(int argc, char *argv[]) {
+	int steps = argc > 0 ? atoi(argv[0]) : 10000000;
+
+	World world(1), other(1);
+	generate_all(&world);
+	generate_all(&other);
+	srand(1);
+	std::vector<int> walk = random_walk(steps);
+	int wrong = 0;
+
+	uint64_t sum[2] = { 0, 0 };
+	double t = now_ms();
+	int x = 0, y = 0, z = 0;
+	for (int i = 0; i < steps; ++i) {
+		x += walk[i * 3];
+		y += walk[i * 3 + 1];
+		z += walk[i * 3 + 2];
+		sum[0] += world.getBlock(x, y, z) * (uint64_t)(i + 1);
+	}
+	double getMs = now_ms() - t;
+
+	t = now_ms();
+	BlockAccessor at(&world, 0, 0, 0);
+	for (int i = 0; i < steps; ++i) {
+		at.move(walk[i * 3], walk[i * 3 + 1], walk[i * 3 + 2]);
+		sum[1] += at.get() * (uint64_t)(i + 1);
+	}
+	double accessorMs = now_ms() - t;
+	wrong += sum[0] != sum[1];
+	printf("random walk: getBlock %.1f M blocks/s, accessor %.1f M blocks/s, %.1fx\n",
+		steps / getMs / 1000, steps / accessorMs / 1000, getMs / accessorMs);
+
+	// Every line of blocks along each axis, end to end
+	int lo[3] = { -CHUNK::X * (WORLD::X / 2), -CHUNK::Y * (WORLD::Y / 2), -CHUNK::Z * (WORLD::Z / 2) };
+	int size[3] = { CHUNK::X * WORLD::X, CHUNK::Y * WORLD::Y, CHUNK::Z * WORLD::Z };
+	const char *axes[3] = { "x", "y", "z" };
+	for (int axis = 0; axis < 3; ++axis) {
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		int d[3] = { 0, 0, 0 };
+		d[axis] = 1;
+		uint64_t lines[2] = { 0, 0 };
+
+		t = now_ms();
+		for (int a = lo[u]; a < lo[u] + size[u]; ++a) {
+			for (int b = lo[v]; b < lo[v] + size[v]; ++b) {
+				int p[3];
+				p[u] = a;
+				p[v] = b;
+				for (p[axis] = lo[axis]; p[axis] < lo[axis] + size[axis]; ++p[axis])
+					lines[0] = lines[0] * 31 + world.getBlock(p[0], p[1], p[2]);
+			}
+		}
+		getMs = now_ms() - t;
+
+		t = now_ms();
+		for (int a = lo[u]; a < lo[u] + size[u]; ++a) {
+			for (int b = lo[v]; b < lo[v] + size[v]; ++b) {
+				int p[3];
+				p[u] = a;
+				p[v] = b;
+				p[axis] = lo[axis];
+				at.moveTo(p[0], p[1], p[2]);
+				for (int i = 0; i < size[axis]; ++i, at.move(d[0], d[1], d[2]))
+					lines[1] = lines[1] * 31 + at.get();
+			}
+		}
+		accessorMs = now_ms() - t;
+		wrong += lines[0] != lines[1];
+
+		int blocks = size[0] * size[1] * size[2];
+		printf("lines along %s: getBlock %.1f M blocks/s, accessor %.1f M blocks/s, %.1fx\n",
+			axes[axis], blocks / getMs / 1000, blocks / accessorMs / 1000, getMs / accessorMs);
+	}
+
+	// The same edits through World::setBlock and through an accessor
+	int edits = std::min(steps, 100000);
+	x = y = z = 0;
+	at.moveTo(0, 0, 0);
+	BlockAccessor to(&other, 0, 0, 0);
+	for (int i = 0; i < edits; ++i) {
+		x += walk[i * 3];
+		y += walk[i * 3 + 1];
+		z += walk[i * 3 + 2];
+		to.move(walk[i * 3], walk[i * 3 + 1], walk[i * 3 + 2]);
+		uint8_t type = i % 3 ? BLOCK::AIR : 6;
+		world.setBlock(x, y, z, type);
+		to.set(type);
+	}
+	int blocks = 0, heights = 0;
+	for (int bx = lo[0]; bx < lo[0] + size[0]; ++bx) {
+		for (int bz = lo[2]; bz < lo[2] + size[2]; ++bz) {
+			heights += world.getHeight(bx, bz) != other.getHeight(bx, bz);
+			for (int by = lo[1]; by < lo[1] + size[1]; ++by)
+				blocks += world.getBlock(bx, by, bz) != other.getBlock(bx, by, bz);
+		}
+	}
+	if (blocks || heights)
+		printf("%d blocks and %d heights differ between setBlock and the accessor\n", blocks, heights);
+	wrong += blocks + heights;
+
+	// Just past the low edges, and the first chunks along them
+	int outside = 0, inside = 0;
+	for (int i = 1; i <= CHUNK::X; ++i) {
+		world.setBlock(lo[0] - i, 0, 0, 6);
+		world.setBlock(0, lo[1] - i, 0, 6);
+		world.setBlock(0, 0, lo[2] - i, 6);
+		outside += world.getBlock(lo[0] - i, 0, 0) != BLOCK::AIR;
+		outside += world.getBlock(0, lo[1] - i, 0) != BLOCK::AIR;
+		outside += world.getBlock(0, 0, lo[2] - i) != BLOCK::AIR;
+		outside += world.findChunk(lo[0] - i, 0, 0) != 0;
+
+		at.moveTo(lo[0] + i - 1, 0, lo[2] + i - 1);
+		at.set(BLOCK::SAND);
+		inside += world.getBlock(lo[0] + i - 1, 0, lo[2] + i - 1) != BLOCK::SAND;
+	}
+	if (outside || inside)
+		printf("%d reads past the edges aren't air, %d writes in the edge chunks are lost\n", outside, inside);
+	wrong += outside + inside;
+
+	printf("checksums %llu %llu\n", (unsigned long long)sum[0], (unsigned long long)sum[1]);
+	if (wrong)
+		printf("%d checks failed\n", wrong);
+	return wrong ? 1 : 0;
+}
+
+// A stone floor across chunks 0, 1 and 2 along x with a water source at the far edge of
+// chunks 0 and 2, which tick in the same phase and both flow into chunk 1. Edits go into
+// journal too unless it is 0.
+static void flood_floor(World *world, BlockTicker *ticker, EditJournal *journal) {
+	for (int x = -2; x < 3 * CHUNK::X + 2; ++x) {
+		for (int z = 2; z < CHUNK::Z - 2; ++z) {
+			world->setBlock(x, 40, z, 6);
+			if (journal)
+				journal->append(x, 40, z, 6);
+		}
+	}
+
+	int sources[2] = { CHUNK::X - 1, 2 * CHUNK::X };
+	for (int i = 0; i < 2; ++i) {
+		world->setBlock(sources[i], 41, CHUNK::Z / 2, BLOCK::WATER);
+		if (journal)
+			journal->append(sources[i], 41, CHUNK::Z / 2, BLOCK::WATER);
+		ticker->activate(sources[i], 41, CHUNK::Z / 2);
+	}
+}
+
+// Water flowing while a compaction holds the blocks of the chunks it flows through: the
+// flow has to come out as it does without the compaction, and the snapshots as the blocks
+// were when it started. Returns the blocks that differ.
+static int journal_ticking(const std::string &name) {
+	static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+	static const int TICKS = 60;
+
+	remove((name + ".world").c_str());
+	for (int i = 0; i < 16; ++i) {
+		char suffix[32];
+		sprintf(suffix, ".journal.%d", i);
+		remove((name + suffix).c_str());
+	}
+
+	// More workers than chunks in a phase, so the two that flow into chunk 1 run at once
+	time_t seed = 1;
+	ThreadPool pool(4);
+	World world(seed), reference(seed);
+	generate_all(&world);
+	generate_all(&reference);
+	EditJournal journal;
+	if (!journal.open(name.c_str(), &seed))
+		return 1;
+
+	BlockTicker ticker(&world, &pool), untouched(&reference, &pool);
+	flood_floor(&reference, &untouched, 0);
+	for (int i = 0; i < TICKS; ++i)
+		untouched.tick();
+
+	// The chunks the water flows through, as the compaction has to save them
+	Chunk *chunks[3];
+	int cy = 40 / CHUNK::Y + WORLD::Y / 2;
+	std::vector<uint8_t> saved(3 * BLOCKS);
+	flood_floor(&world, &ticker, &journal);
+	for (int x = 0; x < 3; ++x) {
+		chunks[x] = world.getChunk(x + WORLD::X / 2, cy, WORLD::Z / 2);
+		chunks[x]->getBlocks(&saved[x * BLOCKS]);
+	}
+
+	journal.compact(&world);
+	int overlapped = 0;
+	for (int i = 0; i < TICKS; ++i) {
+		overlapped += journal.isCompacting();
+		ticker.tick();
+	}
+	journal.close();
+
+	World loaded(seed);
+	EditJournal reader;
+	if (!reader.open(name.c_str(), &seed))
+		return 1;
+	reader.replay(&loaded);
+	reader.close();
+
+	int flow = 0, snapshot = 0;
+	std::vector<uint8_t> block(BLOCKS), expected(BLOCKS);
+	for (int x = 0; x < 3; ++x) {
+		chunks[x]->getBlocks(&block[0]);
+		reference.getChunk(x + WORLD::X / 2, cy, WORLD::Z / 2)->getBlocks(&expected[0]);
+		for (int b = 0; b < BLOCKS; ++b)
+			flow += block[b] != expected[b];
+
+		loaded.getChunk(x + WORLD::X / 2, cy, WORLD::Z / 2)->getBlocks(&block[0]);
+		for (int b = 0; b < BLOCKS; ++b)
+			snapshot += block[b] != saved[x * BLOCKS + b];
+	}
+
+	int water = 0;
+	for (int b = 0; b < 3 * BLOCKS; ++b)
+		water += saved[b] == BLOCK::WATER;
+	for (int x = 0; x < 3; ++x) {
+		chunks[x]->getBlocks(&block[0]);
+		for (int b = 0; b < BLOCKS; ++b)
+			water -= block[b] == BLOCK::WATER;
+	}
+
+	printf("water ticked during compaction: %d of %d ticks overlapped it, %d blocks flowed\n", overlapped, TICKS, -water);
+	if (flow || snapshot)
+		printf("%d blocks flowed differently, %d saved blocks differ\n", flow, snapshot);
+	return flow + snapshot;
+}
+
+// Random block edits streamed into the journal, compacting in the background as the game
+// loop would, with the longest stall that caused; then the world loaded back from it,
+// before and after a final compaction into chunk snapshots, and water ticking while a
+// compaction runs. Writes <name>.* and <name>_ticking.* in the current directory.
+// Arguments: [edits] [name]
+static int bench_journal(int argc, char *argv[]) {
+	int edits = argc > 0 ? atoi(argv[0]) : 1000000;
+	std::string name = argc > 1 ? argv[1] : "journal_bench";
+
+	// Start from nothing
+	remove((name + ".world").c_str());
+	for (int i = 0; i < 16; ++i) {
+		char suffix[32];
+		sprintf(suffix, ".journal.%d", i);
+		remove((name + suffix).c_str());
+	}
+
+	int lo = -CHUNK::X * (WORLD::X / 2);
+	int size = CHUNK::X * WORLD::X;
+	time_t seed = 1;
+	World world(seed);
+	EditJournal journal;
+	if (!journal.open(name.c_str(), &seed))
+		return 1;
+
+	// Edits come in frames of 1000, each ending with the journal's update() as the game
+	// loop calls it, which starts a compaction every JOURNAL::COMPACT_EDITS edits
+	srand(1);
+	double t = now_ms(), longest = 0;
+	int compactions = 0;
+	for (int i = 0; i < edits; ++i) {
+		int x = lo + rand() % size, y = lo + rand() % size, z = lo + rand() % size;
+		uint8_t type = rand() % 2 ? 6 : BLOCK::AIR;
+		world.generate(world.findChunk(x, y, z));
+		world.setBlock(x, y, z, type);
+		journal.append(x, y, z, type);
+
+		if (i % 1000 == 999) {
+			bool compacting = journal.isCompacting();
+			double u = now_ms();
+			journal.update(&world);
+			longest = std::max(longest, now_ms() - u);
+			compactions += !compacting && journal.isCompacting();
+		}
+	}
+	double appended = now_ms() - t;
+	journal.flush();
+	t = now_ms() - t;
+	printf("%d edits: appended in %.1f ms, durable after %.1f ms, %.2f M edits/s, %d syncs\n",
+		edits, appended, t, edits / t / 1000, journal.getSyncs());
+	printf("%d compactions while editing, longest update() %.3f ms\n", compactions, longest);
+	journal.close();
+
+	// Load it back, once from the journal alone and once from snapshots after compaction
+	int wrong = 0;
+	for (int pass = 0; pass < 2; ++pass) {
+		World loaded(seed);
+		EditJournal reader;
+		t = now_ms();
+		if (!reader.open(name.c_str(), &seed))
+			return 1;
+		int replayed = reader.replay(&loaded);
+		t = now_ms() - t;
+		printf("%s: %d journaled edits loaded in %.1f ms\n", pass ? "after compaction" : "journal only", replayed, t);
+
+		// Chunks whose edits all left what generation gives have nothing saved and are
+		// only generated when something asks for them
+		for (int x = lo; x < lo + size; x += 3) {
+			for (int y = lo; y < lo + size; y += 3) {
+				for (int z = lo; z < lo + size; z += 3) {
+					if (world.findChunk(x, y, z)->isNoised())
+						loaded.generate(loaded.findChunk(x, y, z));
+					wrong += loaded.getBlock(x, y, z) != world.getBlock(x, y, z);
+				}
+			}
+		}
+
+		if (!pass) {
+			t = now_ms();
+			reader.compact(&loaded);
+			double pause = now_ms() - t;
+			reader.close();
+			t = now_ms() - t;
+
+			FILE *file = fopen((name + ".world").c_str(), "rb");
+			long bytes = 0;
+			if (file) {
+				fseek(file, 0, SEEK_END);
+				bytes = ftell(file);
+				fclose(file);
+			}
+			printf("compaction: %.3f ms on the calling thread, %.1f ms in total, %.1f chunks/s, %.1f MB written\n",
+				pause, t, WORLD::X * WORLD::Y * WORLD::Z / t * 1000, bytes / 1e6);
+		}
+	}
+
+	if (wrong)
+		printf("%d blocks differ after loading\n", wrong);
+	wrong += journal_ticking(name + "_ticking");
+	return wrong ? 1 : 0;
+}
+
+// Memory and save size of chunks kept as generation plus the blocks that differ from it,
+// after a player-like set of edits: digging and building around a few sites, one of them
+// undone again, whose chunks have to end up holding nothing. Arguments: [sites] [edits per site]
+static int bench_procedural(int argc, char *argv[]) {
+	int sites = argc > 0 ? atoi(argv[0]) : 20;
+	int edits = argc > 1 ? atoi(argv[1]) : 100;
+	static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+	static const int CHUNKS = WORLD::X * WORLD::Y * WORLD::Z;
+
+	World world(1);
+	generate_all(&world);
+
+	std::vector<Chunk *> chunks;
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				chunks.push_back(world.getChunk(x, y, z));
+
+	// Per chunk: 1 if a site that stays edited touched it, 2 if the undone one did
+	std::vector<int> touched(CHUNKS, 0);
+
+	srand(1);
+	int lo = -CHUNK::X * (WORLD::X / 2 - 1);
+	int span = CHUNK::X * (WORLD::X - 2);
+	for (int s = 0; s < sites; ++s) {
+		int sx = lo + rand() % span, sz = lo + rand() % span;
+		int sy = world.getHeight(sx, sz);
+		std::vector<ReplayEdit> undo;
+
+		for (int i = 0; i < edits; ++i) {
+			ReplayEdit e = { sx + rand() % 9 - 4, sy + rand() % 9 - 4, sz + rand() % 9 - 4, 0 };
+			Chunk *chunk = world.findChunk(e.x, e.y, e.z);
+			if (!chunk)
+				continue;
+			e.type = chunk->getBlock(e.x & (CHUNK::X - 1), e.y & (CHUNK::Y - 1), e.z & (CHUNK::Z - 1));
+			undo.push_back(e);
+			int cx, cy, cz;
+			World::locate(e.x, e.y, e.z, &cx, &cy, &cz);
+			touched[(cx * WORLD::Y + cy) * WORLD::Z + cz] |= s == sites - 1 ? 2 : 1;
+			chunk->setBlock(e.x & (CHUNK::X - 1), e.y & (CHUNK::Y - 1), e.z & (CHUNK::Z - 1), e.type ? BLOCK::AIR : 6);
+		}
+
+		if (s == sites - 1)
+			for (size_t i = undo.size(); i-- > 0;)
+				world.findChunk(undo[i].x, undo[i].y, undo[i].z)->setBlock(undo[i].x & (CHUNK::X - 1), undo[i].y & (CHUNK::Y - 1), undo[i].z & (CHUNK::Z - 1), undo[i].type);
+	}
+
+	// Far chunks are meshed before their storage changes
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	std::vector<uint8_t> expected((size_t)CHUNKS * BLOCKS);
+	size_t dense = 0, full = 0, sparse = 0;
+	int edited = 0, reverted = 0;
+	std::vector<BlockDiff> diff;
+
+	for (int i = 0; i < CHUNKS; ++i) {
+		chunks[i]->mesh(&vertices[0]);
+		chunks[i]->getBlocks(&expected[(size_t)i * BLOCKS]);
+		dense += chunks[i]->getBytes();
+
+		// Save size: every edited chunk in full, or only what differs from generation
+		int n = chunks[i]->diff(diff);
+		edited += n > 0;
+		full += n ? sizeof(int32_t) + BLOCKS + sizeof(uint32_t) : 0;
+		sparse += n ? sizeof(int32_t) * 3 + n * 3 : 0;
+	}
+
+	VoxelDAG dag;
+	int procedural = 0;
+	double t = now_ms();
+	for (int i = 0; i < CHUNKS; ++i) {
+		if (chunks[i]->makeProcedural())
+			++procedural;
+		else
+			chunks[i]->compact(&dag);
+	}
+	t = now_ms() - t;
+
+	// Chunks only the undone site touched are back to generation: procedural, holding nothing
+	int undone = 0;
+	for (int i = 0; i < CHUNKS; ++i) {
+		if (touched[i] != 2)
+			continue;
+		++undone;
+		reverted += chunks[i]->isProcedural() && chunks[i]->getBytes() == 0;
+	}
+
+	size_t resident = dag.getBytes();
+	for (int i = 0; i < CHUNKS; ++i)
+		resident += chunks[i]->getBytes();
+
+	printf("%d edits around %d sites, %d chunks differ from generation\n", sites * edits, sites, edited);
+	printf("save size: %u bytes as full chunks, %u bytes as diffs (%.0fx smaller)\n", (unsigned)full, (unsigned)sparse, (double)full / std::max<size_t>(sparse, 1));
+	printf("resident: %u bytes dense, %u bytes with %d procedural chunks (%.0fx smaller), converted in %.1f ms\n",
+		(unsigned)dense, (unsigned)resident, procedural, (double)dense / std::max<size_t>(resident, 1), t);
+	printf("%d of %d chunks edited and undone again hold no blocks\n", reverted, undone);
+
+	// Point reads straight from generation plus diff, then everything materialized again
+	int wrong = 0;
+	std::vector<uint8_t> block(BLOCKS);
+	t = now_ms();
+	for (int i = 0; i < CHUNKS; i += 7)
+		for (int b = 0; b < BLOCKS; b += 5)
+			wrong += chunks[i]->getBlock(b / (CHUNK::Y * CHUNK::Z), b / CHUNK::Z % CHUNK::Y, b % CHUNK::Z) != expected[(size_t)i * BLOCKS + b];
+	double reads = now_ms() - t;
+
+	t = now_ms();
+	for (int i = 0; i < CHUNKS; ++i) {
+		chunks[i]->expand();
+		chunks[i]->getBlocks(&block[0]);
+		wrong += memcmp(&block[0], &expected[(size_t)i * BLOCKS], BLOCKS) != 0;
+	}
+	t = now_ms() - t;
+	printf("materialized %d chunks in %.1f ms (%.3f ms/chunk), point reads %.3f us\n", CHUNKS, t, t / CHUNKS,
+		reads * 1000 / ((CHUNKS + 6) / 7 * ((BLOCKS + 4) / 5)));
+
+	if (wrong)
+		printf("%d blocks or chunks differ after the round trip\n", wrong);
+	if (reverted < undone)
+		printf("%d chunks edited back to generation still hold blocks\n", undone - reverted);
+	return wrong || reverted < undone ? 1 : 0;
+}
+
+// Storage tiers at several view distances: with the camera in the middle of the world,
+// chunks beyond the hot distance are compressed and those two chunks further compacted.
+// Reports chunks and resident bytes per tier against all dense, the cost of a point read
+// in each tier and of the first write, which expands the chunk, then checks every block.
+// Arguments: [reads]
+static int bench_tiers(int argc, char *argv[]) {
+	int reads = argc > 0 ? atoi(argv[0]) : 200000;
+	static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+	static const int CHUNKS = WORLD::X * WORLD::Y * WORLD::Z;
+	static const char *const NAMES[4] = { "dense", "runs", "dag", "procedural" };
+
+	World world(1);
+	generate_all(&world);
+
+	std::vector<Chunk *> chunks;
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				chunks.push_back(world.getChunk(x, y, z));
+
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	std::vector<uint8_t> expected((size_t)CHUNKS * BLOCKS);
+	size_t dense = 0;
+	for (int i = 0; i < CHUNKS; ++i) {
+		chunks[i]->mesh(&vertices[0]);
+		chunks[i]->getBlocks(&expected[(size_t)i * BLOCKS]);
+		dense += chunks[i]->getBytes();
+	}
+	printf("%d chunks, %u bytes dense\n", CHUNKS, (unsigned)dense);
+
+	srand(1);
+	std::vector<int> positions(reads);
+	for (int i = 0; i < reads; ++i)
+		positions[i] = rand() % BLOCKS;
+
+	int wrong = 0;
+	glm::vec3 eye(0.0f, (float)surface(&world, 0, 0), 0.0f);
+	for (int distance = 1; distance <= 4; ++distance) {
+		for (int i = 0; i < CHUNKS; ++i) {
+			chunks[i]->expand();
+			if (chunks[i]->isChanged())
+				chunks[i]->mesh(&vertices[0]);
+		}
+
+		StoragePolicy policy;
+		policy.hotDistance = (float)distance * CHUNK::X;
+		policy.hotFrames = 0;
+		policy.farDistance = (float)(distance + 2) * CHUNK::X;
+		policy.budget = CHUNKS;
+		world.setStoragePolicy(policy);
+		double t = now_ms();
+		world.updateStorage(eye);
+		t = now_ms() - t;
+
+		StorageStats stats = world.getStorageStats();
+		size_t resident = 0;
+		printf("hot within %d chunks:", distance);
+		for (int s = 0; s < 4; ++s) {
+			printf(" %s %d (%u bytes)", NAMES[s], stats.chunks[s], (unsigned)stats.bytes[s]);
+			resident += stats.bytes[s];
+		}
+		printf("\n  resident %u bytes, %.1fx smaller than dense, converted in %.1f ms\n",
+			(unsigned)resident, (double)dense / std::max<size_t>(resident, 1), t);
+
+		// Point reads spread over the chunks of each tier, then one write to each of them
+		printf("  read ns:");
+		for (int s = 0; s < 4; ++s) {
+			std::vector<int> tier;
+			for (int i = 0; i < CHUNKS; ++i)
+				if (chunks[i]->getStorage() == s)
+					tier.push_back(i);
+			if (tier.empty())
+				continue;
+
+			t = now_ms();
+			for (int r = 0; r < reads; ++r) {
+				int i = tier[r % tier.size()], b = positions[r];
+				wrong += chunks[i]->getBlock(b / (CHUNK::Y * CHUNK::Z), b / CHUNK::Z % CHUNK::Y, b % CHUNK::Z) != expected[(size_t)i * BLOCKS + b];
+			}
+			printf(" %s %.1f", NAMES[s], (now_ms() - t) * 1e6 / reads);
+		}
+		printf("\n  first write us:");
+		for (int s = 1; s < 4; ++s) {
+			int count = 0;
+			t = now_ms();
+			for (int i = 0; i < CHUNKS; ++i) {
+				if (chunks[i]->getStorage() != s)
+					continue;
+				int b = positions[i];
+				int x = b / (CHUNK::Y * CHUNK::Z), y = b / CHUNK::Z % CHUNK::Y, z = b % CHUNK::Z;
+				chunks[i]->setBlock(x, y, z, chunks[i]->getBlock(x, y, z));
+				++count;
+			}
+			t = now_ms() - t;
+			if (count)
+				printf(" %s %.1f", NAMES[s], t * 1000 / count);
+		}
+		printf("\n");
+
+		std::vector<uint8_t> block(BLOCKS);
+		for (int i = 0; i < CHUNKS; ++i) {
+			chunks[i]->getBlocks(&block[0]);
+			wrong += memcmp(&block[0], &expected[(size_t)i * BLOCKS], BLOCKS) != 0;
+		}
+	}
+
+	if (wrong)
+		printf("%d blocks or chunks differ between tiers\n", wrong);
+	return wrong ? 1 : 0;
+}
+
+// Sum of the voxel and mesh bytes of chunks as they report them.
+static void chunk_memory(const std::vector<Chunk *> &chunks, size_t *voxels, size_t *meshes) {
+	*voxels = *meshes = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		*voxels += chunks[i]->getBytes();
+		*meshes += chunks[i]->getMeshBytes();
+	}
+}
+
+// Chunks with something to evict whose eviction broke order: evicted after one that was
+// kept, where rank says which goes first. had and kept say what each held before and
+// after the update.
+static int eviction_violations(const std::vector<int> &rank, const std::vector<bool> &had, const std::vector<bool> &kept) {
+	std::vector<int> byRank(rank.size());
+	for (size_t i = 0; i < rank.size(); ++i)
+		byRank[rank[i]] = (int)i;
+
+	int violations = 0;
+	bool keeping = false;
+	for (size_t r = 0; r < byRank.size(); ++r) {
+		int i = byRank[r];
+		if (!had[i])
+			continue;
+		violations += keeping && !kept[i];
+		keeping = keeping || kept[i];
+	}
+	return violations;
+}
+
+// Checks the memory budget headless: its accounting against what the chunks report,
+// that meshes are evicted before voxels and each in least recently used or furthest first
+// order, that recently used chunks are kept and that evicted chunks come back as they
+// were. Then flies a headless camera in a circle with and without a limit, reporting
+// peak memory, evictions and the meshing they cost. Arguments: [frames] [limit MB]
+static int bench_memory(int argc, char *argv[]) {
+	int frames = argc > 0 ? atoi(argv[0]) : 600;
+	double limitMb = argc > 1 ? atof(argv[1]) : 2.0;
+	static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+	static const int CHUNKS = WORLD::X * WORLD::Y * WORLD::Z;
+
+	World world(1);
+	generate_all(&world);
+	std::vector<Chunk *> chunks;
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				chunks.push_back(world.getChunk(x, y, z));
+
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	std::vector<uint8_t> expected((size_t)CHUNKS * BLOCKS);
+	std::vector<int> counts(CHUNKS);
+	for (int i = 0; i < CHUNKS; ++i) {
+		counts[i] = chunks[i]->mesh(&vertices[0]);
+		chunks[i]->getBlocks(&expected[(size_t)i * BLOCKS]);
+	}
+
+	int wrong = 0;
+	size_t voxels, meshes;
+	glm::vec3 eye(0.0f, (float)surface(&world, 0, 0), 0.0f);
+
+	// Accounting without limits evicts nothing and matches the chunks
+	MemoryBudget budget;
+	budget.update(&chunks[0], CHUNKS, eye, 0, 0);
+	chunk_memory(chunks, &voxels, &meshes);
+	size_t vertexBytes = 0;
+	for (int i = 0; i < CHUNKS; ++i)
+		vertexBytes += counts[i] * sizeof(byte4);
+	const MemoryStats &stats = budget.getStats();
+	wrong += stats.voxels != voxels || stats.meshes != meshes || meshes != vertexBytes || stats.meshEvictions || stats.voxelEvictions;
+	printf("accounted %u voxel bytes in %d chunks, %u mesh bytes in %d chunks\n",
+		(unsigned)stats.voxels, stats.voxelChunks, (unsigned)stats.meshes, stats.meshChunks);
+
+	// Each chunk used in its own update, in a shuffled order
+	srand(1);
+	std::vector<int> order(CHUNKS), rank(CHUNKS);
+	for (int i = 0; i < CHUNKS; ++i)
+		order[i] = i;
+	for (int i = CHUNKS - 1; i > 0; --i)
+		std::swap(order[i], order[rand() % (i + 1)]);
+	for (int k = 0; k < CHUNKS; ++k) {
+		rank[order[k]] = k;
+		budget.use(order[k]);
+		budget.update(&chunks[0], CHUNKS, eye, 0, 0);
+	}
+
+	// Half the meshes over the limit: only meshes go, oldest first
+	MemoryLimits limits;
+	limits.keepFrames = 0;
+	limits.evictions = CHUNKS;
+	limits.total = voxels + meshes / 2;
+	budget.setLimits(limits);
+	std::vector<bool> had(CHUNKS), kept(CHUNKS);
+	for (int i = 0; i < CHUNKS; ++i)
+		had[i] = chunks[i]->getMeshBytes() > 0;
+	double t = now_ms();
+	budget.update(&chunks[0], CHUNKS, eye, 0, 0);
+	t = now_ms() - t;
+	for (int i = 0; i < CHUNKS; ++i)
+		kept[i] = chunks[i]->getMeshBytes() > 0;
+	int orderViolations = eviction_violations(rank, had, kept);
+	chunk_memory(chunks, &voxels, &meshes);
+	wrong += stats.voxels != voxels || stats.meshes != meshes || stats.voxelEvictions || voxels + meshes > limits.total;
+	printf("LRU, meshes over: %d meshes evicted, %d voxels, in %.3f ms\n", stats.meshEvictions, stats.voxelEvictions, t);
+
+	// Half the voxels over: every mesh goes before any voxels, which go oldest first
+	limits.total = voxels / 2;
+	budget.setLimits(limits);
+	for (int i = 0; i < CHUNKS; ++i)
+		had[i] = chunks[i]->getBytes() > 0 && !chunks[i]->isProcedural();
+	budget.update(&chunks[0], CHUNKS, eye, 0, 0);
+	for (int i = 0; i < CHUNKS; ++i) {
+		kept[i] = !chunks[i]->isCompact();
+		wrong += chunks[i]->getMeshBytes() > 0;
+	}
+	orderViolations += eviction_violations(rank, had, kept);
+	chunk_memory(chunks, &voxels, &meshes);
+	wrong += stats.voxels != voxels || stats.meshes != meshes || (voxels + meshes > limits.total && !stats.over);
+	printf("LRU, voxels over: %d meshes evicted, %d voxels, %u bytes left\n", stats.meshEvictions, stats.voxelEvictions, (unsigned)(voxels + meshes));
+
+	// Evicted chunks read and mesh as before
+	for (int i = 0; i < CHUNKS; ++i) {
+		std::vector<uint8_t> block(BLOCKS);
+		chunks[i]->getBlocks(&block[0]);
+		wrong += memcmp(&block[0], &expected[(size_t)i * BLOCKS], BLOCKS) != 0;
+		wrong += chunks[i]->mesh(&vertices[0]) != counts[i];
+	}
+
+	// Furthest meshes first
+	MemoryBudget distant;
+	limits.order = EVICT_DISTANCE;
+	chunk_memory(chunks, &voxels, &meshes);
+	limits.total = voxels + meshes / 2;
+	distant.setLimits(limits);
+	for (int i = 0; i < CHUNKS; ++i) {
+		glm::vec3 center = (glm::vec3(chunks[i]->getX(), chunks[i]->getY(), chunks[i]->getZ()) + 0.5f) * glm::vec3(CHUNK::X, CHUNK::Y, CHUNK::Z);
+		order[i] = i;
+		rank[i] = (int)(-glm::length(center - eye) * 1000);
+		had[i] = chunks[i]->getMeshBytes() > 0;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return rank[a] < rank[b]; });
+	for (int k = 0; k < CHUNKS; ++k)
+		rank[order[k]] = k;
+	distant.update(&chunks[0], CHUNKS, eye, 0, 0);
+	for (int i = 0; i < CHUNKS; ++i)
+		kept[i] = chunks[i]->getMeshBytes() > 0;
+	orderViolations += eviction_violations(rank, had, kept);
+	printf("distance, meshes over: %d meshes evicted, %d voxels\n", distant.getStats().meshEvictions, distant.getStats().voxelEvictions);
+
+	// Nothing used within keepFrames is touched, however far over
+	for (int i = 0; i < CHUNKS; ++i)
+		chunks[i]->mesh(&vertices[0]);
+	limits.keepFrames = 10;
+	limits.total = 1;
+	distant.setLimits(limits);
+	for (int i = 0; i < CHUNKS; i += 3)
+		distant.use(i);
+	distant.update(&chunks[0], CHUNKS, eye, 0, 0);
+	int touched = 0;
+	for (int i = 0; i < CHUNKS; i += 3)
+		touched += chunks[i]->getMeshBytes() != counts[i] * sizeof(byte4) || chunks[i]->isCompact();
+	wrong += touched;
+	printf("kept %d recently used chunks, %d touched\n", (CHUNKS + 2) / 3, touched);
+
+	// A headless flight, unlimited and then limited
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f * WINDOW::WIDTH / WINDOW::HEIGHT, 0.01f, 1000.0f);
+	for (int pass = 0; pass < 2; ++pass) {
+		World flown(1);
+		flown.setHeadless(true);
+		RenderBudget render;
+		render.generate = 4;
+		flown.setBudget(render);
+		MemoryLimits flight;
+		flight.total = pass ? (size_t)(limitMb * (1 << 20)) : 0;
+		flown.setMemoryLimits(flight);
+
+		size_t peak = 0;
+		int over = 0, meshed = 0;
+		uint64_t evicted = 0;
+		double update = 0;
+		for (int f = 0; f < frames; ++f) {
+			float a = f * 0.01f;
+			glm::vec3 at(cosf(a) * 40, 8.0f, sinf(a) * 40), forward(-sinf(a), -0.2f, cosf(a));
+			flown.schedule(at, forward, forward * 10.0f);
+			flown.render(projection * glm::lookAt(at, at + forward, glm::vec3(0, 1, 0)));
+			meshed += flown.getStats().meshed;
+			t = now_ms();
+			flown.updateStorage(at);
+			update += now_ms() - t;
+
+			const MemoryStats &memory = flown.getMemoryStats();
+			peak = std::max(peak, memory.voxels + memory.meshes);
+			over += memory.over;
+			evicted += memory.meshEvictions + memory.voxelEvictions;
+		}
+		const MemoryStats &memory = flown.getMemoryStats();
+		printf("%s: peak %.2f MB, %d frames over, %u evictions, %d chunks meshed, %.3f ms per update\n",
+			pass ? "limited" : "unlimited", peak / 1048576.0, over, (unsigned)evicted, meshed, update / frames);
+		printf("  ends with %.2f MB of voxels in %d chunks and %.2f MB of meshes in %d\n",
+			memory.voxels / 1048576.0, memory.voxelChunks, memory.meshes / 1048576.0, memory.meshChunks);
+	}
+
+	if (orderViolations)
+		printf("%d chunks evicted out of order\n", orderViolations);
+	if (wrong)
+		printf("%d accounting or round trip errors\n", wrong);
+	return wrong || orderViolations ? 1 : 0;
+}
+
+// Load generator for the chunk server: clients on loopback fly through the world, keeping
+// the chunks within radius of them and editing blocks as they go. Reports chunks served
+// per second and request latency, then checks that every client's copy matches the server,
+// and first that connections announcing oversized messages are dropped.
+// Arguments: [clients] [seconds] [radius]
+static int bench_stream(int argc, char *argv[]) {
+	int clients = argc > 0 ? atoi(argv[0]) : 8;
+	double seconds = argc > 1 ? atof(argv[1]) : 5;
+	int radius = argc > 2 ? atoi(argv[2]) : 2;
+	static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+
+	World world(1);
+	ChunkServer server(&world);
+	if (!server.listen(0))
+		return 1;
+	int port = server.getPort();
+
+	std::atomic<bool> stop_server(false);
+	std::thread serving([&]() {
+		while (!stop_server)
+			server.serve(5);
+	});
+
+	// Headers claiming more than NET::MAX_MESSAGE, one of them so much that adding the
+	// header size wraps a 32-bit size_t, have to get the connection dropped
+	int undropped = 0;
+	uint32_t sizes[2] = { NET::MAX_MESSAGE + 1, 0xFFFFFFFB };
+	for (int i = 0; i < 2; ++i) {
+		Connection hostile;
+		if (!hostile.connect("127.0.0.1", port))
+			return 1;
+		std::vector<uint8_t> header;
+		put32(header, sizes[i]);
+		header.push_back(MESSAGE::REQUEST);
+		::send(hostile.getSocket(), (const char *)&header[0], (int)header.size(), 0);
+
+		bool dropped = false;
+		for (double until = now_ms() + 2000; !dropped && now_ms() < until;)
+			dropped = hostile.wait(10) && !hostile.receive();
+		undropped += !dropped;
+	}
+
+	// A chunk moved up the queue has to come in the server's first round, and one
+	// withdrawn mustn't come at all
+	int misordered = 0;
+	{
+		Connection queue;
+		if (!queue.connect("127.0.0.1", port))
+			return 1;
+		int count = WORLD::X * WORLD::Z, urgent = count - 1, withdrawn = count - 2;
+		for (int i = 0; i <= count; ++i) {
+			uint8_t type = i < count ? MESSAGE::REQUEST : MESSAGE::PRIORITY;
+			int index = i < count ? i : urgent;
+			std::vector<uint8_t> payload;
+			put32(payload, index / WORLD::Z);
+			put32(payload, 0);
+			put32(payload, index % WORLD::Z);
+			queue.send(type, payload);
+			if (i == count) {
+				payload.clear();
+				put32(payload, withdrawn / WORLD::Z);
+				put32(payload, 0);
+				put32(payload, withdrawn % WORLD::Z);
+				queue.send(MESSAGE::DROP, payload);
+			}
+		}
+		queue.flush();
+
+		int arrived = 0, place = -1;
+		bool stray = false;
+		uint8_t type;
+		std::vector<uint8_t> payload;
+		for (double until = now_ms() + 5000; arrived < count - 1 && now_ms() < until;) {
+			if (queue.wait(10) && !queue.receive())
+				break;
+			while (queue.next(&type, payload)) {
+				if (type != MESSAGE::CHUNK || payload.size() < 12)
+					continue;
+				int index = get32(&payload[0]) * WORLD::Z + get32(&payload[8]);
+				if (index == urgent)
+					place = arrived;
+				stray |= index == withdrawn;
+				++arrived;
+			}
+		}
+
+		if (place < 0 || place >= NET::BATCH || stray || arrived != count - 1) {
+			printf("moved up chunk arrived %d of %d, withdrawn chunk %s\n", place + 1, arrived, stray ? "arrived" : "didn't arrive");
+			++misordered;
+		}
+	}
+
+	std::vector<std::vector<double> > latencies(clients);
+	std::vector<int> wrong(clients, 0);
+	std::atomic<int> drained(0);
+	std::atomic<bool> stopped(false);
+	double deadline = now_ms() + seconds * 1000;
+
+	std::vector<std::thread> threads;
+	for (int c = 0; c < clients; ++c) {
+		threads.push_back(std::thread([&, c]() {
+			ChunkClient client;
+			if (!client.connect("127.0.0.1", port)) {
+				wrong[c] = -1;
+				++drained;
+				return;
+			}
+			World cache(client.getSeed());
+
+			// Fly straight, bouncing off the edges of the world
+			unsigned int random = c * 7919 + 1;
+			float half = (float)CHUNK::X * (WORLD::X / 2);
+			float angle = c * 2.39996f;
+			glm::vec3 position(((c * 37) % 100 - 50) * half / 60, 0, ((c * 61) % 100 - 50) * half / 60);
+			glm::vec3 velocity(cosf(angle) * 20, sinf(angle * 3) * 4, sinf(angle) * 20);
+			double last = now_ms(), edited = last;
+
+			while (now_ms() < deadline) {
+				double t = now_ms();
+				position += velocity * (float)((t - last) / 1000);
+				last = t;
+				for (int i = 0; i < 3; ++i) {
+					if (position[i] < -half || position[i] > half) {
+						velocity[i] = -velocity[i];
+						position[i] = glm::clamp(position[i], -half, half);
+					}
+				}
+
+				int px = (int)floorf(position.x / CHUNK::X) + WORLD::X / 2;
+				int py = (int)floorf(position.y / CHUNK::Y) + WORLD::Y / 2;
+				int pz = (int)floorf(position.z / CHUNK::Z) + WORLD::Z / 2;
+				for (int x = 0; x < WORLD::X; ++x) {
+					for (int y = 0; y < WORLD::Y; ++y) {
+						for (int z = 0; z < WORLD::Z; ++z) {
+							int d = std::max(abs(x - px), std::max(abs(y - py), abs(z - pz)));
+							if (d <= radius)
+								client.request(x, y, z);
+							else if (d > radius + 1)
+								client.drop(x, y, z);
+						}
+					}
+				}
+
+				// Ten edits a second around where the client is
+				if (t - edited > 100) {
+					edited = t;
+					random = random * 1103515245 + 12345;
+					int x = (int)position.x + (int)(random >> 8) % 9 - 4;
+					int y = (int)position.y + (int)(random >> 12) % 9 - 4;
+					int z = (int)position.z + (int)(random >> 16) % 9 - 4;
+					client.edit(x, y, z, random >> 20 & 1 ? 6 : BLOCK::AIR);
+				}
+
+				client.poll(&cache, 1);
+			}
+
+			// Let everything in flight arrive, then compare with the server's world
+			double quiet = now_ms() + 300;
+			while (client.getPending() || now_ms() < quiet)
+				client.poll(&cache, 5);
+			latencies[c] = client.getLatencies();
+			++drained;
+			while (!stopped)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			uint8_t mine[BLOCKS], theirs[BLOCKS];
+			for (int x = 0; x < WORLD::X; ++x) {
+				for (int y = 0; y < WORLD::Y; ++y) {
+					for (int z = 0; z < WORLD::Z; ++z) {
+						if (!client.isRequested(x, y, z))
+							continue;
+						cache.getChunk(x, y, z)->getBlocks(mine);
+						world.getChunk(x, y, z)->getBlocks(theirs);
+						for (int i = 0; i < BLOCKS; ++i)
+							wrong[c] += mine[i] != theirs[i];
+					}
+				}
+			}
+		}));
+	}
+
+	while (drained < clients)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	double elapsed = now_ms() - deadline + seconds * 1000;
+	stop_server = true;
+	serving.join();
+	stopped = true;
+	for (int c = 0; c < clients; ++c)
+		threads[c].join();
+
+	std::vector<double> all;
+	int mismatches = 0;
+	for (int c = 0; c < clients; ++c) {
+		all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+		mismatches += wrong[c] > 0 ? wrong[c] : 0;
+		if (wrong[c] < 0)
+			++mismatches;
+	}
+	std::sort(all.begin(), all.end());
+
+	uint64_t chunks = server.getChunksSent();
+	printf("%d clients for %.1f s: %llu chunks served, %.0f chunks/s, %.0f bytes per chunk (%.1fx smaller), %llu edits relayed\n",
+		clients, elapsed / 1000, (unsigned long long)chunks, chunks * 1000 / elapsed,
+		(double)server.getBytesSent() / std::max<uint64_t>(chunks, 1), (double)BLOCKS * chunks / std::max<uint64_t>(server.getBytesSent(), 1),
+		(unsigned long long)server.getEditsSent());
+	if (!all.empty())
+		printf("request latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			all[all.size() / 2], all[all.size() * 9 / 10], all[all.size() * 99 / 100], all.back());
+
+	if (mismatches)
+		printf("%d blocks differ between clients and server\n", mismatches);
+	if (undropped)
+		printf("%d connections sending oversized messages weren't dropped\n", undropped);
+	return mismatches || undropped || misordered ? 1 : 0;
+}
+
+// FNV-1a over the blocks of a snapshot and the neighbouring blocks it holds.
+static uint32_t snapshot_hash(const ChunkSnapshot &snapshot) {
+	uint32_t hash = 2166136261u;
+	for (int x = -1; x <= CHUNK::X; ++x) {
+		for (int y = -1; y <= CHUNK::Y; ++y) {
+			for (int z = -1; z <= CHUNK::Z; ++z) {
+				int outside = (x < 0 || x == CHUNK::X) + (y < 0 || y == CHUNK::Y) + (z < 0 || z == CHUNK::Z);
+				if (outside <= 1)
+					hash = (hash ^ snapshot.getBlock(x, y, z)) * 16777619u;
+			}
+		}
+	}
+	return hash;
+}
+
+static uint32_t mesh_hash(const byte4 *vertex, int count) {
+	uint32_t hash = 2166136261u;
+	const uint8_t *bytes = (const uint8_t *)vertex;
+	for (size_t i = 0; i < count * sizeof(byte4); ++i)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+// Stress test for chunk snapshots: the main thread keeps editing blocks around the origin
+// while the pool meshes snapshots of the changed chunks. Checks that no snapshot changes
+// under a mesher, that stale meshes are dropped and that every mesh kept matches the chunk.
+// Build with -fsanitize=thread to have the accesses checked for races as well.
+// Arguments: [seconds] [threads]
+static int bench_snapshots(int argc, char *argv[]) {
+	double seconds = argc > 0 ? atof(argv[0]) : 3;
+	int threads = argc > 1 ? atoi(argv[1]) : 0;
+
+	World world(1);
+	generate_all(&world);
+	ThreadPool pool(threads);
+
+	std::vector<Chunk *> chunks;
+	for (int x = WORLD::X / 2 - 1; x <= WORLD::X / 2; ++x)
+		for (int y = WORLD::Y / 2 - 1; y <= WORLD::Y / 2; ++y)
+			for (int z = WORLD::Z / 2 - 1; z <= WORLD::Z / 2; ++z)
+				chunks.push_back(world.getChunk(x, y, z));
+
+	srand(1);
+	long long edits = 0;
+	int snapshots = 0, kept = 0, stale = 0, changed = 0, wrong = 0;
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	double end = now_ms() + seconds * 1000;
+
+	while (now_ms() < end) {
+		std::vector<ChunkSnapshot *> batch;
+		std::vector<uint32_t> before;
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (!chunks[i]->isChanged())
+				continue;
+			batch.push_back(new ChunkSnapshot);
+			chunks[i]->takeSnapshot(batch.back());
+			before.push_back(snapshot_hash(*batch.back()));
+		}
+		snapshots += (int)batch.size();
+
+		int count = (int)batch.size();
+		std::vector<int> counts(count), faces(count * 6);
+		std::vector<uint32_t> meshes(count), after(count);
+		std::atomic<bool> done(false);
+
+		std::thread mesher([&]() {
+			pool.parallelFor(count, [&](int i) {
+				std::vector<byte4> vertex(CHUNK::VERTICES);
+				counts[i] = batch[i]->mesh(&vertex[0], &faces[i * 6]);
+				meshes[i] = mesh_hash(&vertex[0], counts[i]);
+				after[i] = snapshot_hash(*batch[i]);
+			});
+			done = true;
+		});
+
+		// Edit while the meshers run, on chunk borders too. A few edits per round leave
+		// some chunks untouched, so both stale and current meshes come back.
+		for (int budget = rand() % 8; budget > 0 && !done; --budget) {
+			int x = rand() % (CHUNK::X * 2) - CHUNK::X;
+			int y = rand() % (CHUNK::Y * 2) - CHUNK::Y;
+			int z = rand() % (CHUNK::Z * 2) - CHUNK::Z;
+			world.setBlock(x, y, z, rand() % 2 ? 6 : BLOCK::AIR);
+			++edits;
+		}
+		mesher.join();
+
+		for (int i = 0; i < count; ++i) {
+			changed += after[i] != before[i];
+
+			Chunk *chunk = batch[i]->getChunk();
+			if (!chunk->meshed(*batch[i], &faces[i * 6])) {
+				++stale;
+			}
+			else {
+				++kept;
+				ChunkSnapshot now;
+				chunk->takeSnapshot(&now);
+				int n = now.mesh(&vertices[0]);
+				wrong += n != counts[i] || mesh_hash(&vertices[0], n) != meshes[i];
+			}
+			delete batch[i];
+		}
+	}
+
+	printf("%lld edits, %d snapshots meshed in parallel: %d meshes kept, %d stale ones dropped\n",
+		edits, snapshots, kept, stale);
+	if (changed)
+		printf("%d snapshots changed while they were meshed\n", changed);
+	if (wrong)
+		printf("%d kept meshes differ from the chunk\n", wrong);
+	return changed || wrong ? 1 : 0;
+}
+
+// Synthetic frame costs for the governor, in milliseconds: a fixed part, a part per chunk
+// drawn, which grows with the cube of the view distance, and parts per chunk generated and
+// meshed. Work to generate and mesh arrives every frame and piles up when the budget is
+// too small for it. From frame step on everything costs factor times as much.
+struct CostModel {
+	const char *name;
+	double fixed, draw, generate, mesh;
+	double arrivals, changes;
+	int burst, burstEnd;
+	double burstArrivals;
+	int step;
+	double factor;
+};
+
+// Runs the governor against synthetic cost models, each for a number of frames, and
+// checks that it settles under the target and gives the budget back when there is room.
+// Arguments: [frames] [target ms]
+static int bench_governor(int argc, char *argv[]) {
+	int frames = argc > 0 ? atoi(argv[0]) : 600;
+	double target = argc > 1 ? atof(argv[1]) : GOVERNOR::TARGET_MS;
+	static const int SETTLE = 60;
+
+	static const CostModel models[] = {
+		{ "idle", 1.0, 0.002, 0.3, 0.1, 0.2, 1, 0, 0, 0, 0, 1 },
+		{ "draw bound", 2.0, 0.06, 0.3, 0.1, 0.2, 1, 0, 0, 0, 0, 1 },
+		{ "teleport", 3.0, 0.01, 2.5, 0.4, 0.1, 2, 100, 160, 8, 0, 1 },
+		{ "slowdown", 2.0, 0.02, 0.5, 0.2, 0.3, 2, 0, 0, 0, 300, 2.5 },
+	};
+
+	int failed = 0;
+	for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); ++m) {
+		const CostModel &model = models[m];
+		FrameGovernor governor(target);
+		srand(1);
+
+		double generate = 0, mesh = 0, slept = 0;
+		std::vector<double> costs;
+		int counted = 0, over = 0;
+
+		for (int f = 0; f < frames; ++f) {
+			const RenderBudget &budget = governor.getBudget();
+			generate += f >= model.burst && f < model.burstEnd ? model.burstArrivals : model.arrivals;
+			mesh += model.changes;
+
+			int generated = std::min(budget.generate, (int)generate);
+			int meshed = std::min(budget.mesh, (int)mesh);
+			generate -= generated;
+			mesh -= meshed;
+
+			// A quarter of the chunks within view distance are in front of the camera
+			float r = budget.distance / CHUNK::X;
+			double drawn = std::min(WORLD::X * WORLD::Y * WORLD::Z, (int)(4.18879 * r * r * r / 4));
+
+			double cost = model.fixed + model.draw * drawn + model.generate * generated + model.mesh * meshed;
+			cost *= (f >= model.step && model.step ? model.factor : 1) * (0.9 + 0.2 * rand() / RAND_MAX);
+
+			governor.frame(cost);
+			slept += governor.sleep(cost);
+			costs.push_back(cost);
+
+			// Give the governor time to settle at the start and after a step
+			if (f >= SETTLE && (!model.step || f < model.step || f >= model.step + SETTLE)) {
+				++counted;
+				over += cost > target;
+			}
+		}
+
+		std::sort(costs.begin(), costs.end());
+		const RenderBudget &budget = governor.getBudget();
+		const GovernorStats &stats = governor.getStats();
+		printf("%-10s  p50 %5.2f ms  p95 %5.2f ms  over target %4.1f%%  sleep %5.2f ms/frame  "
+			"distance %3.0f  generate %d  mesh %2d  backlog %d/%d  cuts %d  raises %d\n",
+			model.name, costs[costs.size() / 2], costs[costs.size() * 95 / 100], 100.0 * over / std::max(counted, 1),
+			slept / frames, budget.distance, budget.generate, budget.mesh, (int)generate, (int)mesh, stats.cuts, stats.raises);
+
+		failed += over > counted / 20;
+	}
+
+	if (failed)
+		printf("%d cost models over target in more than 5%% of settled frames\n", failed);
+	return failed ? 1 : 0;
+}
+
+// Place in the scheduler's order of the chunk at grid index (x, y, z) for a camera at the
+// centre of the world, or -1 if it isn't queued.
+static int load_place(const glm::vec3 &forward, const glm::vec3 &velocity, int x, int y, int z) {
+	World world(1);
+	world.setHeadless(true);
+	ChunkScheduler scheduler;
+	scheduler.update(&world, glm::vec3(CHUNK::X, CHUNK::Y, CHUNK::Z) * 0.5f, forward, velocity, 64.0f);
+
+	int cx, cy, cz;
+	for (int place = 0; scheduler.next(&cx, &cy, &cz); ++place)
+		if (cx == x && cy == y && cz == z)
+			return place;
+	return -1;
+}
+
+// Time until the chunks around the camera are loaded after a teleport, headless, for a
+// range of chunks loaded per frame. The view is loaded when the chunks within the radius
+// and 30 degrees of the view direction are, the whole radius when all chunks within it are.
+// Fails if either never happens, or if the scheduler doesn't queue a chunk ahead of the
+// camera before one as far behind it, and one it moves towards before one as far the
+// other way.
+// Arguments: [radius in blocks]
+static int bench_teleport(int argc, char *argv[]) {
+	int wrong = 0;
+	int cx = WORLD::X / 2, cy = WORLD::Y / 2, cz = WORLD::Z / 2;
+	int ahead = load_place(glm::vec3(1, 0, 0), glm::vec3(0), cx + 2, cy, cz);
+	int behind = load_place(glm::vec3(1, 0, 0), glm::vec3(0), cx - 2, cy, cz);
+	int towards = load_place(glm::vec3(1, 0, 0), glm::vec3(0, 0, 10), cx, cy, cz + 2);
+	int away = load_place(glm::vec3(1, 0, 0), glm::vec3(0, 0, 10), cx, cy, cz - 2);
+	printf("load order: ahead %d, behind %d, moving towards %d, moving away %d\n", ahead, behind, towards, away);
+	if (ahead < 0 || behind < 0 || ahead >= behind) {
+		printf("a chunk ahead of the camera isn't queued before one behind it\n");
+		++wrong;
+	}
+	if (towards < 0 || away < 0 || towards >= away) {
+		printf("a chunk the camera moves towards isn't queued before one it moves away from\n");
+		++wrong;
+	}
+
+	float radius = argc > 0 ? (float)atof(argv[0]) : 64.0f;
+	static const int rates[] = { 1, 2, 4, 8 };
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f * WINDOW::WIDTH / WINDOW::HEIGHT, 0.01f, 1000.0f);
+
+	for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+		World world(1);
+		world.setHeadless(true);
+		RenderBudget budget;
+		budget.distance = radius;
+		budget.generate = rates[r];
+		world.setBudget(budget);
+
+		// Settle at one end of the world, then jump to the other
+		glm::vec3 eye(-40, 12, -40), forward(1, 0, 0);
+		for (int f = 0; f < 2000; ++f) {
+			world.schedule(eye, forward, glm::vec3(0));
+			world.render(projection * glm::lookAt(eye, eye + forward, glm::vec3(0, 1, 0)));
+		}
+
+		eye = glm::vec3(40, 12, 40);
+		forward = glm::vec3(0, 0, -1);
+		int frames = 0, view = -1, all = -1;
+		double t = now_ms(), viewMs = 0, allMs = 0;
+
+		while (all < 0 && frames < 10000) {
+			world.schedule(eye, forward, glm::vec3(0));
+			world.render(projection * glm::lookAt(eye, eye + forward, glm::vec3(0, 1, 0)));
+			++frames;
+
+			bool viewLoaded = true, allLoaded = true;
+			for (int x = 0; x < WORLD::X; ++x) {
+				for (int y = 0; y < WORLD::Y; ++y) {
+					for (int z = 0; z < WORLD::Z; ++z) {
+						glm::vec3 to = (glm::vec3(x - WORLD::X / 2, y - WORLD::Y / 2, z - WORLD::Z / 2) + 0.5f) * glm::vec3(CHUNK::X, CHUNK::Y, CHUNK::Z) - eye;
+						float d = glm::length(to);
+						if (d > radius || world.getChunk(x, y, z)->isReady())
+							continue;
+						allLoaded = false;
+						if (d < CHUNK::X || glm::dot(to, forward) > d * 0.866f)
+							viewLoaded = false;
+					}
+				}
+			}
+
+			if (viewLoaded && view < 0) {
+				view = frames;
+				viewMs = now_ms() - t;
+			}
+			if (allLoaded) {
+				all = frames;
+				allMs = now_ms() - t;
+			}
+		}
+
+		printf("%d chunks/frame: view loaded after %d frames (%.1f ms), whole radius after %d frames (%.1f ms)\n",
+			rates[r], view, viewMs, all, allMs);
+		if (all < 0) {
+			printf("%d chunks/frame: the %s never loaded\n", rates[r], view < 0 ? "view" : "whole radius");
+			++wrong;
+		}
+		else if (view > all) {
+			printf("%d chunks/frame: the view loaded after the whole radius\n", rates[r]);
+			++wrong;
+		}
+	}
+	return wrong ? 1 : 0;
+}
+
+// Is chunk at grid index (x, y, z) ready to mesh by its stages alone: are it and all its
+// neighbours generated?
+static bool ready_by_stages(const World &world, int x, int y, int z) {
+	static const int step[7][3] = { { 0, 0, 0 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+	for (int s = 0; s < 7; ++s) {
+		Chunk *chunk = world.getChunk(x + step[s][0], y + step[s][1], z + step[s][2]);
+		if (chunk && chunk->getStage() == STAGE_EMPTY)
+			return false;
+	}
+	return true;
+}
+
+// Counts the chunks whose readiness differs from what their neighbours' stages say, or
+// that have a mesh without being ready.
+static int lifecycle_violations(const World &world) {
+	int violations = 0;
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				bool ready = ready_by_stages(world, x, y, z);
+				Chunk *chunk = world.getChunk(x, y, z);
+				violations += chunk->isReady() != ready;
+				violations += chunk->getStage() >= STAGE_MESHED && !ready;
+			}
+		}
+	}
+	return violations;
+}
+
+// Checks the chunk lifecycle keeps its order. Chunks are generated in random order, and
+// after each every chunk must be ready exactly when it and its neighbours are generated;
+// meshing a random chunk must move it up a stage only when it is ready. Random edits must
+// drop the chunk and the neighbours they touch back to generated. Last, headless frames
+// from random eyes must only mesh ready chunks.
+// Arguments: [seed] [frames]
+static int bench_lifecycle(int argc, char *argv[]) {
+	srand(argc > 0 ? atoi(argv[0]) : 1);
+	int frames = argc > 1 ? atoi(argv[1]) : 200;
+
+	World world(1);
+	world.setHeadless(true);
+	std::vector<byte4> vertex(CHUNK::VERTICES);
+	int violations = 0, checks = 0, early = 0;
+
+	std::vector<int> order(WORLD::X * WORLD::Y * WORLD::Z);
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = (int)i;
+	for (size_t i = order.size() - 1; i > 0; --i)
+		std::swap(order[i], order[rand() % (i + 1)]);
+
+	double t = now_ms();
+	for (size_t i = 0; i < order.size(); ++i) {
+		int x = order[i] / (WORLD::Y * WORLD::Z), y = order[i] / WORLD::Z % WORLD::Y, z = order[i] % WORLD::Z;
+		world.generate(world.getChunk(x, y, z));
+		violations += lifecycle_violations(world);
+		++checks;
+
+		// Meshing only counts once the neighbours are in, and uploading needs the mesh
+		int m = order[rand() % (i + 1)];
+		Chunk *chunk = world.getChunk(m / (WORLD::Y * WORLD::Z), m / WORLD::Z % WORLD::Y, m % WORLD::Z);
+		ChunkStage before = chunk->getStage();
+		bool ready = chunk->isReady();
+		chunk->mesh(&vertex[0]);
+		ChunkStage after = chunk->getStage();
+		violations += after != (ready && before == STAGE_GENERATED ? STAGE_MESHED : before);
+		violations += chunk->canEnter(STAGE_UPLOADED) != (after == STAGE_MESHED);
+		early += ready && i + 1 < order.size();
+		++checks;
+	}
+	double generateMs = now_ms() - t;
+
+	// An edit on a chunk's edge takes the neighbour on that side back with it
+	for (int i = 0; i < 2000; ++i) {
+		int x = rand() % (CHUNK::X * WORLD::X) - CHUNK::X * (WORLD::X / 2);
+		int y = rand() % (CHUNK::Y * WORLD::Y) - CHUNK::Y * (WORLD::Y / 2);
+		int z = rand() % (CHUNK::Z * WORLD::Z) - CHUNK::Z * (WORLD::Z / 2);
+		if (i % 2)
+			x = (x & ~(CHUNK::X - 1)) + (i % 4 == 1 ? 0 : CHUNK::X - 1);
+
+		Chunk *chunk = world.findChunk(x, y, z);
+		Chunk *side = chunk->getNeighbour((x & (CHUNK::X - 1)) == 0 ? LEFT : RIGHT);
+		if (!(i % 2) || (z & (CHUNK::Z - 1)) == 0 || (z & (CHUNK::Z - 1)) == CHUNK::Z - 1 || (y & (CHUNK::Y - 1)) == 0 || (y & (CHUNK::Y - 1)) == CHUNK::Y - 1)
+			side = 0;
+		chunk->mesh(&vertex[0]);
+		if (side)
+			side->mesh(&vertex[0]);
+
+		chunk->setBlock(x & (CHUNK::X - 1), y & (CHUNK::Y - 1), z & (CHUNK::Z - 1), (uint8_t)(rand() % 2 * 6));
+		violations += chunk->getStage() != STAGE_GENERATED;
+		violations += side && side->getStage() != STAGE_GENERATED;
+		++checks;
+	}
+
+	// Frames mesh what the scheduler loads; none of it may be meshed before it is ready
+	World streamed(1);
+	streamed.setHeadless(true);
+	RenderBudget budget;
+	budget.distance = 64;
+	budget.generate = 2;
+	streamed.setBudget(budget);
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f * WINDOW::WIDTH / WINDOW::HEIGHT, 0.01f, 1000.0f);
+	int meshed = 0;
+	for (int f = 0; f < frames; ++f) {
+		glm::vec3 eye((float)(rand() % 96 - 48), (float)(rand() % 32), (float)(rand() % 96 - 48));
+		glm::vec3 forward(cosf(f * 0.3f), 0, sinf(f * 0.3f));
+		streamed.schedule(eye, forward, glm::vec3(0));
+		streamed.render(projection * glm::lookAt(eye, eye + forward, glm::vec3(0, 1, 0)));
+		meshed += streamed.getStats().meshed;
+		violations += lifecycle_violations(streamed);
+		++checks;
+	}
+
+	printf("generated %d chunks in random order in %.1f ms; %d meshes found their chunk ready before the last one\n",
+		(int)order.size(), generateMs, early);
+	printf("%d frames meshed %d chunks\n", frames, meshed);
+	printf("%d checks, %d violations\n", checks, violations);
+	return violations ? 1 : 0;
+}
+
+// Test region for comparing chunk shapes: the generated world, 256 blocks tall, stone
+// below the world and air above it. Blocks are stored [x][y][z].
+static const int REGION_X = CHUNK::X * WORLD::X;
+static const int REGION_Y = 256;
+static const int REGION_Z = CHUNK::Z * WORLD::Z;
+
+// The region as seen from one chunk of a shape, for the mesher
+struct RegionBlocks {
+	const std::vector<uint8_t> *region;
+	int x0, y0, z0;
+
+	uint8_t getBlock(int x, int y, int z) const {
+		x += x0;
+		y += y0;
+		z += z0;
+		if ((unsigned)x >= (unsigned)REGION_X || (unsigned)y >= (unsigned)REGION_Y || (unsigned)z >= (unsigned)REGION_Z)
+			return 0;
+		return (*region)[((size_t)x * REGION_Y + y) * REGION_Z + z];
+	}
+};
+
+// Meshes the region cut into chunks of Shape and prints what that costs.
+template <typename Shape>
+static void mesh_shape(const std::vector<uint8_t> &region) {
+	std::vector<typename Shape::Vertex> vertices(Shape::VERTICES);
+	int chunks = 0, drawCalls = 0;
+	size_t count = 0, blocks = 0;
+	double t = now_ms();
+
+	for (int x = 0; x < REGION_X; x += Shape::SIZE_X) {
+		for (int y = 0; y < REGION_Y; y += Shape::SIZE_Y) {
+			for (int z = 0; z < REGION_Z; z += Shape::SIZE_Z) {
+				RegionBlocks view = { &region, x, y, z };
+				int n = Shape::mesh(view, &vertices[0]);
+				++chunks;
+				count += n;
+				drawCalls += n > 0;
+
+				// Chunks with nothing but air need no blocks stored
+				bool empty = true;
+				for (int i = 0; i < Shape::BLOCKS && empty; ++i)
+					empty = !view.getBlock(i / (Shape::SIZE_Y * Shape::SIZE_Z), i / Shape::SIZE_Z % Shape::SIZE_Y, i % Shape::SIZE_Z);
+				blocks += empty ? 0 : Shape::BLOCKS;
+			}
+		}
+	}
+	t = now_ms() - t;
+
+	printf("%3dx%3dx%3d  %5d chunks  %5d draw calls  %8u vertices  %5.2f MB vertices  %5.2f MB blocks  meshed in %6.1f ms (%.3f ms/chunk)\n",
+		Shape::SIZE_X, Shape::SIZE_Y, Shape::SIZE_Z, chunks, drawCalls, (unsigned)count,
+		count * sizeof(typename Shape::Vertex) / 1048576.0, blocks / 1048576.0, t, t / chunks);
+}
+
+// The generated world cut into chunks of several shapes: draw calls, mesh time and memory
+// of each, to pick a chunk size for the view distance.
+static int bench_shapes(int argc, char *argv[]) {
+	World world(1);
+	generate_all(&world);
+
+	int bottom = -CHUNK::Y * (WORLD::Y / 2);
+	int top = CHUNK::Y * (WORLD::Y / 2);
+	std::vector<uint8_t> region((size_t)REGION_X * REGION_Y * REGION_Z);
+	for (int x = 0; x < REGION_X; ++x) {
+		for (int y = 0; y < REGION_Y; ++y) {
+			for (int z = 0; z < REGION_Z; ++z) {
+				int wy = y - REGION_Y / 2;
+				uint8_t type = wy < bottom ? 6 : wy >= top ? BLOCK::AIR : world.getBlock(x - REGION_X / 2, wy, z - REGION_Z / 2);
+				region[((size_t)x * REGION_Y + y) * REGION_Z + z] = type;
+			}
+		}
+	}
+
+	mesh_shape<ChunkShape<16, 16, 16> >(region);
+	mesh_shape<ChunkShape<32, 32, 32> >(region);
+	mesh_shape<ChunkShape<64, 64, 64> >(region);
+	mesh_shape<ChunkShape<32, 256, 32> >(region);
+	mesh_shape<ChunkShape<16, 256, 16> >(region);
+	return 0;
+}
+
+// Meshes every snapshot with registry, returning the vertices and adding the milliseconds
+// it took to ms.
+static size_t mesh_snapshots(const std::vector<ChunkSnapshot *> &snapshots, const BlockRegistry &registry, double *ms) {
+	std::vector<byte4> vertices(CHUNK::VERTICES);
+	size_t count = 0;
+	double t = now_ms();
+	for (size_t i = 0; i < snapshots.size(); ++i)
+		count += WorldChunkShape::mesh<ChunkLayout>(*snapshots[i], &vertices[0], 0, registry);
+	*ms += now_ms() - t;
+	return count;
+}
+
+// Mesher throughput with the block registry's lookup tables: with the registered blocks,
+// and with every block opaque, which must mesh the faces next to air and nothing else.
+// Arguments: [rounds]
+static int bench_blocks(int argc, char *argv[]) {
+	int rounds = argc > 0 ? atoi(argv[0]) : 5;
+
+	World world(1);
+	generate_all(&world);
+
+	std::vector<ChunkSnapshot *> snapshots;
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				snapshots.push_back(new ChunkSnapshot);
+				world.getChunk(x, y, z)->takeSnapshot(snapshots.back());
+			}
+		}
+	}
+
+	BlockRegistry opaque;
+	for (int id = 1; id < 256; ++id) {
+		BlockInfo info = { "solid", true, false, 0, { 0, 0, 0, 0, 0, 0 } };
+		opaque.add((BlockId)id, info);
+	}
+	opaque.compile();
+
+	// Faces next to air, counted the slow way
+	static const int step[6][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, -1, 0 }, { -1, 0, 0 }, { 1, 0, 0 } };
+	size_t expected = 0;
+	for (size_t i = 0; i < snapshots.size(); ++i)
+		for (int x = 0; x < CHUNK::X; ++x)
+			for (int y = 0; y < CHUNK::Y; ++y)
+				for (int z = 0; z < CHUNK::Z; ++z)
+					if (snapshots[i]->getBlock(x, y, z))
+						for (int s = 0; s < 6; ++s)
+							expected += 6 * !snapshots[i]->getBlock(x + step[s][0], y + step[s][1], z + step[s][2]);
+
+	double registered = 0, solid = 0;
+	size_t withRegistry = 0, withOpaque = 0;
+	for (int r = 0; r < rounds; ++r) {
+		withRegistry = mesh_snapshots(snapshots, BlockRegistry::get(), &registered);
+		withOpaque = mesh_snapshots(snapshots, opaque, &solid);
+	}
+	for (size_t i = 0; i < snapshots.size(); ++i)
+		delete snapshots[i];
+
+	double blocks = (double)snapshots.size() * CHUNK::X * CHUNK::Y * CHUNK::Z * rounds;
+	printf("%d registered blocks: %8u vertices, %6.1f ms per world, %6.1f M blocks/s\n",
+		BlockRegistry::get().getCount(), (unsigned)withRegistry, registered / rounds, blocks / registered / 1000);
+	printf("every block opaque:  %8u vertices, %6.1f ms per world, %6.1f M blocks/s\n",
+		(unsigned)withOpaque, solid / rounds, blocks / solid / 1000);
+	if (withOpaque != expected) {
+		printf("expected %u vertices next to air\n", (unsigned)expected);
+		return 1;
+	}
+	return 0;
+}
+
+// Draws the generated chunks around the middle of the world from random eyes, some of
+// them on block corners where faces are seen edge on, and checks every face the eye sees
+// is in a direction Chunk::facing picked. Reports how many vertices that submits against
+// all of them and against just the faces the eye sees.
+// Arguments: [eyes]
+static int bench_faces(int argc, char *argv[]) {
+	int eyes = argc > 0 ? atoi(argv[0]) : 200;
+
+	World world(1);
+	generate_all(&world);
+
+	// Outward normal of each Orientation
+	static const int normal[6][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, -1, 0 }, { -1, 0, 0 }, { 1, 0, 0 } };
+
+	std::vector<Chunk *> chunks;
+	std::vector<std::vector<byte4> > meshes;
+	std::vector<std::vector<int> > faces;
+	for (int x = WORLD::X / 2 - 2; x < WORLD::X / 2 + 2; ++x) {
+		for (int y = WORLD::Y / 2 - 2; y < WORLD::Y / 2 + 2; ++y) {
+			for (int z = WORLD::Z / 2 - 2; z < WORLD::Z / 2 + 2; ++z) {
+				ChunkSnapshot snapshot;
+				world.getChunk(x, y, z)->takeSnapshot(&snapshot);
+				std::vector<byte4> vertex(CHUNK::VERTICES);
+				std::vector<int> face(6);
+				vertex.resize(snapshot.mesh(&vertex[0], &face[0]));
+				chunks.push_back(world.getChunk(x, y, z));
+				meshes.push_back(vertex);
+				faces.push_back(face);
+			}
+		}
+	}
+
+	// Every face must lie flat across its bucket's axis
+	int misplaced = 0;
+	for (size_t c = 0; c < chunks.size(); ++c) {
+		for (int o = FRONT, i = 0; o <= RIGHT; ++o) {
+			int axis = normal[o][0] ? 0 : normal[o][1] ? 1 : 2;
+			for (int end = i + faces[c][o]; i < end; i += 6) {
+				bool flat = true;
+				for (int v = 1; v < 6; ++v)
+					flat = flat && meshes[c][i + v][axis] == meshes[c][i][axis];
+				misplaced += !flat;
+			}
+		}
+	}
+
+	srand(1);
+	long long total = 0, submitted = 0, seen = 0;
+	int missed = 0;
+	float range = 2.5f * CHUNK::X;
+	for (int e = 0; e < eyes; ++e) {
+		glm::vec3 eye;
+		for (int a = 0; a < 3; ++a) {
+			eye[a] = (rand() / (float)RAND_MAX * 2 - 1) * range;
+			if (e % 2)
+				eye[a] = floorf(eye[a]);
+		}
+
+		for (size_t c = 0; c < chunks.size(); ++c) {
+			glm::vec3 origin(chunks[c]->getX() * CHUNK::X, chunks[c]->getY() * CHUNK::Y, chunks[c]->getZ() * CHUNK::Z);
+			glm::vec3 local = eye - origin;
+			int mask = Chunk::facing(local);
+
+			for (int o = FRONT, i = 0; o <= RIGHT; ++o) {
+				total += faces[c][o];
+				if (mask & (1 << o))
+					submitted += faces[c][o];
+
+				// The eye sees a face when it is on the side the face looks out to
+				for (int end = i + faces[c][o]; i < end; i += 6) {
+					const byte4 &v = meshes[c][i];
+					float side = normal[o][0] * (local.x - v.x) + normal[o][1] * (local.y - v.y) + normal[o][2] * (local.z - v.z);
+					if (side > 0) {
+						seen += 6;
+						missed += !(mask & (1 << o));
+					}
+				}
+			}
+		}
+	}
+
+	printf("%d eyes on %d chunks: %lld vertices, %lld submitted (%.1f%%), %lld facing the eye (%.1f%%)\n",
+		eyes, (int)chunks.size(), total, submitted, 100.0 * submitted / total, seen, 100.0 * seen / total);
+	if (missed || misplaced) {
+		printf("%d faces facing the eye were not submitted, %d faces in the wrong bucket\n", missed, misplaced);
+		return 1;
+	}
+	return 0;
+}
+
+// Meshes every chunk of a generated world, packs the meshes into faces for vertex pulling
+// and checks each face expands back into the vertices it came from. Reports the upload
+// size of both and how long packing takes.
+// Arguments: [rounds]
+static int bench_pull(int argc, char *argv[]) {
+	int rounds = argc > 0 ? atoi(argv[0]) : 5;
+
+	World world(1);
+	generate_all(&world);
+
+	std::vector<byte4> vertex(CHUNK::VERTICES);
+	std::vector<WorldChunkShape::Face> faces(CHUNK::VERTICES / 6);
+	size_t vertices = 0;
+	int wrong = 0;
+	double mesh = 0, pack = 0;
+
+	for (int r = 0; r < rounds; ++r) {
+		for (int x = 0; x < WORLD::X; ++x) {
+			for (int y = 0; y < WORLD::Y; ++y) {
+				for (int z = 0; z < WORLD::Z; ++z) {
+					ChunkSnapshot snapshot;
+					world.getChunk(x, y, z)->takeSnapshot(&snapshot);
+					int counts[6];
+					double t = now_ms();
+					int count = snapshot.mesh(&vertex[0], counts);
+					mesh += now_ms() - t;
+
+					t = now_ms();
+					WorldChunkShape::pack(&vertex[0], counts, &faces[0]);
+					pack += now_ms() - t;
+
+					if (r == 0) {
+						vertices += count;
+						for (int i = 0; i < count; ++i) {
+							byte4 v = WorldChunkShape::unpack(faces[i / 6], i % 6);
+							wrong += memcmp(&v, &vertex[i], sizeof(v)) != 0;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	printf("%u vertices: %8u bytes as vertices, %8u as packed faces\n", (unsigned)vertices,
+		(unsigned)(vertices * sizeof(byte4)), (unsigned)(vertices / 6 * sizeof(WorldChunkShape::Face)));
+	printf("meshing %6.1f ms per world, packing %5.2f ms more\n", mesh / rounds, pack / rounds);
+	if (wrong) {
+		printf("%d vertices unpacked wrong\n", wrong);
+		return 1;
+	}
+	return 0;
+}
+
+// One chunk of the region stored in Layout order. Blocks outside it are air.
+template <typename Shape, typename Layout>
+struct LayoutBlocks {
+	const uint8_t *block;
+
+	uint8_t getBlock(int x, int y, int z) const {
+		if ((unsigned)x >= (unsigned)Shape::SIZE_X || (unsigned)y >= (unsigned)Shape::SIZE_Y || (unsigned)z >= (unsigned)Shape::SIZE_Z)
+			return 0;
+		return block[Layout::index(x, y, z)];
+	}
+};
+
+// Sky light flooded down and sideways through the air of one chunk: 15 straight down
+// from open sky, one less for every other step. Returns the sum of the light.
+template <typename Shape, typename Layout>
+static uint32_t flood_light(const uint8_t *block, uint8_t *light, std::vector<int> &queue) {
+	static const int step[6][3] = { { 0, -1, 0 }, { 0, 1, 0 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+	memset(light, 0, Shape::BLOCKS);
+	queue.clear();
+	for (int x = 0; x < Shape::SIZE_X; ++x) {
+		for (int z = 0; z < Shape::SIZE_Z; ++z) {
+			int i = Layout::index(x, Shape::SIZE_Y - 1, z);
+			if (!block[i]) {
+				light[i] = 15;
+				queue.push_back(i);
+			}
+		}
+	}
+
+	uint32_t sum = 0;
+	for (size_t head = 0; head < queue.size(); ++head) {
+		int x, y, z;
+		Layout::position(queue[head], &x, &y, &z);
+		int level = light[queue[head]];
+		sum += level;
+		for (int s = 0; s < 6; ++s) {
+			int nx = x + step[s][0], ny = y + step[s][1], nz = z + step[s][2];
+			if ((unsigned)nx >= (unsigned)Shape::SIZE_X || (unsigned)ny >= (unsigned)Shape::SIZE_Y || (unsigned)nz >= (unsigned)Shape::SIZE_Z)
+				continue;
+			int n = Layout::index(nx, ny, nz);
+			int next = s == 0 && level == 15 ? 15 : level - 1;
+			if (block[n] || light[n] >= next)
+				continue;
+			light[n] = next;
+			queue.push_back(n);
+		}
+	}
+	return sum;
+}
+
+// Walks a ray through one chunk block by block until it hits a solid block or leaves.
+// Returns the blocks stepped through, negated if it hit.
+template <typename Shape, typename Layout>
+static int cast_ray(const uint8_t *block, glm::vec3 origin, glm::vec3 direction) {
+	static const int size[3] = { Shape::SIZE_X, Shape::SIZE_Y, Shape::SIZE_Z };
+	int cell[3], step[3];
+	float next[3], delta[3];
+	for (int a = 0; a < 3; ++a) {
+		cell[a] = (int)floorf(origin[a]);
+		step[a] = direction[a] < 0 ? -1 : 1;
+		delta[a] = direction[a] != 0 ? fabsf(1 / direction[a]) : 1e30f;
+		float edge = direction[a] < 0 ? origin[a] - cell[a] : cell[a] + 1 - origin[a];
+		next[a] = direction[a] != 0 ? edge * delta[a] : 1e30f;
+	}
+
+	for (int steps = 1;; ++steps) {
+		if (block[Layout::index(cell[0], cell[1], cell[2])])
+			return -steps;
+		int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		cell[a] += step[a];
+		next[a] += delta[a];
+		if ((unsigned)cell[a] >= (unsigned)size[a])
+			return steps;
+	}
+}
+
+// Runs meshing, sky light, height sweeps and rays over the region cut into chunks of
+// Shape stored in Layout order. Prints the time of each and puts their results in check,
+// which must come out the same whatever the layout.
+template <typename Shape, typename Layout>
+static void layout_workloads(const std::vector<uint8_t> &region, const char *name, uint32_t check[4]) {
+	std::vector<uint8_t> stored;
+	for (int x0 = 0; x0 < REGION_X; x0 += Shape::SIZE_X) {
+		for (int y0 = 0; y0 < REGION_Y; y0 += Shape::SIZE_Y) {
+			for (int z0 = 0; z0 < REGION_Z; z0 += Shape::SIZE_Z) {
+				size_t base = stored.size();
+				stored.resize(base + Shape::BLOCKS);
+				for (int x = 0; x < Shape::SIZE_X; ++x)
+					for (int y = 0; y < Shape::SIZE_Y; ++y)
+						for (int z = 0; z < Shape::SIZE_Z; ++z)
+							stored[base + Layout::index(x, y, z)] = region[((size_t)(x0 + x) * REGION_Y + y0 + y) * REGION_Z + z0 + z];
+			}
+		}
+	}
+	int chunks = (int)(stored.size() / Shape::BLOCKS);
+	memset(check, 0, 4 * sizeof(uint32_t));
+
+	std::vector<typename Shape::Vertex> vertices(Shape::VERTICES);
+	double t = now_ms();
+	for (int c = 0; c < chunks; ++c) {
+		LayoutBlocks<Shape, Layout> blocks = { &stored[(size_t)c * Shape::BLOCKS] };
+		check[0] += Shape::template mesh<Layout>(blocks, &vertices[0]);
+	}
+	double mesh = now_ms() - t;
+
+	std::vector<uint8_t> light(Shape::BLOCKS);
+	std::vector<int> queue;
+	t = now_ms();
+	for (int c = 0; c < chunks; ++c)
+		check[1] += flood_light<Shape, Layout>(&stored[(size_t)c * Shape::BLOCKS], &light[0], queue);
+	double lit = now_ms() - t;
+
+	t = now_ms();
+	for (int c = 0; c < chunks; ++c) {
+		const uint8_t *block = &stored[(size_t)c * Shape::BLOCKS];
+		for (int x = 0; x < Shape::SIZE_X; ++x) {
+			for (int z = 0; z < Shape::SIZE_Z; ++z) {
+				int y = Shape::SIZE_Y - 1;
+				while (y >= 0 && !block[Layout::index(x, y, z)])
+					--y;
+				check[2] += y + 1;
+			}
+		}
+	}
+	double heights = now_ms() - t;
+
+	srand(1);
+	int rays = 0;
+	t = now_ms();
+	for (int c = 0; c < chunks; ++c) {
+		const uint8_t *block = &stored[(size_t)c * Shape::BLOCKS];
+		for (int r = 0; r < 256; ++r, ++rays) {
+			glm::vec3 origin(rand() % (Shape::SIZE_X * 64) / 64.0f, rand() % (Shape::SIZE_Y * 64) / 64.0f, rand() % (Shape::SIZE_Z * 64) / 64.0f);
+			glm::vec3 direction(rand() % 201 - 100, rand() % 201 - 100, rand() % 201 - 100);
+			check[3] += cast_ray<Shape, Layout>(block, origin, direction);
+		}
+	}
+	double cast = now_ms() - t;
+
+	printf("%3dx%3dx%3d %-9s  mesh %7.1f ms  light %7.1f ms  heights %6.2f ms  %d rays %6.1f ms\n",
+		Shape::SIZE_X, Shape::SIZE_Y, Shape::SIZE_Z, name, mesh, lit, heights, rays, cast);
+}
+
+template <typename Shape>
+static bool compare_layouts(const std::vector<uint8_t> &region) {
+	uint32_t rows[4], morton[4];
+	layout_workloads<Shape, RowMajorLayout<Shape::SIZE_X, Shape::SIZE_Y, Shape::SIZE_Z> >(region, "row-major", rows);
+	layout_workloads<Shape, MortonLayout<Shape::SIZE_X, Shape::SIZE_Y, Shape::SIZE_Z> >(region, "Morton", morton);
+	if (memcmp(rows, morton, sizeof(rows)) == 0)
+		return true;
+	printf("layouts disagree: %u/%u vertices, %u/%u light, %u/%u heights, %u/%u ray steps\n",
+		rows[0], morton[0], rows[1], morton[1], rows[2], morton[2], rows[3], morton[3]);
+	return false;
+}
+
+// The generated world in chunks stored row-major and in Morton order, timing the ways
+// blocks get walked: meshing, sky light flood fill, vertical sweeps for heights and rays.
+static int bench_layouts(int argc, char *argv[]) {
+	World world(1);
+	generate_all(&world);
+
+	int bottom = -CHUNK::Y * (WORLD::Y / 2);
+	int top = CHUNK::Y * (WORLD::Y / 2);
+	std::vector<uint8_t> region((size_t)REGION_X * REGION_Y * REGION_Z);
+	for (int x = 0; x < REGION_X; ++x) {
+		for (int y = 0; y < REGION_Y; ++y) {
+			for (int z = 0; z < REGION_Z; ++z) {
+				int wy = y - REGION_Y / 2;
+				uint8_t type = wy < bottom ? 6 : wy >= top ? BLOCK::AIR : world.getBlock(x - REGION_X / 2, wy, z - REGION_Z / 2);
+				region[((size_t)x * REGION_Y + y) * REGION_Z + z] = type;
+			}
+		}
+	}
+
+	bool same = compare_layouts<ChunkShape<16, 16, 16> >(region);
+	same = compare_layouts<ChunkShape<32, 32, 32> >(region) && same;
+	same = compare_layouts<ChunkShape<64, 64, 64> >(region) && same;
+	return same ? 0 : 1;
+}
+
+// Chunks within radius chunks of the middle of the world, with their centres.
+static std::vector<Chunk *> chunks_within(const World &world, int radius) {
+	std::vector<Chunk *> chunks;
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				glm::vec3 offset = glm::vec3(x - WORLD::X / 2, y - WORLD::Y / 2, z - WORLD::Z / 2) + 0.5f;
+				if (glm::length(offset) <= radius)
+					chunks.push_back(world.getChunk(x, y, z));
+			}
+		}
+	}
+	return chunks;
+}
+
+// Cold against warm start with the mesh cache: generates and meshes every chunk within
+// radius chunks of the middle of the world, first with an empty cache, then from what the
+// first run left. Checks that cached meshes are the ones the mesher builds, that edits
+// miss for exactly the chunks they touch, and that the file stays within a small limit
+// while keeping the meshes used last. Arguments: [radius] [name]
+static int bench_meshcache(int argc, char *argv[]) {
+	int radius = argc > 0 ? atoi(argv[0]) : 16;
+	std::string name = argc > 1 ? argv[1] : "meshcache_bench";
+	std::string filename = name + ".meshes";
+	remove(filename.c_str());
+
+	std::vector<byte4> vertex(CHUNK::VERTICES);
+	std::vector<uint32_t> cold;
+	int wrong = 0;
+
+	for (int pass = 0; pass < 2; ++pass) {
+		World world(1);
+		MeshCache cache;
+		double t = now_ms();
+		if (!cache.open(filename.c_str()))
+			return 1;
+		double open = now_ms() - t;
+
+		std::vector<Chunk *> chunks = chunks_within(world, radius);
+		t = now_ms();
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			world.generate(chunks[i]);
+			for (int o = FRONT; o <= RIGHT; ++o)
+				if (chunks[i]->getNeighbour((Orientation)o))
+					world.generate(chunks[i]->getNeighbour((Orientation)o));
+		}
+		double generate = now_ms() - t;
+
+		t = now_ms();
+		size_t vertices = 0;
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			int count = chunks[i]->mesh(&vertex[0], &cache);
+			vertices += count;
+			uint32_t hash = mesh_hash(&vertex[0], count);
+			if (pass)
+				wrong += hash != cold[i];
+			else
+				cold.push_back(hash);
+		}
+		double mesh = now_ms() - t;
+
+		printf("%s start, %u chunks within %d: open %.1f ms, generate %.1f ms, mesh %.1f ms (%.3f ms/chunk), %d hits, %d misses, %.1f MB cached\n",
+			pass ? "warm" : "cold", (unsigned)chunks.size(), radius, open, generate, mesh, mesh / std::max<size_t>(chunks.size(), 1),
+			cache.getHits(), cache.getMisses(), cache.getBytes() / 1e6);
+
+		if (!pass)
+			continue;
+
+		// Every cached mesh is the one the mesher builds now, and an edit misses for the
+		// chunk and the neighbour whose border it is on
+		std::vector<byte4> fresh(CHUNK::VERTICES);
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			ChunkSnapshot snapshot;
+			chunks[i]->takeSnapshot(&snapshot);
+			wrong += mesh_hash(&fresh[0], snapshot.mesh(&fresh[0])) != cold[i];
+		}
+		Chunk *edited = chunks[chunks.size() / 2], *side = edited->getNeighbour(LEFT);
+		edited->setBlock(0, CHUNK::Y / 2, CHUNK::Z / 2, edited->getBlock(0, CHUNK::Y / 2, CHUNK::Z / 2) ? BLOCK::AIR : 6);
+		int misses = cache.getMisses();
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (!chunks[i]->isChanged())
+				continue;
+			int count = chunks[i]->mesh(&vertex[0], &cache);
+			ChunkSnapshot snapshot;
+			chunks[i]->takeSnapshot(&snapshot);
+			wrong += mesh_hash(&vertex[0], count) != mesh_hash(&fresh[0], snapshot.mesh(&fresh[0]));
+		}
+		misses = cache.getMisses() - misses;
+		wrong += misses != 1 + (side != 0);
+		printf("an edit on a chunk border missed for %d chunks\n", misses);
+	}
+	remove(filename.c_str());
+
+	// A limit of a few chunks' meshes: sessions fill it, and close keeps what was used last
+	World world(1);
+	generate_all(&world);
+	std::vector<Chunk *> chunks = chunks_within(world, WORLD::X);
+	size_t limit = 2 << 20, largest = 0;
+	std::vector<bool> used(chunks.size(), false);
+	int kept = 0, lost = 0;
+	for (int session = 0; session < 3; ++session) {
+		MeshCache cache;
+		if (!cache.open(filename.c_str(), limit))
+			return 1;
+		// Every chunk in the first session, every seventh in the second, noting the ones the
+		// file still had; those must all come back in the third
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (session > 0 && i % 7)
+				continue;
+			int hits = cache.getHits();
+			chunks[i]->markChanged();
+			chunks[i]->mesh(&vertex[0], &cache);
+			largest = std::max(largest, cache.getBytes());
+			if (session == 1)
+				used[i] = cache.getHits() > hits;
+			else if (session == 2 && used[i]) {
+				kept += cache.getHits() > hits;
+				lost += cache.getHits() == hits;
+			}
+		}
+		cache.close();
+		largest = std::max(largest, cache.getBytes());
+	}
+	wrong += largest > limit || lost;
+	printf("%.1f MB limit: file peaked at %.2f MB, %d meshes used last kept, %d lost\n", limit / 1048576.0, largest / 1048576.0, kept, lost);
+	remove(filename.c_str());
+
+	if (wrong)
+		printf("%d meshes or misses wrong\n", wrong);
+	return wrong ? 1 : 0;
+}
+
+// A lap of a stadium around the middle of the world at the camera's move speed, looking
+// where it goes: two straights across the world joined by half circles, with a second of
+// hovering first
+static Replay stadium_flight() {
+	Replay flight;
+	flight.seed = 1;
+	float dt = 1.0f / 60, speed = 10, radius = 16, straight = 96;
+	for (int f = 0; f < 60; ++f) {
+		ReplayFrame frame = { dt, glm::vec3(-straight / 2, 8, -radius), glm::vec3((float)M_PI / 2, -0.2f, 0) };
+		flight.frames.push_back(frame);
+	}
+
+	float lap = 2 * straight + 2 * (float)M_PI * radius;
+	for (float s = 0; s < lap; s += speed * dt) {
+		glm::vec3 at;
+		float yaw;
+		if (s < straight) {
+			at = glm::vec3(-straight / 2 + s, 8, -radius);
+			yaw = (float)M_PI / 2;
+		}
+		else if (s < straight + (float)M_PI * radius) {
+			float a = (s - straight) / radius;
+			at = glm::vec3(straight / 2 + sinf(a) * radius, 8, -cosf(a) * radius);
+			yaw = (float)M_PI / 2 - a;
+		}
+		else if (s < 2 * straight + (float)M_PI * radius) {
+			at = glm::vec3(straight / 2 - (s - straight - (float)M_PI * radius), 8, radius);
+			yaw = -(float)M_PI / 2;
+		}
+		else {
+			float a = (s - 2 * straight - (float)M_PI * radius) / radius;
+			at = glm::vec3(-straight / 2 - sinf(a) * radius, 8, cosf(a) * radius);
+			yaw = -(float)M_PI / 2 - a;
+		}
+		ReplayFrame frame = { dt, at, glm::vec3(yaw, -0.2f, 0) };
+		flight.frames.push_back(frame);
+	}
+	return flight;
+}
+
+// Flies a recorded path, or a lap of a stadium, through a world whose meshes are all
+// in the mesh cache but only a few megabytes of them fit in memory, so meshes come and go
+// from disk as the camera moves. Played at rising speeds, with and without reading ahead:
+// frames in which meshing read the disk itself or waited for a read are stalls. Reports
+// the fastest stall-free speed and how full the I/O queue ran, and checks that meshes read
+// ahead are the ones the mesher builds. Arguments: [frames] [replay] [name]
+static int bench_prefetch(int argc, char *argv[]) {
+	int frames = argc > 0 ? atoi(argv[0]) : 600;
+	Replay flight = stadium_flight();
+	if (argc > 1 && !flight.load(argv[1]))
+		return 1;
+	std::string name = argc > 2 ? argv[2] : "prefetch_bench";
+	std::string filename = name + ".meshes";
+	remove(filename.c_str());
+
+	// Every mesh of the world on disk
+	std::vector<byte4> vertex(CHUNK::VERTICES), fresh(CHUNK::VERTICES);
+	{
+		World world(flight.seed);
+		generate_all(&world);
+		MeshCache cache;
+		if (!cache.open(filename.c_str()))
+			return 1;
+		std::vector<Chunk *> chunks = chunks_within(world, WORLD::X);
+		for (size_t i = 0; i < chunks.size(); ++i)
+			chunks[i]->mesh(&vertex[0], &cache);
+		printf("%u meshes cached, %.1f MB\n", (unsigned)chunks.size(), cache.getBytes() / 1e6);
+	}
+
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f * WINDOW::WIDTH / WINDOW::HEIGHT, 0.01f, 1000.0f);
+	static const int speeds[] = { 1, 2, 4, 8, 16, 32 };
+	int stallFree = 0, nearlyFree = 0, wrong = 0;
+	for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); ++s) {
+		for (int ahead = 0; ahead < 2; ++ahead) {
+			World world(flight.seed);
+			world.setHeadless(true);
+			generate_all(&world);
+			MeshCache cache;
+			if (!cache.open(filename.c_str()))
+				return 1;
+			world.setMeshCache(&cache);
+			RenderBudget budget;
+			budget.distance = 64;
+			budget.prefetch = ahead ? MESH_CACHE::PREFETCH : 0;
+			world.setBudget(budget);
+			MemoryLimits limits;
+			limits.meshes = 1 << 20;
+			limits.keepFrames = 10;
+			world.setMemoryLimits(limits);
+
+			// The path is played from where the camera starts to move; frames count from a
+			// second after that, when it has a heading to read ahead along
+			int start = std::min(60, frames / 4), counted = start + std::min(60, frames / 4);
+			int stalled = 0, stalls = 0, meshed = 0, prefetched = 0;
+			double worst = 0, stallMs = 0;
+			glm::vec3 last = flight.frames[0].position;
+			PrefetchStats before;
+			memset(&before, 0, sizeof(before));
+			for (int f = 0; f < frames; ++f) {
+				const ReplayFrame &frame = flight.frames[std::min(f, start) + (size_t)std::max(0, f - start) * speeds[s] % (flight.frames.size() - start)];
+				glm::vec3 at = frame.position, angle = frame.angle;
+				glm::vec3 forward(sinf(angle.x) * cosf(angle.y), sinf(angle.y), cosf(angle.x) * cosf(angle.y));
+				glm::vec3 velocity = frame.dt > 0 ? (at - last) / frame.dt : glm::vec3(0);
+				last = at;
+
+				world.schedule(at, forward, velocity);
+				world.render(projection * glm::lookAt(at, at + forward, glm::vec3(0, 1, 0)));
+				world.updateStorage(at);
+
+				PrefetchStats stats = cache.getPrefetchStats();
+				if (f >= counted) {
+					meshed += world.getStats().meshed;
+					prefetched += world.getStats().prefetched;
+					stalled += stats.stalls > before.stalls;
+					stalls += stats.stalls - before.stalls;
+					stallMs += stats.stallMs - before.stallMs;
+					worst = std::max(worst, stats.stallMs - before.stallMs);
+				}
+				before = stats;
+			}
+
+			PrefetchStats stats = cache.getPrefetchStats();
+			double depth = stats.samples ? (double)stats.depthSum / stats.samples : 0;
+			double backlog = stats.samples ? (double)stats.backlog / stats.samples : 0;
+			printf("%4d blocks/s %s: %d chunks meshed, %d of %d frames stalled (worst %.3f ms), %d stalls in %.2f ms",
+				10 * speeds[s], ahead ? "ahead" : "on use", meshed, stalled, frames - counted, worst, stalls, stallMs);
+			if (ahead)
+				printf("\n    %d asks, %d read (%d through io_uring), %d used; queue depth %.2f avg, %d max, %.0f%% of the %d the I/O threads take at once; %.2f left a frame later",
+					prefetched, stats.read, stats.ringRead, stats.used, depth, stats.maxDepth, 100 * depth / (MESH_CACHE::IO_THREADS * MESH_CACHE::IO_BATCH),
+					MESH_CACHE::IO_THREADS * MESH_CACHE::IO_BATCH, backlog);
+			printf("\n");
+			if (ahead && !stalled && stallFree == (int)s)
+				stallFree = (int)s + 1;
+			if (ahead && stalled * 100 <= frames - counted && nearlyFree == (int)s)
+				nearlyFree = (int)s + 1;
+
+			// Meshes read ahead are the ones the mesher builds: read as many chunks with
+			// different meshes as fit in the ready queue ahead, wait for them, then load them
+			if (!ahead || s)
+				continue;
+			std::vector<Chunk *> all = chunks_within(world, WORLD::X), chunks;
+			std::vector<uint64_t> keys;
+			for (size_t i = 0; i < all.size() && (int)chunks.size() < MESH_CACHE::READY; ++i) {
+				ChunkSnapshot snapshot;
+				all[i]->takeSnapshot(&snapshot);
+				uint64_t key = MeshCache::key(snapshot);
+				if (std::find(keys.begin(), keys.end(), key) != keys.end())
+					continue;
+				keys.push_back(key);
+				chunks.push_back(all[i]);
+			}
+			PrefetchStats was = cache.getPrefetchStats();
+			cache.prefetch(&keys[0], (int)keys.size());
+			int queued = cache.getPrefetchStats().requested - was.requested;
+			for (double t = now_ms(); cache.getPrefetchStats().read - was.read < queued && now_ms() - t < 5000;)
+				std::this_thread::yield();
+			for (size_t i = 0; i < chunks.size(); ++i) {
+				chunks[i]->markChanged();
+				int count = chunks[i]->mesh(&vertex[0], &cache);
+				ChunkSnapshot snapshot;
+				chunks[i]->takeSnapshot(&snapshot);
+				wrong += mesh_hash(&vertex[0], count) != mesh_hash(&fresh[0], snapshot.mesh(&fresh[0]));
+			}
+			int used = cache.getPrefetchStats().used - was.used;
+			wrong += used != (int)chunks.size();
+			printf("  %d of %d meshes loaded from the ready queue, %d wrong\n", used, (int)chunks.size(), wrong);
+		}
+	}
+	remove(filename.c_str());
+
+	if (stallFree)
+		printf("stall-free up to %d blocks/s\n", 10 * speeds[stallFree - 1]);
+	else
+		printf("no speed was stall-free\n");
+	if (nearlyFree)
+		printf("under 1%% of frames stalled up to %d blocks/s\n", 10 * speeds[nearlyFree - 1]);
+	return wrong ? 1 : 0;
+}
+
+struct Benchmark {
+	const char *name;
+	int (*run)(int argc, char *argv[]);
+	const char *description;
+};
+
+static const Benchmark benchmarks[] = {
+	{ "ticks", bench_ticks, "[ticks] [threads]  water and sand block updates per tick" },
+	{ "physics", bench_physics, "[entities] [ticks] [threads]  collision cases, then entities stepped per ms" },
+	{ "dag", bench_dag, "[columns]  memory of far terrain as voxel DAG versus dense arrays" },
+	{ "journal", bench_journal, "[edits] [name]  edit journal throughput, save pauses, load time and ticks during a save" },
+	{ "procedural", bench_procedural, "[sites] [edits]  memory and save size of generation plus diff" },
+	{ "memory", bench_memory, "[frames] [limit MB]  memory budget accounting, eviction order and a limited flight" },
+	{ "tiers", bench_tiers, "[reads]  resident memory and access latency of storage tiers by view distance" },
+	{ "heights", bench_heights, "[queries]  surface height queries per second" },
+	{ "accessor", bench_accessor, "[steps]  block reads along walks and lines, World::getBlock against a cached-chunk accessor" },
+	{ "snapshots", bench_snapshots, "[seconds] [threads]  edits racing parallel meshing of chunk snapshots" },
+	{ "blocks", bench_blocks, "[rounds]  mesher throughput with the block registry's lookup tables" },
+	{ "layouts", bench_layouts, "  row-major against Morton block order for meshing, light, heights and rays" },
+	{ "meshcache", bench_meshcache, "[radius] [name]  cold and warm start with meshes cached on disk" },
+	{ "prefetch", bench_prefetch, "[frames] [replay] [name]  stalls and I/O queue depth reading cached meshes ahead of a flight" },
+	{ "pull", bench_pull, "[rounds]  upload size and packing time of faces for vertex pulling" },
+	{ "faces", bench_faces, "[eyes]  vertices submitted when only directions facing the camera are drawn" },
+	{ "shapes", bench_shapes, "  draw calls, mesh time and memory of different chunk sizes" },
+	{ "lifecycle", bench_lifecycle, "[seed] [frames]  chunk stages and neighbour dependencies keep their order" },
+	{ "teleport", bench_teleport, "[radius]  frames until chunks are loaded after a teleport" },
+	{ "governor", bench_governor, "[frames] [target ms]  frame governor against synthetic cost models" },
+	{ "stream", bench_stream, "[clients] [seconds] [radius]  chunks served per second over loopback" },
+	{ "raymarch", bench_raymarch, "[width] [height] [threads] [prefix]  CPU raymarched rays per second" },
+};
+
+int run_benchmark(int argc, char *argv[]) {
+	int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+	for (int i = 0; i < count; ++i)
+		if (argc > 0 && !strcmp(argv[0], benchmarks[i].name))
+			return benchmarks[i].run(argc - 1, argv + 1);
+
+	fprintf(stderr, "Usage: --bench <name> [arguments]\n");
+	for (int i = 0; i < count; ++i)
+		fprintf(stderr, "  %-12s %s\n", benchmarks[i].name, benchmarks[i].description);
+	return 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Headless benchmarks that need no window or GL context.
+// Run with: DAT205_VoxelEngine --bench <name> [arguments]
+int run_benchmark(int argc, char *argv[]);
@@ -0,0 +1,51 @@
+#include "BlockAccessor.h"
+#include "World.h"
+
+BlockAccessor::BlockAccessor(World *world) : _world(world), _chunk(0) {
+	moveTo(0, 0, 0);
+}
+
+BlockAccessor::BlockAccessor(World *world, int x, int y, int z) : _world(world), _chunk(0) {
+	moveTo(x, y, z);
+}
+
+void BlockAccessor::moveTo(int x, int y, int z) {
+	_x = x;
+	_y = y;
+	_z = z;
+	resolve();
+}
+
+// Writes the block at the position, with the same bookkeeping as World::setBlock.
+void BlockAccessor::set(uint8_t type) {
+	if (!_chunk)
+		return;
+
+	_chunk->setBlock(_lx, _ly, _lz, type);
+	_world->edited(_cx, _cy, _cz, _x, _y, _z, type);
+}
+
+// Chunk the position is in, or 0 outside the world.
+Chunk *BlockAccessor::getChunk() const {
+	return _chunk;
+}
+
+int BlockAccessor::getX() const {
+	return _x;
+}
+
+int BlockAccessor::getY() const {
+	return _y;
+}
+
+int BlockAccessor::getZ() const {
+	return _z;
+}
+
+// Looks up the chunk under the position after it left the last one.
+void BlockAccessor::resolve() {
+	_chunk = World::locate(_x, _y, _z, &_cx, &_cy, &_cz) ? _world->getChunk(_cx, _cy, _cz) : 0;
+	_lx = _x & (CHUNK::X - 1);
+	_ly = _y & (CHUNK::Y - 1);
+	_lz = _z & (CHUNK::Z - 1);
+}
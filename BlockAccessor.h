@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Constants.h"
+#include "Chunk.h"
+
+class World;
+
+// Reads and writes the block at a position that moves a few blocks at a time, as walks
+// along rays, columns and flood fills do. The chunk under the position and the position
+// inside it are kept, so a move that stays in that chunk is an add and a bounds test, and
+// only one that crosses into another chunk goes through World again. Outside the world
+// every block reads as air and writes are dropped. Each thread needs its own instance.
+class BlockAccessor {
+public:
+	BlockAccessor(World *world);
+	BlockAccessor(World *world, int x, int y, int z);
+
+	void moveTo(int x, int y, int z);
+
+	void move(int dx, int dy, int dz) {
+		_x += dx;
+		_y += dy;
+		_z += dz;
+		_lx += dx;
+		_ly += dy;
+		_lz += dz;
+		if (!_chunk || (unsigned)_lx >= (unsigned)CHUNK::X || (unsigned)_ly >= (unsigned)CHUNK::Y || (unsigned)_lz >= (unsigned)CHUNK::Z)
+			resolve();
+	}
+
+	uint8_t get() const {
+		return _chunk ? _chunk->blockAt(_lx, _ly, _lz) : BLOCK::AIR;
+	}
+
+	void set(uint8_t type);
+	Chunk *getChunk() const;
+	int getX() const;
+	int getY() const;
+	int getZ() const;
+
+private:
+	void resolve();
+
+	World *_world;
+	Chunk *_chunk;
+	// Grid index of _chunk
+	int _cx, _cy, _cz;
+	// The position in the world and inside _chunk
+	int _x, _y, _z;
+	int _lx, _ly, _lz;
+};
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "BlockRegistry.h"
+
+// The blocks of textures.png, one tile each, registered before any file is loaded
+static const char *BUILTIN[] = {
+	"0 air clear all 0 0",
+	"1 dirt opaque all 0 1",
+	"2 topsoil opaque all 0 2",
+	"3 grass opaque all 0 3",
+	"4 leaves clear all 0 4",
+	"5 wood opaque all 0 5",
+	"6 stone opaque all 0 6",
+	"7 sand opaque all 0 7",
+	"8 water clear same 0 8",
+	"9 glass clear same 0 9",
+	"10 brick opaque all 0 10",
+	"11 ore opaque all 0 11",
+	"12 woodrings opaque all 0 12",
+	"13 white opaque all 0 13",
+	"14 black opaque all 0 14",
+	"15 x-y opaque all 0 15",
+};
+
+static BlockRegistry registry;
+
+BlockRegistry::BlockRegistry() : _hash(0), _count(0) {
+	for (int i = 0; i < (int)(sizeof(BUILTIN) / sizeof(BUILTIN[0])); ++i)
+		parse(BUILTIN[i], "built-in blocks", i + 1);
+	compile();
+}
+
+// The registry meshing uses.
+BlockRegistry &BlockRegistry::get() {
+	return registry;
+}
+
+// Registers the blocks listed in the file at path over the ones already there and
+// recompiles the tables. Returns false, keeping what could be read, if the file can't be
+// opened or has a bad line.
+bool BlockRegistry::load(const char *path) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	char line[256];
+	bool ok = true;
+	for (int number = 1; fgets(line, sizeof(line), file); ++number)
+		ok = parse(line, path, number) && ok;
+	fclose(file);
+
+	compile();
+	return ok;
+}
+
+bool BlockRegistry::parse(const char *line, const char *source, int number) {
+	// Skip blank lines and comments
+	const char *p = line + strspn(line, " \t\r\n");
+	if (!*p || *p == '#')
+		return true;
+
+	unsigned id;
+	char name[64], opacity[16], cull[16];
+	int t[6];
+	BlockInfo info;
+	int n = sscanf(p, "%u %63s %15s %15s %d %d %d %d %d %d %d", &id, name, opacity, cull, &info.light, &t[0], &t[1], &t[2], &t[3], &t[4], &t[5]);
+	if ((n != 6 && n != 11) || id > 0xFFFF || (strcmp(opacity, "opaque") && strcmp(opacity, "clear")) || (strcmp(cull, "same") && strcmp(cull, "all"))) {
+		fprintf(stderr, "Error: %s:%d: expected id name opaque|clear same|all light tile [5 more tiles]\n", source, number);
+		return false;
+	}
+
+	info.name = name;
+	info.opaque = !strcmp(opacity, "opaque");
+	info.cullSame = !strcmp(cull, "same");
+	for (int face = 0; face < 6; ++face)
+		info.tiles[face] = t[n == 6 ? 0 : face];
+
+	if (!add((BlockId)id, info)) {
+		fprintf(stderr, "Error: %s:%d: block %s is out of range\n", source, number, name);
+		return false;
+	}
+	return true;
+}
+
+// Registers or replaces the block with ID id. Takes effect with the next compile().
+// Returns false if the light or a tile is out of range, or if it tries to make air visible.
+bool BlockRegistry::add(BlockId id, const BlockInfo &info) {
+	if (info.light < 0 || info.light > 15)
+		return false;
+	// Tiles are stored in a signed byte of the vertex
+	for (int face = 0; face < 6; ++face)
+		if (info.tiles[face] < 0 || info.tiles[face] > 127)
+			return false;
+	if (id == 0 && info.opaque)
+		return false;
+
+	if (id >= _blocks.size()) {
+		_blocks.resize(id + 1);
+		_registered.resize(id + 1, false);
+	}
+	_count += !_registered[id];
+	_blocks[id] = info;
+	_registered[id] = true;
+	return true;
+}
+
+// Builds the lookup tables from the registered blocks.
+void BlockRegistry::compile() {
+	size_t ids = std::max((size_t)256, _blocks.size());
+	ids = (ids + 63) & ~(size_t)63;
+	_opaque.assign(ids / 64, 0);
+	_cullSame.assign(ids / 64, 0);
+	_light.assign(ids, 0);
+	_tiles.assign(ids * 6, 0);
+
+	for (size_t id = 0; id < ids; ++id) {
+		bool registered = id < _blocks.size() && _registered[id];
+		const BlockInfo *info = registered ? &_blocks[id] : 0;
+		if (registered ? info->opaque : id != 0)
+			_opaque[id >> 6] |= (uint64_t)1 << (id & 63);
+		if (registered && info->cullSame)
+			_cullSame[id >> 6] |= (uint64_t)1 << (id & 63);
+		_light[id] = registered ? (uint8_t)info->light : 0;
+		for (int face = 0; face < 6; ++face)
+			_tiles[id * 6 + face] = (uint8_t)(registered ? info->tiles[face] : id % 128);
+	}
+
+	// FNV-1a over the tables meshing reads
+	_hash = 14695981039346656037ull;
+	const uint8_t *tables[3] = { (const uint8_t *)&_opaque[0], (const uint8_t *)&_cullSame[0], &_tiles[0] };
+	size_t sizes[3] = { _opaque.size() * sizeof(uint64_t), _cullSame.size() * sizeof(uint64_t), _tiles.size() };
+	for (int t = 0; t < 3; ++t)
+		for (size_t i = 0; i < sizes[t]; ++i)
+			_hash = (_hash ^ tables[t][i]) * 1099511628211ull;
+}
+
+// The tables as of the last compile(); they stay valid until the next one.
+BlockTables BlockRegistry::getTables() const {
+	BlockTables tables = { &_opaque[0], &_cullSame[0], &_light[0], &_tiles[0] };
+	return tables;
+}
+
+// Hash of the tables as of the last compile(), for caches of meshes built with them.
+uint64_t BlockRegistry::getHash() const {
+	return _hash;
+}
+
+// The block registered with ID id, 0 if there is none.
+const BlockInfo *BlockRegistry::getInfo(BlockId id) const {
+	return id < _blocks.size() && _registered[id] ? &_blocks[id] : 0;
+}
+
+// ID of the block called name, 0 (air) if there is none.
+BlockId BlockRegistry::find(const char *name) const {
+	for (size_t id = 0; id < _blocks.size(); ++id)
+		if (_registered[id] && _blocks[id].name == name)
+			return (BlockId)id;
+	return 0;
+}
+
+// Number of registered blocks, air included
+int BlockRegistry::getCount() const {
+	return _count;
+}
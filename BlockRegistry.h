@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Block IDs have room for 65536 types, though chunks store only the first 256 for now
+typedef uint16_t BlockId;
+
+// What a block type looks like and how it behaves.
+struct BlockInfo {
+	std::string name;
+	// Hides the faces of the blocks next to it
+	bool opaque;
+	// Faces between two blocks of this type are dropped, as between water blocks
+	bool cullSame;
+	// Light given off, 0 to 15
+	int light;
+	// Atlas tile of each face, by Orientation
+	int tiles[6];
+};
+
+// The compiled tables of a BlockRegistry as plain pointers, for hot loops to keep in
+// registers.
+struct BlockTables {
+	const uint64_t *opaque, *cullSame;
+	const uint8_t *light, *tiles;
+
+	// Does a block of type neighbour hide the face of block that touches it?
+	bool hides(BlockId block, BlockId neighbour) const {
+		return ((opaque[neighbour >> 6] | (cullSame[block >> 6] & -(uint64_t)(block == neighbour))) >> (neighbour & 63)) & 1;
+	}
+
+	bool isOpaque(BlockId id) const {
+		return (opaque[id >> 6] >> (id & 63)) & 1;
+	}
+
+	int getLight(BlockId id) const {
+		return light[id];
+	}
+
+	int getTile(BlockId id, int face) const {
+		return tiles[id * 6 + face];
+	}
+};
+
+// The block types, read from a text file at startup, and the tables compiled from them
+// that the mesher looks properties up in. A line of the file is
+//
+//     id name opaque|clear same|all light tile [tile tile tile tile tile]
+//
+// with one tile for all faces or one each for the front, back, top, bottom, left and
+// right face; # starts a comment. Until a file is loaded the blocks of textures.png are
+// registered. ID 0 is always air.
+class BlockRegistry {
+public:
+	BlockRegistry();
+
+	bool load(const char *path);
+	bool add(BlockId id, const BlockInfo &info);
+	void compile();
+	const BlockInfo *getInfo(BlockId id) const;
+	BlockId find(const char *name) const;
+	int getCount() const;
+
+	BlockTables getTables() const;
+	uint64_t getHash() const;
+
+	static BlockRegistry &get();
+
+private:
+	bool parse(const char *line, const char *source, int number);
+
+	std::vector<BlockInfo> _blocks;
+	std::vector<bool> _registered;
+	// Compiled tables covering every ID up to the highest registered one, at least 256:
+	// a bit per ID for opacity and same-type culling, a byte per ID for light and six per
+	// ID for tiles. Unregistered IDs are opaque with tile id % 128.
+	std::vector<uint64_t> _opaque, _cullSame;
+	std::vector<uint8_t> _light;
+	std::vector<uint8_t> _tiles;
+	// Hash of the tables meshing reads, which changes whenever the meshes would
+	uint64_t _hash;
+	int _count;
+};
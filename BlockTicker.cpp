@@ -0,0 +1,320 @@
+#include "BlockTicker.h"
+#include "World.h"
+
+static inline int cell(int x, int y, int z) {
+	return (x * CHUNK::Y + y) * CHUNK::Z + z;
+}
+
+// Moves (x, y, z) into the neighbouring chunk when it lies just outside c.
+// Returns 0 if there is no generated chunk there, which the rules treat as solid.
+static inline Chunk *resolve(Chunk *c, int &x, int &y, int &z) {
+	if (x < 0) {
+		c = c->getNeighbour(LEFT);
+		x += CHUNK::X;
+	}
+	else if (x >= CHUNK::X) {
+		c = c->getNeighbour(RIGHT);
+		x -= CHUNK::X;
+	}
+	else if (y < 0) {
+		c = c->getNeighbour(BELOW);
+		y += CHUNK::Y;
+	}
+	else if (y >= CHUNK::Y) {
+		c = c->getNeighbour(ABOVE);
+		y -= CHUNK::Y;
+	}
+	else if (z < 0) {
+		c = c->getNeighbour(FRONT);
+		z += CHUNK::Z;
+	}
+	else if (z >= CHUNK::Z) {
+		c = c->getNeighbour(BACK);
+		z -= CHUNK::Z;
+	}
+
+	return c && c->isNoised() ? c : 0;
+}
+
+static const int DX[6] = { 0, 0, 0, 0, -1, 1 };
+static const int DY[6] = { 0, 0, 1, -1, 0, 0 };
+static const int DZ[6] = { -1, 1, 0, 0, 0, 0 };
+
+BlockTicker::BlockTicker(World *world, ThreadPool *pool) : _world(world), _pool(pool) {
+	_tick = 0;
+	_accumulator = 0;
+	_activeCells = 0;
+	_activeChunks = 0;
+}
+
+BlockTicker::~BlockTicker() {
+	for (std::unordered_map<Chunk *, ChunkTicks *>::iterator i = _chunks.begin(); i != _chunks.end(); ++i)
+		delete i->second;
+}
+
+// Wakes the block at world coordinates (x, y, z) and its neighbours on the next tick,
+// e.g. after the player edited it.
+void BlockTicker::activate(int x, int y, int z) {
+	Chunk *chunk = _world->findChunk(x, y, z);
+	if (!chunk)
+		return;
+
+	x &= CHUNK::X - 1;
+	y &= CHUNK::Y - 1;
+	z &= CHUNK::Z - 1;
+
+	schedule(chunk, x, y, z, 1);
+	for (int i = 0; i < 6; ++i)
+		schedule(chunk, x + DX[i], y + DY[i], z + DZ[i], 1);
+}
+
+// Schedules the block at chunk-local (x, y, z) to be ticked delay ticks from now.
+void BlockTicker::schedule(Chunk *chunk, int x, int y, int z, int delay) {
+	chunk = resolve(chunk, x, y, z);
+	if (!chunk)
+		return;
+
+	Scheduled s = { _tick + delay, chunk, (uint16_t)cell(x, y, z) };
+	_scheduled.push(s);
+}
+
+// Runs as many fixed-rate ticks as dt covers.
+int BlockTicker::update(float dt) {
+	static const float step = 1.0f / TICK::RATE;
+	int steps = 0;
+
+	_accumulator += dt;
+	while (_accumulator >= step && steps < TICK::MAX_STEPS) {
+		tick();
+		_accumulator -= step;
+		++steps;
+	}
+
+	// If we can't keep up, drop the backlog rather than falling further behind
+	if (_accumulator >= step)
+		_accumulator = 0;
+
+	return steps;
+}
+
+void BlockTicker::tick() {
+	++_tick;
+
+	// Move due cells into the active set of their chunk
+	for (int i = 0; i < 8; ++i)
+		_phase[i].clear();
+	_activeCells = 0;
+	_activeChunks = 0;
+
+	while (!_scheduled.empty() && _scheduled.top().tick <= _tick) {
+		Scheduled s = _scheduled.top();
+		_scheduled.pop();
+
+		ChunkTicks *ticks = state(s.chunk);
+		if (ticks->queued[s.index])
+			continue;
+
+		int x = s.index / (CHUNK::Y * CHUNK::Z);
+		int y = s.index / CHUNK::Z % CHUNK::Y;
+		int z = s.index % CHUNK::Z;
+		uint8_t type = s.chunk->getBlock(x, y, z);
+		if (type != BLOCK::WATER && type != BLOCK::SAND)
+			continue;
+
+		if (ticks->active.empty()) {
+			// Chunks with the same coordinate parities never touch, so each phase can
+			// tick all of its chunks in parallel without two of them writing the same block.
+			int phase = (s.chunk->getX() & 1) | (s.chunk->getY() & 1) << 1 | (s.chunk->getZ() & 1) << 2;
+			_phase[phase].push_back(s.chunk);
+			++_activeChunks;
+
+			// Water can flow into any face neighbour, which needs its level array.
+			// Workers write blocks directly, so compacted chunks are expanded up front, and
+			// blocks shared with snapshots or a running compaction are copied here: two
+			// chunks of a phase can write into the same neighbour, and copying it from both
+			// workers would race.
+			s.chunk->expand();
+			s.chunk->own();
+			for (int i = 0; i < 6; ++i) {
+				Chunk *neighbour = s.chunk->getNeighbour((Orientation)i);
+				if (neighbour && neighbour->isNoised()) {
+					neighbour->expand();
+					neighbour->own();
+					state(neighbour);
+				}
+			}
+		}
+
+		ticks->queued[s.index] = true;
+		ticks->active.push_back(s.index);
+		++_activeCells;
+	}
+
+	for (int p = 0; p < 8; ++p) {
+		std::vector<Chunk *> &chunks = _phase[p];
+		if (chunks.empty())
+			continue;
+
+		std::vector<ChunkTicks *> ticks(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i)
+			ticks[i] = find(chunks[i]);
+
+		_pool->parallelFor((int)chunks.size(), [&](int i) {
+			tickChunk(chunks[i], ticks[i]);
+		});
+
+		// Merge what the phase produced; remeshing is only flagged here, once per tick
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			ChunkTicks *t = ticks[i];
+
+			for (size_t j = 0; j < t->outbox.size(); ++j)
+				_scheduled.push(t->outbox[j]);
+
+			for (size_t j = 0; j < t->changes.size(); ++j) {
+				const Change &c = t->changes[j];
+				int x = c.index / (CHUNK::Y * CHUNK::Z);
+				int y = c.index / CHUNK::Z % CHUNK::Y;
+				int z = c.index % CHUNK::Z;
+
+				_world->updateHeight(c.chunk->getX() * CHUNK::X + x, c.chunk->getY() * CHUNK::Y + y, c.chunk->getZ() * CHUNK::Z + z, c.chunk->getBlock(x, y, z));
+
+				c.chunk->markChanged();
+				if (x == 0 && c.chunk->getNeighbour(LEFT))
+					c.chunk->getNeighbour(LEFT)->markChanged();
+				if (x == CHUNK::X - 1 && c.chunk->getNeighbour(RIGHT))
+					c.chunk->getNeighbour(RIGHT)->markChanged();
+				if (y == 0 && c.chunk->getNeighbour(BELOW))
+					c.chunk->getNeighbour(BELOW)->markChanged();
+				if (y == CHUNK::Y - 1 && c.chunk->getNeighbour(ABOVE))
+					c.chunk->getNeighbour(ABOVE)->markChanged();
+				if (z == 0 && c.chunk->getNeighbour(FRONT))
+					c.chunk->getNeighbour(FRONT)->markChanged();
+				if (z == CHUNK::Z - 1 && c.chunk->getNeighbour(BACK))
+					c.chunk->getNeighbour(BACK)->markChanged();
+			}
+
+			for (size_t j = 0; j < t->active.size(); ++j)
+				t->queued[t->active[j]] = false;
+			t->active.clear();
+			t->outbox.clear();
+			t->changes.clear();
+		}
+	}
+}
+
+uint64_t BlockTicker::getTick() const {
+	return _tick;
+}
+
+// Number of cells evaluated by the last tick.
+int BlockTicker::getActiveCells() const {
+	return _activeCells;
+}
+
+// Number of chunks that had active cells in the last tick.
+int BlockTicker::getActiveChunks() const {
+	return _activeChunks;
+}
+
+int BlockTicker::getScheduled() const {
+	return (int)_scheduled.size();
+}
+
+BlockTicker::ChunkTicks *BlockTicker::state(Chunk *chunk) {
+	ChunkTicks *&ticks = _chunks[chunk];
+	if (!ticks) {
+		ticks = new ChunkTicks;
+		// Everything generated counts as a source
+		memset(ticks->level, 0, sizeof(ticks->level));
+	}
+	return ticks;
+}
+
+BlockTicker::ChunkTicks *BlockTicker::find(Chunk *chunk) const {
+	std::unordered_map<Chunk *, ChunkTicks *>::const_iterator i = _chunks.find(chunk);
+	return i == _chunks.end() ? 0 : i->second;
+}
+
+// Applies the block rules to every active cell of one chunk. Runs on a worker thread;
+// it may write blocks one step into neighbouring chunks, but only queues everything else.
+void BlockTicker::tickChunk(Chunk *chunk, ChunkTicks *ticks) {
+	for (size_t i = 0; i < ticks->active.size(); ++i) {
+		int index = ticks->active[i];
+		int x = index / (CHUNK::Y * CHUNK::Z);
+		int y = index / CHUNK::Z % CHUNK::Y;
+		int z = index % CHUNK::Z;
+		uint8_t type = chunk->getBlock(x, y, z);
+
+		int bx = x, by = y - 1, bz = z;
+		Chunk *below = resolve(chunk, bx, by, bz);
+		uint8_t under = below ? below->getBlock(bx, by, bz) : 0;
+
+		if (type == BLOCK::SAND) {
+			// Sand falls through air and sinks through water
+			if (!below || (under != BLOCK::AIR && under != BLOCK::WATER))
+				continue;
+
+			if (under == BLOCK::WATER)
+				ticks->level[index] = find(below)->level[cell(bx, by, bz)];
+			write(ticks, below, bx, by, bz, BLOCK::SAND, TICK::SAND_DELAY);
+			write(ticks, chunk, x, y, z, under, TICK::SAND_DELAY);
+		}
+		else if (type == BLOCK::WATER) {
+			int level = ticks->level[index];
+
+			// Water falls first, and only spreads sideways once it rests on something
+			if (below && under == BLOCK::AIR) {
+				find(below)->level[cell(bx, by, bz)] = 1;
+				write(ticks, below, bx, by, bz, BLOCK::WATER, TICK::WATER_DELAY);
+				continue;
+			}
+
+			if (!below || under == BLOCK::WATER || level >= TICK::WATER_SPREAD)
+				continue;
+
+			for (int d = 0; d < 6; ++d) {
+				if (DY[d])
+					continue;
+
+				int nx = x + DX[d], ny = y, nz = z + DZ[d];
+				Chunk *next = resolve(chunk, nx, ny, nz);
+				if (!next)
+					continue;
+
+				uint8_t &nextLevel = find(next)->level[cell(nx, ny, nz)];
+				uint8_t nextType = next->getBlock(nx, ny, nz);
+
+				if (nextType == BLOCK::AIR) {
+					nextLevel = level + 1;
+					write(ticks, next, nx, ny, nz, BLOCK::WATER, TICK::WATER_DELAY);
+				}
+				else if (nextType == BLOCK::WATER && nextLevel > level + 1) {
+					// Shallower water reached by a shorter path spreads further
+					nextLevel = level + 1;
+					schedule(ticks, next, nx, ny, nz, TICK::WATER_DELAY);
+				}
+			}
+		}
+	}
+}
+
+// Changes a block from a worker and queues it and its neighbours for a later tick.
+void BlockTicker::write(ChunkTicks *ticks, Chunk *chunk, int x, int y, int z, uint8_t type, int delay) {
+	chunk->setLocalBlock(x, y, z, type);
+
+	Change c = { chunk, (uint16_t)cell(x, y, z) };
+	ticks->changes.push_back(c);
+
+	schedule(ticks, chunk, x, y, z, delay);
+	for (int i = 0; i < 6; ++i)
+		schedule(ticks, chunk, x + DX[i], y + DY[i], z + DZ[i], delay);
+}
+
+void BlockTicker::schedule(ChunkTicks *ticks, Chunk *chunk, int x, int y, int z, int delay) {
+	chunk = resolve(chunk, x, y, z);
+	if (!chunk)
+		return;
+
+	Scheduled s = { _tick + delay, chunk, (uint16_t)cell(x, y, z) };
+	ticks->outbox.push_back(s);
+}
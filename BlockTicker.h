@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <bitset>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "Constants.h"
+#include "Chunk.h"
+#include "ThreadPool.h"
+
+class World;
+
+// Runs block updates (flowing water, falling sand) at a fixed tick rate.
+// Cells are scheduled into a priority queue keyed by tick; when they come due they
+// join their chunk's active set, and only chunks with active cells are ticked.
+class BlockTicker {
+public:
+	BlockTicker(World *world, ThreadPool *pool);
+	~BlockTicker();
+
+	void activate(int x, int y, int z);
+	void schedule(Chunk *chunk, int x, int y, int z, int delay);
+	int update(float dt);
+	void tick();
+	uint64_t getTick() const;
+	int getActiveCells() const;
+	int getActiveChunks() const;
+	int getScheduled() const;
+
+private:
+	static const int CELLS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+
+	struct Scheduled {
+		uint64_t tick;
+		Chunk *chunk;
+		uint16_t index;
+
+		bool operator>(const Scheduled &other) const { return tick > other.tick; }
+	};
+
+	struct Change {
+		Chunk *chunk;
+		uint16_t index;
+	};
+
+	// Simulation state for every chunk the ticker has touched
+	struct ChunkTicks {
+		std::vector<uint16_t> active;
+		std::bitset<CELLS> queued;
+		// Distance of flowing water from its source, 0 for sources
+		uint8_t level[CELLS];
+		// Filled while ticking this chunk, merged once the phase is over
+		std::vector<Scheduled> outbox;
+		std::vector<Change> changes;
+	};
+
+	ChunkTicks *state(Chunk *chunk);
+	ChunkTicks *find(Chunk *chunk) const;
+	void tickChunk(Chunk *chunk, ChunkTicks *ticks);
+	void write(ChunkTicks *ticks, Chunk *chunk, int x, int y, int z, uint8_t type, int delay);
+	void schedule(ChunkTicks *ticks, Chunk *chunk, int x, int y, int z, int delay);
+
+	World *_world;
+	ThreadPool *_pool;
+	std::unordered_map<Chunk *, ChunkTicks *> _chunks;
+	std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled> > _scheduled;
+	std::vector<Chunk *> _phase[8];
+	uint64_t _tick;
+	float _accumulator;
+	int _activeCells, _activeChunks;
+};
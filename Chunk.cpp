@@ -1,39 +1,93 @@
+#include <algorithm>
+
 #include "Chunk.h"
+#include "MeshCache.h"
 
 using namespace glm;
-typedef tvec4<GLbyte, mediump> byte4;
+
+static ChunkBlocks *new_blocks() {
+	ChunkBlocks *data = new ChunkBlocks;
+	data->refs.store(1, std::memory_order_relaxed);
+	return data;
+}
+
+// Drops a reference to shared blocks, freeing them with the last one.
+static void release_blocks(const ChunkBlocks *data) {
+	if (data->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete data;
+}
+
+// Everything outside a chunk sees its blocks as [X][Y][Z]; these convert to and from the
+// order they are stored in.
+static void store_blocks(const uint8_t *block, uint8_t *stored) {
+	if (!CHUNK::MORTON) {
+		memcpy(stored, block, CHUNK::X * CHUNK::Y * CHUNK::Z);
+		return;
+	}
+	for (int x = 0; x < CHUNK::X; ++x)
+		for (int y = 0; y < CHUNK::Y; ++y)
+			for (int z = 0; z < CHUNK::Z; ++z)
+				stored[ChunkLayout::index(x, y, z)] = block[(x * CHUNK::Y + y) * CHUNK::Z + z];
+}
+
+static void load_blocks(const uint8_t *stored, uint8_t *block) {
+	if (!CHUNK::MORTON) {
+		memcpy(block, stored, CHUNK::X * CHUNK::Y * CHUNK::Z);
+		return;
+	}
+	for (int x = 0; x < CHUNK::X; ++x)
+		for (int y = 0; y < CHUNK::Y; ++y)
+			for (int z = 0; z < CHUNK::Z; ++z)
+				block[(x * CHUNK::Y + y) * CHUNK::Z + z] = stored[ChunkLayout::index(x, y, z)];
+}
 
 Chunk::Chunk(int x, int y, int z) : _x(x), _y(y), _z(z) {
-	memset(_block, 0, sizeof(_block));
+	// Nothing is stored until the chunk is generated or edited
+	_data = 0;
+	_block = 0;
+	_dag = 0;
+	_root = 0;
+	_seed = 0;
+	_edited = false;
 	_front = _back = _above = _below = _left = _right = 0;
 	_slot = 0;
-	_changed = true;
-	_initialized = false;
-	_noised = false;
-	glGenBuffers(1, &_vbo);
+	_blocks = 0;
+	memset(_faces, 0, sizeof(_faces));
+	_meshBytes = 0;
+	_stage = STAGE_EMPTY;
+	// Neighbours are counted in as they are set
+	_waiting = 1;
+	_version = 0;
+	// The buffer is created on first upload, so chunks can live without a GL context.
+	_vbo = 0;
+	_texture = 0;
 }
 
 
 Chunk::~Chunk() {
-	glDeleteBuffers(1, &_vbo);
+	if (_texture)
+		glDeleteTextures(1, &_texture);
+	if (_vbo)
+		glDeleteBuffers(1, &_vbo);
+	freeBlocks();
 }
 
 
 
 uint8_t Chunk::getBlock(int x, int y, int z) const {
 	if (x < 0)
-		return _left ? _left->_block[x + CHUNK::X][y][z] : 0;
+		return _left ? _left->blockAt(x + CHUNK::X, y, z) : 0;
 	if (x >= CHUNK::X)
-		return _right ? _right->_block[x - CHUNK::X][y][z] : 0;
+		return _right ? _right->blockAt(x - CHUNK::X, y, z) : 0;
 	if (y < 0)
-		return _below ? _below->_block[x][y + CHUNK::Y][z] : 0;
+		return _below ? _below->blockAt(x, y + CHUNK::Y, z) : 0;
 	if (y >= CHUNK::Y)
-		return _above ? _above->_block[x][y - CHUNK::Y][z] : 0;
+		return _above ? _above->blockAt(x, y - CHUNK::Y, z) : 0;
 	if (z < 0)
-		return _front ? _front->_block[x][y][z + CHUNK::Z] : 0;
+		return _front ? _front->blockAt(x, y, z + CHUNK::Z) : 0;
 	if (z >= CHUNK::Z)
-		return _back ? _back->_block[x][y][z - CHUNK::Z] : 0;
-	return _block[x][y][z];
+		return _back ? _back->blockAt(x, y, z - CHUNK::Z) : 0;
+	return blockAt(x, y, z);
 }
 
 void Chunk::setBlock(int x, int y, int z, uint8_t type) {
@@ -70,23 +124,35 @@ void Chunk::setBlock(int x, int y, int z, uint8_t type) {
 	}
 
 	// Change the block
-	_block[x][y][z] = type;
-	_changed = true;
+	expand();
+	own();
+	_block[ChunkLayout::index(x, y, z)] = type;
+	markChanged();
+	_edited = true;
 
 	// When updating blocks at the edge of this chunk,
 	// visibility of blocks in the neighbouring chunk might change.
 	if (x == 0 && _left)
-		_left->_changed = true;
+		_left->markChanged();
 	if (x == CHUNK::X - 1 && _right)
-		_right->_changed = true;
+		_right->markChanged();
 	if (y == 0 && _below)
-		_below->_changed = true;
+		_below->markChanged();
 	if (y == CHUNK::Y - 1 && _above)
-		_above->_changed = true;
+		_above->markChanged();
 	if (z == 0 && _front)
-		_front->_changed = true;
+		_front->markChanged();
 	if (z == CHUNK::Z - 1 && _back)
-		_back->_changed = true;
+		_back->markChanged();
+}
+
+// Writes a block inside this chunk without flagging it or its neighbours for remeshing.
+// Callers that change many blocks at once batch that through markChanged().
+void Chunk::setLocalBlock(int x, int y, int z, uint8_t type) {
+	expand();
+	own();
+	_block[ChunkLayout::index(x, y, z)] = type;
+	_edited = true;
 }
 
 float Chunk::noise2d(int octaves, float x, float y, int seed) {
@@ -114,154 +180,456 @@ float Chunk::noise3d(int octaves, float x, float y, float z, int seed) {
 }
 
 void Chunk::noise(int seed) {
-	if (_noised)
+	if (_stage != STAGE_EMPTY)
 		return;
-	else
-		_noised = true;
+
+	expand();
+	own();
+	generated();
+	_seed = seed;
 
 	for (int x = 0; x < CHUNK::X; ++x) {
 		for (int z = 0; z < CHUNK::Z; ++z) {
-			// Land height
-			float n = noise2d(6, (x + _x * CHUNK::X) / 256.0, (z + _z * CHUNK::Z) / 256.0, seed) * WORLD::SEALEVEL;
-			int h = n * 2;
-			int y = 0;
-
-			// Land blocks
-			for (y = 0; y < CHUNK::Y; ++y) {
-				// Are we above "ground" level?
-				if (y + _y * CHUNK::Y >= h) {
-					// If we are not yet up to sea level, fill with water blocks
-					if (y + _y * CHUNK::Y < WORLD::SEALEVEL) {
-						_block[x][y][z] = 8;
-						continue;
-					}
-					else {
-						break;
-					}
-				}
-
-				float r = noise3d(3, (x + _x * CHUNK::X) / 16.0, (y + _y * CHUNK::Y) / 16.0, (z + _z * CHUNK::Z) / 16.0, seed);
-
-				if (n + r * 5 < 2 * WORLD::SEALEVEL)
-					_block[x][y][z] = (h < WORLD::SEALEVEL || y + _y * CHUNK::Y < h - 1) ? 1 : 3;
-				else
-					_block[x][y][z] = 6;
+			float n = land(x, z);
+			for (int y = 0; y < CHUNK::Y; ++y) {
+				uint8_t type = terrain(x, y, z, n);
+				// Blocks edited before generation stay where generation leaves air
+				if (type)
+					_block[ChunkLayout::index(x, y, z)] = type;
 			}
 		}
 	}
-	_changed = true;
+	markChanged();
+}
+
+// Land height noise of the column at chunk-local (x, z).
+float Chunk::land(int x, int z) const {
+	return noise2d(6, (x + _x * CHUNK::X) / 256.0, (z + _z * CHUNK::Z) / 256.0, _seed) * WORLD::SEALEVEL;
+}
+
+// The block generation puts at chunk-local (x, y, z), in a column with land height n.
+uint8_t Chunk::terrain(int x, int y, int z, float n) const {
+	int h = n * 2;
+
+	// Are we above "ground" level? If we are not yet up to sea level, fill with water blocks
+	if (y + _y * CHUNK::Y >= h)
+		return y + _y * CHUNK::Y < WORLD::SEALEVEL ? 8 : 0;
+
+	float r = noise3d(3, (x + _x * CHUNK::X) / 16.0, (y + _y * CHUNK::Y) / 16.0, (z + _z * CHUNK::Z) / 16.0, _seed);
+
+	if (n + r * 5 < 2 * WORLD::SEALEVEL)
+		return (h < WORLD::SEALEVEL || y + _y * CHUNK::Y < h - 1) ? 1 : 3;
+	else
+		return 6;
+}
+
+// Writes what generation gives for this chunk into block ([X][Y][Z] blocks).
+void Chunk::generate(uint8_t *block) const {
+	for (int x = 0; x < CHUNK::X; ++x) {
+		for (int z = 0; z < CHUNK::Z; ++z) {
+			float n = land(x, z);
+			for (int y = 0; y < CHUNK::Y; ++y)
+				block[(x * CHUNK::Y + y) * CHUNK::Z + z] = terrain(x, y, z, n);
+		}
+	}
+}
+
+// What generation gives for the chunk at (x, y, z) with seed, without the chunk itself, so
+// threads that outlive the world can use it.
+void Chunk::generate(int x, int y, int z, int seed, uint8_t *block) {
+	Chunk chunk(x, y, z);
+	chunk._seed = seed;
+	chunk.generate(block);
+}
+
+// Copies the blocks of this chunk into block ([X][Y][Z] blocks), however they are stored.
+void Chunk::getBlocks(uint8_t *block) const {
+	if (_block) {
+		load_blocks(_block, block);
+		return;
+	}
+	if (!_runs.empty()) {
+		uint8_t stored[CHUNK::X * CHUNK::Y * CHUNK::Z];
+		int i = 0;
+		for (size_t r = 0; r < _runs.size(); ++r)
+			for (; i <= _runs[r].last; ++i)
+				stored[i] = _runs[r].type;
+		load_blocks(stored, block);
+		return;
+	}
+	if (_dag) {
+		_dag->expand(_root, block);
+		return;
+	}
+
+	if (_stage != STAGE_EMPTY)
+		generate(block);
+	else
+		memset(block, 0, CHUNK::X * CHUNK::Y * CHUNK::Z);
+
+	for (size_t i = 0; i < _diff.size(); ++i)
+		block[_diff[i].index] = _diff[i].type;
+}
+
+// Replaces all blocks of this chunk with block ([X][Y][Z] blocks), e.g. the chunk as a
+// server sent it. seed is the one the blocks were generated from, so the chunk can still
+// be held as generation plus diff later.
+void Chunk::setBlocks(const uint8_t *block, int seed) {
+	expand();
+	own();
+	store_blocks(block, _block);
+	if (_stage == STAGE_EMPTY)
+		generated();
+	_seed = seed;
+	_edited = true;
+
+	markChanged();
+	if (_left)
+		_left->markChanged();
+	if (_right)
+		_right->markChanged();
+	if (_below)
+		_below->markChanged();
+	if (_above)
+		_above->markChanged();
+	if (_front)
+		_front->markChanged();
+	if (_back)
+		_back->markChanged();
+}
+
+// Finds the blocks that differ from what generation gives, in index order.
+// Returns their number.
+int Chunk::diff(std::vector<BlockDiff> &diff) const {
+	diff.clear();
+	if (isProcedural()) {
+		diff = _diff;
+		return (int)diff.size();
+	}
+	if (!_edited)
+		return 0;
+
+	uint8_t current[CHUNK::X * CHUNK::Y * CHUNK::Z];
+	uint8_t generated[CHUNK::X * CHUNK::Y * CHUNK::Z];
+	getBlocks(current);
+	if (_stage != STAGE_EMPTY)
+		generate(generated);
+	else
+		memset(generated, 0, sizeof(generated));
+
+	for (int i = 0; i < CHUNK::X * CHUNK::Y * CHUNK::Z; ++i) {
+		if (current[i] != generated[i]) {
+			BlockDiff d = { (uint16_t)i, current[i] };
+			diff.push_back(d);
+		}
+	}
+	return (int)diff.size();
+}
+
+// Block at index in ChunkLayout order of a run-length encoded chunk.
+uint8_t Chunk::runBlock(int index) const {
+	BlockRun key = { (uint16_t)index, 0 };
+	return std::lower_bound(_runs.begin(), _runs.end(), key,
+		[](const BlockRun &a, const BlockRun &b) { return a.last < b.last; })->type;
+}
+
+// Block at chunk-local (x, y, z) of a chunk held as generation plus diff.
+uint8_t Chunk::proceduralBlock(int x, int y, int z) const {
+	if (!_diff.empty()) {
+		BlockDiff key = { (uint16_t)((x * CHUNK::Y + y) * CHUNK::Z + z), 0 };
+		std::vector<BlockDiff>::const_iterator i = std::lower_bound(_diff.begin(), _diff.end(), key,
+			[](const BlockDiff &a, const BlockDiff &b) { return a.index < b.index; });
+		if (i != _diff.end() && i->index == key.index)
+			return i->type;
+	}
+
+	return _stage != STAGE_EMPTY ? terrain(x, y, z, land(x, z)) : 0;
 }
 
 void Chunk::update() {
-	byte4 vertex[CHUNK::X * CHUNK::Y * CHUNK::Z * 18];
-	int i = 0;
+	// Too big for the stack
+	std::vector<byte4> vertex(CHUNK::VERTICES);
+	upload(&vertex[0], mesh(&vertex[0]));
+}
+
+// Builds the vertices of all visible faces into vertex, which must hold CHUNK::VERTICES.
+// Needs no GL context; returns the number of vertices written. The chunk only counts as
+// meshed if it could enter STAGE_MESHED; otherwise the mesh is a preview against the
+// neighbours there are. With a cache, a mesh built from the same blocks before is read
+// from it instead, and a new one is added to it.
+int Chunk::mesh(byte4 *vertex, MeshCache *cache) {
+	ChunkSnapshot snapshot;
+	takeSnapshot(&snapshot);
+	if (canEnter(STAGE_MESHED))
+		_stage = STAGE_MESHED;
+
+	uint64_t key = cache ? MeshCache::key(snapshot) : 0;
+	if (cache && cache->load(key, vertex, _faces)) {
+		_blocks = 0;
+		for (int o = FRONT; o <= RIGHT; ++o)
+			_blocks += _faces[o];
+	}
+	else {
+		_blocks = snapshot.mesh(vertex, _faces);
+		if (cache)
+			cache->store(key, vertex, _faces);
+	}
+	_meshBytes = _blocks * sizeof(byte4);
+	return _blocks;
+}
+
+// Takes a snapshot of the blocks meshing this chunk needs, to mesh it on another thread.
+// Has to be called on the thread that edits the world; the snapshot stays as it was
+// however the chunk is edited after.
+void Chunk::takeSnapshot(ChunkSnapshot *snapshot) {
+	expand();
+
+	if (snapshot->_blocks)
+		release_blocks(snapshot->_blocks);
+	_data->refs.fetch_add(1, std::memory_order_relaxed);
+	snapshot->_blocks = _data;
+	snapshot->_chunk = this;
+	snapshot->_version = _version;
+
+	// Missing neighbours are air, so the faces at the edges of the world are kept
+	for (int y = 0; y < CHUNK::Y; ++y) {
+		for (int z = 0; z < CHUNK::Z; ++z) {
+			snapshot->_sideX[0][y][z] = _left ? _left->blockAt(CHUNK::X - 1, y, z) : 0;
+			snapshot->_sideX[1][y][z] = _right ? _right->blockAt(0, y, z) : 0;
+		}
+	}
+	for (int x = 0; x < CHUNK::X; ++x) {
+		for (int z = 0; z < CHUNK::Z; ++z) {
+			snapshot->_sideY[0][x][z] = _below ? _below->blockAt(x, CHUNK::Y - 1, z) : 0;
+			snapshot->_sideY[1][x][z] = _above ? _above->blockAt(x, 0, z) : 0;
+		}
+	}
 	for (int x = 0; x < CHUNK::X; ++x) {
 		for (int y = 0; y < CHUNK::Y; ++y) {
-			for (int z = 0; z < CHUNK::Z; ++z) {
-				uint8_t type = _block[x][y][z];
-				if (type != 0) {
-
-					bool add = !(z == 0 && _z == -WORLD::Z / 2);
-					//Check X min boundaries, add front faces
-					if (!add || (add && !getBlock(x, y, z - 1))) {
-						vertex[i++] = byte4(x, y, z, type);
-						vertex[i++] = byte4(x + 1, y, z, type);
-						vertex[i++] = byte4(x + 1, y + 1, z, type);
-						vertex[i++] = byte4(x + 1, y + 1, z, type);
-						vertex[i++] = byte4(x, y + 1, z, type);
-						vertex[i++] = byte4(x, y, z, type);
-					}
-
-					add = !(z == CHUNK::Z - 1 && _z == WORLD::Z / 2 - 1);
-
-					//Check X max boundaries, add back faces
-					if (!add || (add && !getBlock(x, y, z + 1))) {
-						vertex[i++] = byte4(x, y, z + 1, type);
-						vertex[i++] = byte4(x + 1, y, z + 1, type);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type);
-						vertex[i++] = byte4(x, y + 1, z + 1, type);
-						vertex[i++] = byte4(x, y, z + 1, type);
-					}
-
-					add = !(x == 0 && _x == -WORLD::X / 2);
-
-					//Check Z min boundaries, add left faces
-					if (!add || (add && !getBlock(x - 1, y, z))) {
-						vertex[i++] = byte4(x, y, z, type);
-						vertex[i++] = byte4(x, y, z + 1, type);
-						vertex[i++] = byte4(x, y + 1, z + 1, type);
-						vertex[i++] = byte4(x, y + 1, z + 1, type);
-						vertex[i++] = byte4(x, y + 1, z, type);
-						vertex[i++] = byte4(x, y, z, type);
-					}
-
-					add = !(x == CHUNK::X - 1 && _x == WORLD::X / 2 - 1);
-
-					//Check Z max boundaries, add right faces
-					if (!add || (add && !getBlock(x + 1, y, z))) {
-						vertex[i++] = byte4(x + 1, y, z, type);
-						vertex[i++] = byte4(x + 1, y, z + 1, type);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type);
-						vertex[i++] = byte4(x + 1, y + 1, z, type);
-						vertex[i++] = byte4(x + 1, y, z, type);
-					}
-
-					add = !(y == 0 && _y == -WORLD::Y / 2);
-
-					//Check Y min boundaries, add bottom faces
-					if (!add || (add && !getBlock(x, y - 1, z))) {
-						vertex[i++] = byte4(x, y, z, type + 128);
-						vertex[i++] = byte4(x + 1, y, z, type + 128);
-						vertex[i++] = byte4(x + 1, y, z + 1, type + 128);
-						vertex[i++] = byte4(x + 1, y, z + 1, type + 128);
-						vertex[i++] = byte4(x, y, z + 1, type + 128);
-						vertex[i++] = byte4(x, y, z, type + 128);
-					}
-
-					add = !(y == CHUNK::Y - 1 && _y == WORLD::Y / 2 - 1);
-
-					//Check Y max boundaries, add top faces
-					if (!add || (add && !getBlock(x, y + 1, z))) {
-						vertex[i++] = byte4(x, y + 1, z, type + 128);
-						vertex[i++] = byte4(x + 1, y + 1, z, type + 128);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type + 128);
-						vertex[i++] = byte4(x + 1, y + 1, z + 1, type + 128);
-						vertex[i++] = byte4(x, y + 1, z + 1, type + 128);
-						vertex[i++] = byte4(x, y + 1, z, type + 128);
-					}
-				}
-			}
+			snapshot->_sideZ[0][x][y] = _front ? _front->blockAt(x, y, CHUNK::Z - 1) : 0;
+			snapshot->_sideZ[1][x][y] = _back ? _back->blockAt(x, y, 0) : 0;
 		}
 	}
+}
+
+// The dense blocks of this chunk, shared rather than copied until the chunk is next
+// written, for reading on another thread; 0 if the chunk isn't stored dense. Unlike
+// takeSnapshot it never expands the chunk. Hand them back with releaseBlocks.
+const ChunkBlocks *Chunk::shareBlocks() const {
+	if (!_block)
+		return 0;
+
+	_data->refs.fetch_add(1, std::memory_order_relaxed);
+	return _data;
+}
+
+// Drops blocks taken with shareBlocks; safe on any thread.
+void Chunk::releaseBlocks(const ChunkBlocks *blocks) {
+	release_blocks(blocks);
+}
+
+// Takes the mesh built from snapshot on another thread, with faces vertices facing each
+// way. Returns false if the chunk or a neighbour changed since the snapshot was taken, or
+// a neighbour wasn't generated yet: the mesh is stale then and the chunk stays flagged
+// for meshing.
+bool Chunk::meshed(const ChunkSnapshot &snapshot, const int *faces) {
+	if (snapshot._chunk != this || snapshot._version != _version || !canEnter(STAGE_MESHED))
+		return false;
+
+	_stage = STAGE_MESHED;
+	_blocks = 0;
+	for (int o = FRONT; o <= RIGHT; ++o) {
+		_faces[o] = faces[o];
+		_blocks += faces[o];
+	}
+	_meshBytes = _blocks * sizeof(byte4);
+	return true;
+}
+
+// Makes the dense blocks private to this chunk before they are written, copying them if
+// a snapshot still shares them.
+void Chunk::own() {
+	if (_data->refs.load(std::memory_order_acquire) == 1)
+		return;
+
+	ChunkBlocks *data = new_blocks();
+	memcpy(data->block, _data->block, sizeof(data->block));
+	release_blocks(_data);
+	_data = data;
+	_block = data->block;
+}
+
+ChunkSnapshot::ChunkSnapshot() : _chunk(0), _blocks(0), _version(0) {
+}
+
+ChunkSnapshot::~ChunkSnapshot() {
+	if (_blocks)
+		release_blocks(_blocks);
+}
+
+Chunk *ChunkSnapshot::getChunk() const {
+	return _chunk;
+}
+
+uint32_t ChunkSnapshot::getVersion() const {
+	return _version;
+}
+
+// Block at chunk-local (x, y, z), where one coordinate may be one step outside the chunk.
+uint8_t ChunkSnapshot::getBlock(int x, int y, int z) const {
+	if (x < 0)
+		return _sideX[0][y][z];
+	if (x >= CHUNK::X)
+		return _sideX[1][y][z];
+	if (y < 0)
+		return _sideY[0][x][z];
+	if (y >= CHUNK::Y)
+		return _sideY[1][x][z];
+	if (z < 0)
+		return _sideZ[0][x][y];
+	if (z >= CHUNK::Z)
+		return _sideZ[1][x][y];
+	return _blocks->block[ChunkLayout::index(x, y, z)];
+}
+
+// Builds the vertices of all visible faces into vertex, which must hold CHUNK::VERTICES,
+// grouped by the Orientation they face, with the count of each in faces if given.
+// Reads nothing but the snapshot, so it is safe on any thread; returns the number of
+// vertices written.
+int ChunkSnapshot::mesh(byte4 *vertex, int *faces) const {
+	return WorldChunkShape::mesh<ChunkLayout>(*this, vertex, faces);
+}
+
+// Hash of everything meshing reads, the chunk's blocks and the neighbouring blocks that
+// touch it, starting from seed. 64-bit FNV-1a a word at a time, with a shift to fold the
+// high bits back down.
+uint64_t ChunkSnapshot::getHash(uint64_t seed) const {
+	static const uint64_t PRIME = 1099511628211ull;
+	const void *parts[4] = { _blocks->block, _sideX, _sideY, _sideZ };
+	size_t sizes[4] = { sizeof(_blocks->block), sizeof(_sideX), sizeof(_sideY), sizeof(_sideZ) };
+	static_assert(sizeof(_sideX) % 8 == 0 && sizeof(_sideY) % 8 == 0 && sizeof(_sideZ) % 8 == 0 && CHUNK::X * CHUNK::Y * CHUNK::Z % 8 == 0,
+		"blocks are hashed eight at a time");
+
+	uint64_t h = seed ^ 14695981039346656037ull;
+	for (int p = 0; p < 4; ++p) {
+		const uint8_t *bytes = (const uint8_t *)parts[p];
+		for (size_t i = 0; i < sizes[p]; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			h = (h ^ word) * PRIME;
+			h ^= h >> 29;
+		}
+	}
+	return h;
+}
+
+void Chunk::upload(const byte4 *vertex, int count) {
+	if (canEnter(STAGE_UPLOADED))
+		_stage = STAGE_UPLOADED;
 
-	_changed = false;
-	_blocks = i;
-	
 	// If this chunk is empty, no need to allocate a chunk slot.
-	if (!_blocks)
+	if (!count)
 		return;
 	
 	// Upload vertices
 	
+	if (!_vbo)
+		glGenBuffers(1, &_vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-	glBufferData(GL_ARRAY_BUFFER, i * sizeof *vertex, vertex, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof *vertex, vertex, GL_STATIC_DRAW);
 }
 
-void Chunk::render() {
-	if (_changed)
-		update();
+// Uploads the mesh in vertex, with the vertex counts of the last mesh() or meshed(), as
+// one packed face each for pullShader.vert, a sixth of the size. render() then draws it
+// from the buffer texture instead of as vertex attributes. Needs OpenGL 3.1.
+void Chunk::uploadFaces(const byte4 *vertex, int count) {
+	if (canEnter(STAGE_UPLOADED))
+		_stage = STAGE_UPLOADED;
+	if (!count)
+		return;
+
+	std::vector<WorldChunkShape::Face> faces(count / 6);
+	WorldChunkShape::pack(vertex, _faces, &faces[0]);
+	_meshBytes = faces.size() * sizeof(faces[0]);
+
+	if (!_vbo)
+		glGenBuffers(1, &_vbo);
+	glBindBuffer(GL_TEXTURE_BUFFER, _vbo);
+	glBufferData(GL_TEXTURE_BUFFER, faces.size() * sizeof(faces[0]), &faces[0], GL_STATIC_DRAW);
 
-	if (!_blocks)
+	if (!_texture) {
+		glGenTextures(1, &_texture);
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, _vbo);
+	}
+}
+
+// Which ways the faces of a chunk can face a camera at eye, in coordinates local to the
+// chunk, as a bit per Orientation. A face only shows from the side it faces, and the
+// faces looking one way lie on the planes from one block in to the far side of the
+// chunk, so a direction is out only when the eye is behind all of them. Along each axis
+// where the eye is outside the chunk's span, the direction facing away from it is dropped,
+// so at most three are dropped in all.
+int Chunk::facing(const vec3 &eye) {
+	int faces = 0;
+	if (eye.z < CHUNK::Z - 1)
+		faces |= 1 << FRONT;
+	if (eye.z > 1)
+		faces |= 1 << BACK;
+	if (eye.y > 1)
+		faces |= 1 << ABOVE;
+	if (eye.y < CHUNK::Y - 1)
+		faces |= 1 << BELOW;
+	if (eye.x < CHUNK::X - 1)
+		faces |= 1 << LEFT;
+	if (eye.x > 1)
+		faces |= 1 << RIGHT;
+	return faces;
+}
+
+// Draws the directions in faces, a bit per Orientation, of the last mesh uploaded, which
+// may be older than the blocks if meshing was deferred. Neighbouring directions go in
+// one range.
+void Chunk::render(int faces) {
+	GLint first[6];
+	GLsizei count[6];
+	int ranges = 0, start = 0;
+
+	for (int o = FRONT; o <= RIGHT; start += _faces[o++]) {
+		if (!(faces & (1 << o)) || !_faces[o])
+			continue;
+		if (ranges && first[ranges - 1] + count[ranges - 1] == start) {
+			count[ranges - 1] += _faces[o];
+		} else {
+			first[ranges] = start;
+			count[ranges++] = _faces[o];
+		}
+	}
+
+	if (!ranges)
 		return;
 
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-	glVertexAttribPointer(PROGRAM::attribute_coord, 4, GL_BYTE, GL_FALSE, 0, 0);
-	glDrawArrays(GL_TRIANGLES, 0, _blocks);
+	// Packed faces are read by the shader from texture unit 1, six vertices each
+	if (_texture) {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glActiveTexture(GL_TEXTURE0);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+		glVertexAttribPointer(PROGRAM::attribute_coord, 4, GL_BYTE, GL_FALSE, 0, 0);
+	}
+	glMultiDrawArrays(GL_TRIANGLES, first, count, ranges);
 }
 
+// Links the chunk next to this one on the side orientation faces, 0 for none, which
+// meshing then waits on to be generated.
 void Chunk::setNeighbour(Orientation orientation, Chunk *neighbour) {
+	Chunk *old = getNeighbour(orientation);
+	if (old && old->_stage == STAGE_EMPTY)
+		--_waiting;
+	if (neighbour && neighbour->_stage == STAGE_EMPTY)
+		++_waiting;
+
 	switch (orientation) {
 		case FRONT:
 			_front = neighbour;
@@ -296,8 +664,82 @@ int Chunk::getZ() {
 	return _z;
 }
 
-bool Chunk::isInitialized() {
-	return _initialized;
+// Seed the chunk was generated with
+int Chunk::getSeed() const {
+	return _seed;
+}
+
+ChunkStage Chunk::getStage() const {
+	return _stage;
+}
+
+// Is all that stage needs there, and is it the next one up from the current stage?
+// Generation needs nothing; meshing needs the blocks of this chunk and of every
+// neighbour, whose edges it reads; uploading needs the mesh.
+bool Chunk::canEnter(ChunkStage stage) const {
+	switch (stage) {
+		case STAGE_GENERATED:
+			return _stage == STAGE_EMPTY;
+		case STAGE_MESHED:
+			return _stage == STAGE_GENERATED && _waiting == 0;
+		case STAGE_UPLOADED:
+			return _stage == STAGE_MESHED;
+		default:
+			return false;
+	}
+}
+
+// Are this chunk and all its neighbours generated, so it can be meshed and drawn?
+bool Chunk::isReady() const {
+	return _waiting == 0;
+}
+
+// Does the chunk have blocks, generated or received?
+bool Chunk::isNoised() const {
+	return _stage != STAGE_EMPTY;
+}
+
+// Does the chunk need meshing?
+bool Chunk::isChanged() const {
+	return _stage < STAGE_MESHED;
+}
+
+// Vertices of the last mesh facing the directions in faces, a bit per Orientation
+int Chunk::getVertexCount(int faces) {
+	int count = 0;
+	for (int o = FRONT; o <= RIGHT; ++o)
+		if (faces & (1 << o))
+			count += _faces[o];
+	return count;
+}
+
+// Flags the chunk for meshing. Meshes built from snapshots taken before are stale.
+void Chunk::markChanged() {
+	if (_stage > STAGE_GENERATED)
+		_stage = STAGE_GENERATED;
+	++_version;
+}
+
+// Moves the chunk into STAGE_GENERATED and releases the chunks whose meshing waited on it.
+void Chunk::generated() {
+	_stage = STAGE_GENERATED;
+	--_waiting;
+	if (_left)
+		--_left->_waiting;
+	if (_right)
+		--_right->_waiting;
+	if (_below)
+		--_below->_waiting;
+	if (_above)
+		--_above->_waiting;
+	if (_front)
+		--_front->_waiting;
+	if (_back)
+		--_back->_waiting;
+}
+
+uint32_t Chunk::getVersion() const {
+	return _version;
 }
 
 Chunk* Chunk::getNeighbour(Orientation orientation) {
@@ -319,6 +761,149 @@ Chunk* Chunk::getNeighbour(Orientation orientation) {
 	return 0;
 }
 
-void Chunk::initialize() {
-	_initialized = true;
+// Run-length encodes the blocks of a dense chunk that is generated and meshed and frees the
+// array. Reads search the runs where they are; the first write expands the chunk again.
+// Meant for chunks nobody is near or editing: terrain is a few hundred runs of four bytes,
+// a quarter to a third of the array.
+void Chunk::compress() {
+	if (!_block || isChanged())
+		return;
+
+	encodeRuns();
+}
+
+// Replaces the dense array with its runs.
+void Chunk::encodeRuns() {
+	std::vector<BlockRun> runs;
+	for (int i = 0; i < CHUNK::X * CHUNK::Y * CHUNK::Z; ++i) {
+		if (runs.empty() || runs.back().type != _block[i]) {
+			BlockRun run = { (uint16_t)i, _block[i] };
+			runs.push_back(run);
+		}
+		else
+			runs.back().last = (uint16_t)i;
+	}
+
+	freeBlocks();
+	_runs.assign(runs.begin(), runs.end());
+}
+
+// Moves the blocks of this chunk into a shared sparse voxel DAG and frees the dense array
+// or runs. Meant for far away chunks that are generated and meshed and rarely change.
+void Chunk::compact(VoxelDAG *dag) {
+	if ((!_block && _runs.empty()) || isChanged())
+		return;
+
+	uint8_t block[CHUNK::X * CHUNK::Y * CHUNK::Z];
+	getBlocks(block);
+	freeBlocks();
+	_dag = dag;
+	_root = dag->build(block);
+}
+
+// Frees the blocks of a generated, meshed chunk that differs from generation in at most
+// CHUNK::MAX_DIFF blocks, keeping only those. Returns false if it differs in more.
+bool Chunk::makeProcedural() {
+	if (isChanged() || isProcedural())
+		return false;
+
+	std::vector<BlockDiff> blocks;
+	if (diff(blocks) > CHUNK::MAX_DIFF)
+		return false;
+
+	freeBlocks();
+	_diff.swap(blocks);
+	_edited = !_diff.empty();
+	return true;
+}
+
+// Frees what of the blocks of a generated chunk can be rebuilt from the seed: all but those
+// that differ from generation, or if there are more than CHUNK::MAX_DIFF, all but their
+// runs. Unlike makeProcedural() and compress() it doesn't wait for the chunk to be
+// meshed, so it is for chunks nobody is near. Returns false if nothing was freed.
+bool Chunk::evictBlocks() {
+	if (_stage == STAGE_EMPTY || isProcedural())
+		return false;
+
+	std::vector<BlockDiff> blocks;
+	if (diff(blocks) <= CHUNK::MAX_DIFF) {
+		freeBlocks();
+		_diff.swap(blocks);
+		_edited = !_diff.empty();
+		return true;
+	}
+	if (!_block)
+		return false;
+
+	encodeRuns();
+	return true;
+}
+
+// Brings a compressed, compacted or procedural chunk back to a dense array, e.g. when it
+// comes near or is edited.
+void Chunk::expand() {
+	if (_block)
+		return;
+
+	uint8_t block[CHUNK::X * CHUNK::Y * CHUNK::Z];
+	getBlocks(block);
+	freeBlocks();
+	ChunkBlocks *data = new_blocks();
+	store_blocks(block, data->block);
+	_data = data;
+	_block = data->block;
+}
+
+// Drops the blocks however they are stored, leaving the chunk as generation without diff.
+void Chunk::freeBlocks() {
+	if (_data)
+		release_blocks(_data);
+	if (_dag)
+		_dag->release(_root);
+	_data = 0;
+	_block = 0;
+	_dag = 0;
+	_root = 0;
+	std::vector<BlockRun>().swap(_runs);
+	std::vector<BlockDiff>().swap(_diff);
+}
+
+ChunkStorage Chunk::getStorage() const {
+	return _block ? STORAGE_DENSE : !_runs.empty() ? STORAGE_RUNS : _dag ? STORAGE_DAG : STORAGE_PROCEDURAL;
+}
+
+bool Chunk::isCompact() const {
+	return !_block;
+}
+
+// Is the chunk held as generation plus diff, without stored blocks?
+bool Chunk::isProcedural() const {
+	return getStorage() == STORAGE_PROCEDURAL;
+}
+
+// Memory the chunk's blocks take up on their own; DAG nodes are shared and not counted.
+size_t Chunk::getBytes() const {
+	return (_block ? CHUNK::X * CHUNK::Y * CHUNK::Z : 0) + _runs.capacity() * sizeof(BlockRun) +
+		_diff.capacity() * sizeof(BlockDiff);
+}
+
+// Bytes the chunk's mesh takes on the GPU; headless, what it would take.
+size_t Chunk::getMeshBytes() const {
+	return _meshBytes;
+}
+
+// Frees the mesh, on the GPU and its vertex counts. The chunk drops back to
+// STAGE_GENERATED and is meshed again when next drawn; its blocks and version stay.
+void Chunk::dropMesh() {
+	if (_texture)
+		glDeleteTextures(1, &_texture);
+	if (_vbo)
+		glDeleteBuffers(1, &_vbo);
+	_texture = 0;
+	_vbo = 0;
+	_blocks = 0;
+	memset(_faces, 0, sizeof(_faces));
+	_meshBytes = 0;
+	if (_stage > STAGE_GENERATED)
+		_stage = STAGE_GENERATED;
 }
\ No newline at end of file
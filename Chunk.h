@@ -4,13 +4,105 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <cstring>
+#include <atomic>
+#include <vector>
 #include "Constants.h"
+#include "ChunkShape.h"
+#include "VoxelDAG.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/noise.hpp>
 
+typedef glm::tvec4<GLbyte, glm::mediump> byte4;
+
+typedef ChunkShape<CHUNK::X, CHUNK::Y, CHUNK::Z> WorldChunkShape;
+typedef std::conditional<CHUNK::MORTON, MortonLayout<CHUNK::X, CHUNK::Y, CHUNK::Z>, RowMajorLayout<CHUNK::X, CHUNK::Y, CHUNK::Z> >::type ChunkLayout;
+static_assert(std::is_same<WorldChunkShape::Vertex, byte4>::value, "chunk vertices are uploaded as GL_BYTE");
+static_assert(CHUNK::X * CHUNK::Y * CHUNK::Z <= 65536, "BlockDiff indices and BlockRun ends are 16 bits");
+static_assert(CHUNK::VERTICES == WorldChunkShape::VERTICES, "CHUNK::VERTICES is the mesher's worst case");
+
 static enum Orientation {FRONT, BACK, ABOVE, BELOW, LEFT, RIGHT};
 
+// Where a chunk is in its life. It goes up one stage at a time as the work of each is
+// done, once Chunk::canEnter says what that stage needs is there, and drops back to
+// STAGE_GENERATED when its blocks or a neighbour's change and its mesh is stale.
+static enum ChunkStage {
+	// No blocks yet, save edits made before generation
+	STAGE_EMPTY,
+	// Blocks generated or received
+	STAGE_GENERATED,
+	// Mesh built from the current blocks
+	STAGE_MESHED,
+	// That mesh is on the GPU
+	STAGE_UPLOADED
+};
+
+// How a chunk holds its blocks, from quickest to read and write to smallest. Only dense
+// chunks are written in place; the others are expanded by their first write.
+static enum ChunkStorage {
+	// An array of blocks in ChunkLayout order
+	STORAGE_DENSE,
+	// Runs of one block type in ChunkLayout order, read by binary search
+	STORAGE_RUNS,
+	// Nodes of a VoxelDAG shared with other chunks
+	STORAGE_DAG,
+	// What generation gives plus the blocks that differ
+	STORAGE_PROCEDURAL
+};
+
+// A block that differs from what generation puts there, by index (x * Y + y) * Z + z
+struct BlockDiff {
+	uint16_t index;
+	uint8_t type;
+};
+
+// Blocks of one type in ChunkLayout order, from after the last block of the run before up
+// to and including last
+struct BlockRun {
+	uint16_t last;
+	uint8_t type;
+};
+
+// Dense blocks of a chunk in ChunkLayout order, shared copy-on-write between the chunk
+// and its snapshots
+struct ChunkBlocks {
+	mutable std::atomic<int> refs;
+	uint8_t block[CHUNK::X * CHUNK::Y * CHUNK::Z];
+};
+
+class Chunk;
+class MeshCache;
+
+// What meshing a chunk needs, frozen at one version: the chunk's blocks, shared with it
+// until it is next written, and copies of the neighbouring blocks that touch it.
+// Safe to read on any thread while the world goes on being edited.
+class ChunkSnapshot {
+public:
+	ChunkSnapshot();
+	~ChunkSnapshot();
+
+	uint8_t getBlock(int x, int y, int z) const;
+	int mesh(byte4 *vertex, int *faces = 0) const;
+	uint64_t getHash(uint64_t seed) const;
+	Chunk *getChunk() const;
+	uint32_t getVersion() const;
+
+private:
+	ChunkSnapshot(const ChunkSnapshot &);
+	ChunkSnapshot &operator=(const ChunkSnapshot &);
+
+	friend class Chunk;
+
+	Chunk *_chunk;
+	const ChunkBlocks *_blocks;
+	uint32_t _version;
+	// Blocks of the neighbours next to each side: [0] left, below and front, [1] right,
+	// above and back
+	uint8_t _sideX[2][CHUNK::Y][CHUNK::Z];
+	uint8_t _sideY[2][CHUNK::X][CHUNK::Z];
+	uint8_t _sideZ[2][CHUNK::X][CHUNK::Y];
+};
+
 class Chunk {
 public:
 	Chunk(int x, int y, int z);
@@ -18,27 +110,97 @@ public:
 
 	uint8_t getBlock(int x, int y, int z) const;
 	void setBlock(int x, int y, int z, uint8_t type);
+	void setLocalBlock(int x, int y, int z, uint8_t type);
 	static float noise2d(int octaves, float x, float y, int seed);
 	static float noise3d(int octaves, float x, float y, float z, int seed);
 	void noise(int seed);
+	void generate(uint8_t *block) const;
+	static void generate(int x, int y, int z, int seed, uint8_t *block);
+	void getBlocks(uint8_t *block) const;
+	void setBlocks(const uint8_t *block, int seed);
+	int diff(std::vector<BlockDiff> &diff) const;
 	void update();
-	void render();
+	int mesh(byte4 *vertex, MeshCache *cache = 0);
+	void takeSnapshot(ChunkSnapshot *snapshot);
+	const ChunkBlocks *shareBlocks() const;
+	static void releaseBlocks(const ChunkBlocks *blocks);
+	bool meshed(const ChunkSnapshot &snapshot, const int *faces);
+	void upload(const byte4 *vertex, int count);
+	void uploadFaces(const byte4 *vertex, int count);
+	static int facing(const glm::vec3 &eye);
+	void render(int faces = 0x3f);
 	void setNeighbour(Orientation orientation, Chunk *neighbour);
 	int getX();
 	int getY();
 	int getZ();
-	bool isInitialized();
-	void initialize();
+	int getSeed() const;
+	ChunkStage getStage() const;
+	bool canEnter(ChunkStage stage) const;
+	bool isReady() const;
+	bool isNoised() const;
+	bool isChanged() const;
+	int getVertexCount(int faces = 0x3f);
+	void markChanged();
+	uint32_t getVersion() const;
 	Chunk* getNeighbour(Orientation oriantation);
+	void compress();
+	void compact(VoxelDAG *dag);
+	bool makeProcedural();
+	bool evictBlocks();
+	void expand();
+	void own();
+	ChunkStorage getStorage() const;
+	bool isCompact() const;
+	bool isProcedural() const;
+	size_t getBytes() const;
+	size_t getMeshBytes() const;
+	void dropMesh();
 
 
 private:
-	uint8_t _block[CHUNK::X][CHUNK::Y][CHUNK::Z];
+	friend class BlockAccessor;
+
+	uint8_t blockAt(int x, int y, int z) const {
+		return _block ? _block[ChunkLayout::index(x, y, z)] : !_runs.empty() ? runBlock(ChunkLayout::index(x, y, z)) :
+			_dag ? _dag->getBlock(_root, x, y, z) : proceduralBlock(x, y, z);
+	}
+
+	void freeBlocks();
+	void encodeRuns();
+	uint8_t runBlock(int index) const;
+	void generated();
+	uint8_t proceduralBlock(int x, int y, int z) const;
+	float land(int x, int z) const;
+	uint8_t terrain(int x, int y, int z, float land) const;
+
+	// Blocks are held in one of the ChunkStorage ways: dense in _block, run-length encoded
+	// in _runs, compacted into _dag, or, with none of those, as what generation gives plus
+	// the blocks in _diff. _block points into _data, which snapshots may share; it is
+	// copied before it is written then.
+	ChunkBlocks *_data;
+	uint8_t *_block;
+	std::vector<BlockRun> _runs;
+	VoxelDAG *_dag;
+	uint32_t _root;
+	std::vector<BlockDiff> _diff;
+	int _seed;
 	Chunk *_front, *_back, *_above, *_below, *_left, *_right;
 	int _slot;
 	GLuint _vbo;
+	// Buffer texture over _vbo when it holds packed faces rather than vertices
+	GLuint _texture;
 	int _blocks;
-	bool _changed, _noised, _initialized;
+	// Vertices of the mesh facing each Orientation, which follow each other in that order
+	int _faces[6];
+	// Bytes of the mesh in _vbo, or that it would take there when nothing is uploaded
+	size_t _meshBytes;
+	ChunkStage _stage;
+	// How many of this chunk and its neighbours aren't generated yet; meshing waits for 0
+	int _waiting;
+	// Bumped whenever the chunk needs meshing again
+	uint32_t _version;
+	// Set once blocks may differ from what generation gives
+	bool _edited;
 	int _x, _y, _z;
 };
 
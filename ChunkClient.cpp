@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "ChunkClient.h"
+#include "Timer.h"
+#include "World.h"
+
+static const double NONE = -1;
+static const double RECEIVED = -2;
+
+ChunkClient::ChunkClient() : _seed(0), _pending(0), _received(0) {
+	_requested.assign(WORLD::X * WORLD::Y * WORLD::Z, NONE);
+}
+
+int ChunkClient::index(int cx, int cy, int cz) {
+	return (cx * WORLD::Y + cy) * WORLD::Z + cz;
+}
+
+// Connects to a ChunkServer and waits for its greeting, which carries the world seed.
+bool ChunkClient::connect(const char *host, int port) {
+	if (!_connection.connect(host, port))
+		return false;
+
+	uint8_t type;
+	std::vector<uint8_t> payload;
+	double deadline = now_ms() + 5000;
+	while (now_ms() < deadline) {
+		if (_connection.wait(100) && !_connection.receive())
+			break;
+		if (!_connection.next(&type, payload)) {
+			if (!_connection.isOpen())
+				break;
+			continue;
+		}
+
+		if (type != MESSAGE::HELLO || payload.size() != 8)
+			break;
+		_seed = (time_t)((uint64_t)get32(&payload[0]) | (uint64_t)get32(&payload[4]) << 32);
+		return true;
+	}
+
+	fprintf(stderr, "Error: no greeting from %s:%d\n", host, port);
+	_connection.close();
+	return false;
+}
+
+time_t ChunkClient::getSeed() const {
+	return _seed;
+}
+
+// Asks for the chunk at grid index (cx, cy, cz), unless it was asked for already.
+void ChunkClient::request(int cx, int cy, int cz) {
+	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz < 0 || cz >= WORLD::Z)
+		return;
+
+	double &requested = _requested[index(cx, cy, cz)];
+	if (requested != NONE)
+		return;
+
+	std::vector<uint8_t> payload;
+	put32(payload, cx);
+	put32(payload, cy);
+	put32(payload, cz);
+	_connection.send(MESSAGE::REQUEST, payload);
+	requested = now_ms();
+	++_pending;
+}
+
+// Tells the server the chunk at (cx, cy, cz) is no longer kept, so it stops sending
+// edits to it. It can be requested again later.
+void ChunkClient::drop(int cx, int cy, int cz) {
+	if (!isRequested(cx, cy, cz))
+		return;
+
+	double &requested = _requested[index(cx, cy, cz)];
+	if (requested != RECEIVED)
+		--_pending;
+	requested = NONE;
+
+	std::vector<uint8_t> payload;
+	put32(payload, cx);
+	put32(payload, cy);
+	put32(payload, cz);
+	_connection.send(MESSAGE::DROP, payload);
+}
+
+// Withdraws the request for the chunk at (cx, cy, cz) if it hasn't arrived yet; the
+// server drops it from its queue.
+void ChunkClient::cancel(int cx, int cy, int cz) {
+	if (isRequested(cx, cy, cz) && _requested[index(cx, cy, cz)] != RECEIVED)
+		drop(cx, cy, cz);
+}
+
+// Has the server send the chunks at the given grid indices, most urgent first, before the
+// rest it was asked for. Only the first NET::BATCH count, and nothing is sent while they
+// stay the same.
+void ChunkClient::prioritize(const std::vector<int> &indices) {
+	std::vector<int> first(indices.begin(), indices.begin() + std::min(indices.size(), (size_t)NET::BATCH));
+	if (first == _prioritized)
+		return;
+
+	// Each goes to the front of the queue, so the most urgent is sent last
+	for (size_t i = first.size(); i-- > 0;) {
+		std::vector<uint8_t> payload;
+		put32(payload, first[i] / (WORLD::Y * WORLD::Z));
+		put32(payload, first[i] / WORLD::Z % WORLD::Y);
+		put32(payload, first[i] % WORLD::Z);
+		_connection.send(MESSAGE::PRIORITY, payload);
+	}
+	_prioritized.swap(first);
+}
+
+bool ChunkClient::isRequested(int cx, int cy, int cz) const {
+	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz < 0 || cz >= WORLD::Z)
+		return false;
+
+	return _requested[index(cx, cy, cz)] != NONE;
+}
+
+// Sends a block edit to the server, which applies it and passes it on.
+void ChunkClient::edit(int x, int y, int z, uint8_t type) {
+	std::vector<uint8_t> payload;
+	put32(payload, x);
+	put32(payload, y);
+	put32(payload, z);
+	payload.push_back(type);
+	_connection.send(MESSAGE::EDIT, payload);
+}
+
+// Sends what is queued and applies whatever arrived to world, waiting up to ms
+// milliseconds for something to arrive. Returns the number of messages handled.
+int ChunkClient::poll(World *world, int ms) {
+	if (!_connection.isOpen())
+		return 0;
+
+	if (!_connection.flush() || (_connection.wait(ms) && !_connection.receive())) {
+		fprintf(stderr, "Error: lost the connection to the server\n");
+		_connection.close();
+		return 0;
+	}
+
+	int handled = 0;
+	uint8_t type;
+	std::vector<uint8_t> payload;
+	uint8_t blocks[CHUNK::X * CHUNK::Y * CHUNK::Z];
+
+	while (_connection.next(&type, payload)) {
+		if (type == MESSAGE::CHUNK && payload.size() >= 12) {
+			int cx = get32(&payload[0]);
+			int cy = get32(&payload[4]);
+			int cz = get32(&payload[8]);
+			if (!world->getChunk(cx, cy, cz) || !decode_blocks(&payload[12], payload.size() - 12, blocks, sizeof(blocks))) {
+				fprintf(stderr, "Error: bad chunk from the server\n");
+				continue;
+			}
+
+			// A chunk dropped while it was on the way gets no more edits, so it is stale
+			double &requested = _requested[index(cx, cy, cz)];
+			if (requested == NONE)
+				continue;
+			if (requested >= 0) {
+				_latencies.push_back(now_ms() - requested);
+				--_pending;
+			}
+			requested = RECEIVED;
+			++_received;
+			world->load(cx, cy, cz, blocks);
+		}
+		else if (type == MESSAGE::DELTA && payload.size() == 13) {
+			world->setBlock(get32(&payload[0]), get32(&payload[4]), get32(&payload[8]), payload[12]);
+		}
+		++handled;
+	}
+
+	if (!_connection.isOpen()) {
+		fprintf(stderr, "Error: bad message from the server\n");
+		return handled;
+	}
+
+	_connection.flush();
+	return handled;
+}
+
+// Chunks requested that haven't arrived yet
+int ChunkClient::getPending() const {
+	return _pending;
+}
+
+int ChunkClient::getReceived() const {
+	return _received;
+}
+
+const std::vector<double> &ChunkClient::getLatencies() const {
+	return _latencies;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <time.h>
+#include <vector>
+
+#include "Constants.h"
+#include "Network.h"
+
+class World;
+
+// Client side of the chunk stream. Requests chunks from a ChunkServer and fills them into
+// a local World as they arrive, along with the edits other clients make to them.
+class ChunkClient {
+public:
+	ChunkClient();
+
+	bool connect(const char *host, int port);
+	time_t getSeed() const;
+	void request(int cx, int cy, int cz);
+	void drop(int cx, int cy, int cz);
+	void cancel(int cx, int cy, int cz);
+	void prioritize(const std::vector<int> &indices);
+	bool isRequested(int cx, int cy, int cz) const;
+	void edit(int x, int y, int z, uint8_t type);
+	int poll(World *world, int ms);
+	int getPending() const;
+	int getReceived() const;
+	const std::vector<double> &getLatencies() const;
+
+private:
+	static int index(int cx, int cy, int cz);
+
+	Connection _connection;
+	time_t _seed;
+	// Per chunk: when it was requested, RECEIVED once it arrived, or NONE
+	std::vector<double> _requested;
+	int _pending, _received;
+	// Milliseconds from request to arrival of every chunk received
+	std::vector<double> _latencies;
+	// Chunk indices last sent to the front of the server's queue, most urgent first
+	std::vector<int> _prioritized;
+};
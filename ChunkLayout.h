@@ -0,0 +1,75 @@
+#pragma once
+
+// How the blocks of an X by Y by Z chunk are laid out in a flat array. index gives where
+// a block is stored and position the block stored at an index, so walking the indices in
+// order with position visits the blocks in the order they sit in memory.
+
+// x, then y, then z: blocks along z are next to each other, those along x Y * Z apart.
+template <int X, int Y, int Z>
+struct RowMajorLayout {
+	static int index(int x, int y, int z) {
+		return (x * Y + y) * Z + z;
+	}
+
+	static void position(int index, int *x, int *y, int *z) {
+		*z = index % Z;
+		*y = index / Z % Y;
+		*x = index / (Y * Z);
+	}
+};
+
+// Z-order: the bits of x, y and z interleaved, so every aligned 2x2x2, 4x4x4, ... cube of
+// blocks is stored together and neighbours along any axis are close on average.
+template <int X, int Y, int Z>
+struct MortonLayout {
+	static_assert(X == Y && Y == Z, "Morton order needs a cube");
+	static_assert((X & (X - 1)) == 0 && X <= 1024, "Morton order needs a power of two side of at most 1024");
+
+	static int index(int x, int y, int z) {
+		return _spread.x[x] | _spread.y[y] | _spread.z[z];
+	}
+
+	static void position(int index, int *x, int *y, int *z) {
+		*x = compact(index >> 2);
+		*y = compact(index >> 1);
+		*z = compact(index);
+	}
+
+private:
+	// Each coordinate spread out to its bits of the index, looked up rather than computed
+	struct Spread {
+		int x[X], y[Y], z[Z];
+
+		Spread() {
+			for (int i = 0; i < X; ++i) {
+				x[i] = spread(i) << 2;
+				y[i] = spread(i) << 1;
+				z[i] = spread(i);
+			}
+		}
+	};
+
+	static const Spread _spread;
+
+	// Moves bit i of v to bit 3 * i
+	static int spread(int v) {
+		v = (v | v << 16) & 0x030000FF;
+		v = (v | v << 8) & 0x0300F00F;
+		v = (v | v << 4) & 0x030C30C3;
+		v = (v | v << 2) & 0x09249249;
+		return v;
+	}
+
+	// Moves bit 3 * i of v to bit i, dropping the others
+	static int compact(int v) {
+		v &= 0x09249249;
+		v = (v | v >> 2) & 0x030C30C3;
+		v = (v | v >> 4) & 0x0300F00F;
+		v = (v | v >> 8) & 0x030000FF;
+		v = (v | v >> 16) & 0x000003FF;
+		return v;
+	}
+};
+
+template <int X, int Y, int Z>
+const typename MortonLayout<X, Y, Z>::Spread MortonLayout<X, Y, Z>::_spread;
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include "ChunkScheduler.h"
+#include "World.h"
+
+using namespace glm;
+
+// Centre of the chunk at grid index, relative to eye
+static vec3 chunk_offset(int index, const vec3 &eye) {
+	int cx = index / (WORLD::Y * WORLD::Z);
+	int cy = index / WORLD::Z % WORLD::Y;
+	int cz = index % WORLD::Z;
+	return (vec3(cx - WORLD::X / 2, cy - WORLD::Y / 2, cz - WORLD::Z / 2) + 0.5f) * vec3(CHUNK::X, CHUNK::Y, CHUNK::Z) - eye;
+}
+
+ChunkScheduler::ChunkScheduler() {
+	_flying.assign(WORLD::X * WORLD::Y * WORLD::Z, false);
+}
+
+// Requeues every chunk within radius blocks of eye that still needs loading. The queue is
+// rebuilt from scratch each time, which drops chunks that left the radius or were loaded
+// some other way since, and reorders those the camera moved or turned away from. Chunks in
+// flight are ranked the same way, or cancelled once they are well out of the radius.
+void ChunkScheduler::update(const World *world, const vec3 &eye, const vec3 &forward, const vec3 &velocity, float radius) {
+	_heap.clear();
+
+	int lo[3], hi[3];
+	static const int size[3] = { CHUNK::X, CHUNK::Y, CHUNK::Z };
+	static const int count[3] = { WORLD::X, WORLD::Y, WORLD::Z };
+	for (int a = 0; a < 3; ++a) {
+		lo[a] = std::max(0, (int)floorf((eye[a] - radius) / size[a]) + count[a] / 2);
+		hi[a] = std::min(count[a] - 1, (int)floorf((eye[a] + radius) / size[a]) + count[a] / 2);
+	}
+
+	for (int cx = lo[0]; cx <= hi[0]; ++cx) {
+		for (int cy = lo[1]; cy <= hi[1]; ++cy) {
+			for (int cz = lo[2]; cz <= hi[2]; ++cz) {
+				if (world->getChunk(cx, cy, cz)->isReady() || world->isLoading(cx, cy, cz))
+					continue;
+
+				Request request;
+				request.index = (cx * WORLD::Y + cy) * WORLD::Z + cz;
+				vec3 to = chunk_offset(request.index, eye);
+				if (length(to) > radius)
+					continue;
+
+				request.priority = priority(to, forward, velocity);
+				_heap.push_back(request);
+			}
+		}
+	}
+
+	std::make_heap(_heap.begin(), _heap.end());
+
+	// Those that arrived are done with. Neighbours come along with the chunks in the radius
+	// for meshing, so only those more than a chunk beyond it are cancelled.
+	float keep = radius + std::max(CHUNK::X, std::max(CHUNK::Y, CHUNK::Z));
+	std::vector<Request> flying;
+	for (size_t i = 0; i < _inFlight.size(); ++i) {
+		int index = _inFlight[i];
+		Request request;
+		request.index = index;
+		vec3 to = chunk_offset(index, eye);
+
+		if (!world->isLoading(index / (WORLD::Y * WORLD::Z), index / WORLD::Z % WORLD::Y, index % WORLD::Z))
+			_flying[index] = false;
+		else if (length(to) > keep) {
+			_flying[index] = false;
+			_cancelled.push_back(index);
+		}
+		else {
+			request.priority = priority(to, forward, velocity);
+			flying.push_back(request);
+		}
+	}
+
+	// Most urgent first
+	std::sort(flying.begin(), flying.end(), [](const Request &a, const Request &b) { return a.priority < b.priority; });
+	_inFlight.resize(flying.size());
+	for (size_t i = 0; i < flying.size(); ++i)
+		_inFlight[i] = flying[i].index;
+}
+
+// Takes the most urgent chunk off the queue. Returns false when there is none left.
+bool ChunkScheduler::next(int *cx, int *cy, int *cz) {
+	if (_heap.empty())
+		return false;
+
+	std::pop_heap(_heap.begin(), _heap.end());
+	int index = _heap.back().index;
+	_heap.pop_back();
+
+	*cx = index / (WORLD::Y * WORLD::Z);
+	*cy = index / WORLD::Z % WORLD::Y;
+	*cz = index % WORLD::Z;
+	return true;
+}
+
+// Notes that the chunk at grid index (cx, cy, cz) was asked for from a server.
+void ChunkScheduler::requested(int cx, int cy, int cz) {
+	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz < 0 || cz >= WORLD::Z)
+		return;
+
+	int index = (cx * WORLD::Y + cy) * WORLD::Z + cz;
+	if (_flying[index])
+		return;
+
+	_flying[index] = true;
+	_inFlight.push_back(index);
+}
+
+// Takes the next chunk in flight that left the radius. Returns false when there is none.
+bool ChunkScheduler::nextCancelled(int *cx, int *cy, int *cz) {
+	if (_cancelled.empty())
+		return false;
+
+	int index = _cancelled.back();
+	_cancelled.pop_back();
+	*cx = index / (WORLD::Y * WORLD::Z);
+	*cy = index / WORLD::Z % WORLD::Y;
+	*cz = index % WORLD::Z;
+	return true;
+}
+
+// Chunk indices in flight and still in the radius as of the last update, most urgent first
+const std::vector<int> &ChunkScheduler::getInFlight() const {
+	return _inFlight;
+}
+
+// Lower is sooner. Chunks behind the camera count up to 1 + LOAD::BEHIND times as far
+// away, those the camera is moving towards down to 1 - LOAD::AHEAD times.
+float ChunkScheduler::priority(const vec3 &to, const vec3 &forward, const vec3 &velocity) {
+	float d = length(to);
+	float speed = length(velocity);
+	float facing = d > 0 ? dot(to, forward) / d : 1;
+	float ahead = d > 0 && speed > 0 ? dot(to, velocity) / (d * speed) : 0;
+	return d * (1 + LOAD::BEHIND * (1 - facing) / 2) * (1 - LOAD::AHEAD * std::max(0.0f, ahead));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Constants.h"
+
+class World;
+
+// Decides which chunks to load next. Every chunk within the load radius of the camera
+// that isn't ready to mesh or on its way from a server is queued with a priority from its
+// distance, how far it is off the view direction and whether the camera is moving towards
+// it. Only the chunks in the radius are looked at, so the cost doesn't grow with the size
+// of the world.
+// Chunks asked for from a server stay in flight until they arrive. Those still in the
+// radius are ranked each update like the queue, for the server to send the most urgent
+// first; those that leave it are cancelled, for the caller to withdraw.
+class ChunkScheduler {
+public:
+	ChunkScheduler();
+
+	void update(const World *world, const glm::vec3 &eye, const glm::vec3 &forward, const glm::vec3 &velocity, float radius);
+	bool next(int *cx, int *cy, int *cz);
+	void requested(int cx, int cy, int cz);
+	bool nextCancelled(int *cx, int *cy, int *cz);
+	const std::vector<int> &getInFlight() const;
+
+private:
+	struct Request {
+		float priority;
+		int index;
+
+		// Makes the heap a min-heap on priority
+		bool operator<(const Request &other) const {
+			return priority > other.priority;
+		}
+	};
+
+	static float priority(const glm::vec3 &to, const glm::vec3 &forward, const glm::vec3 &velocity);
+
+	std::vector<Request> _heap;
+	// Chunk indices asked for from a server that haven't arrived, and per chunk index
+	// whether it is one of them
+	std::vector<int> _inFlight;
+	std::vector<bool> _flying;
+	// In flight chunks that left the radius, for nextCancelled
+	std::vector<int> _cancelled;
+};
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "ChunkServer.h"
+#include "World.h"
+
+ChunkServer::ChunkServer(World *world) : _world(world), _listener(NO_SOCKET), _chunks(0), _bytes(0), _edits(0) {
+	_encoded.resize(WORLD::X * WORLD::Y * WORLD::Z);
+}
+
+ChunkServer::~ChunkServer() {
+	for (size_t i = 0; i < _clients.size(); ++i)
+		delete _clients[i];
+	if (_listener != NO_SOCKET)
+		net_close(_listener);
+}
+
+// Starts listening on port; 0 picks a free one, see getPort().
+bool ChunkServer::listen(int port) {
+	_listener = net_listen(port);
+	return _listener != NO_SOCKET;
+}
+
+int ChunkServer::getPort() const {
+	return _listener != NO_SOCKET ? net_port(_listener) : 0;
+}
+
+// One round of serving: waits up to ms milliseconds for something to do, then takes
+// new connections, handles what clients sent and sends each of them up to NET::BATCH of
+// the chunks they asked for.
+void ChunkServer::serve(int ms) {
+	fd_set read, write;
+	FD_ZERO(&read);
+	FD_ZERO(&write);
+	FD_SET(_listener, &read);
+	socket_t last = _listener;
+	bool busy = false;
+
+	for (size_t i = 0; i < _clients.size(); ++i) {
+		socket_t s = _clients[i]->connection.getSocket();
+		FD_SET(s, &read);
+		if (_clients[i]->connection.hasOutput())
+			FD_SET(s, &write);
+		else if (!_clients[i]->requests.empty())
+			busy = true;
+		if (s > last)
+			last = s;
+	}
+
+	timeval timeout = { busy ? 0 : ms / 1000, busy ? 0 : ms % 1000 * 1000 };
+	if (select((int)last + 1, &read, &write, 0, &timeout) < 0)
+		return;
+
+	if (FD_ISSET(_listener, &read))
+		accept();
+
+	uint8_t type;
+	std::vector<uint8_t> payload;
+
+	for (size_t i = 0; i < _clients.size(); ++i) {
+		Client *client = _clients[i];
+		bool ok = !FD_ISSET(client->connection.getSocket(), &read) || client->connection.receive();
+
+		while (ok && client->connection.next(&type, payload))
+			ok = handle(client, type, payload);
+
+		// Only queue more chunks once the last ones are out, so a slow client can't
+		// pile up output here
+		for (int n = 0; ok && n < NET::BATCH && !client->requests.empty() && !client->connection.hasOutput(); ++n) {
+			int index = client->requests.front();
+			client->requests.pop_front();
+
+			const std::vector<uint8_t> &chunk = encoded(index);
+			client->connection.send(MESSAGE::CHUNK, chunk);
+			client->keeps[index] = true;
+			++_chunks;
+			_bytes += chunk.size();
+		}
+
+		if (!ok || !client->connection.isOpen() || !client->connection.flush()) {
+			delete client;
+			_clients.erase(_clients.begin() + i--);
+		}
+	}
+}
+
+// Takes all waiting connections and greets them with the seed.
+void ChunkServer::accept() {
+	socket_t s;
+	while ((s = net_accept(_listener)) != NO_SOCKET) {
+		Client *client = new Client;
+		client->connection.adopt(s);
+		client->keeps.assign(WORLD::X * WORLD::Y * WORLD::Z, false);
+
+		uint64_t seed = (uint64_t)_world->getSeed();
+		std::vector<uint8_t> hello;
+		put32(hello, (uint32_t)seed);
+		put32(hello, (uint32_t)(seed >> 32));
+		client->connection.send(MESSAGE::HELLO, hello);
+		_clients.push_back(client);
+	}
+}
+
+// Acts on one message from client. Returns false if it makes no sense.
+bool ChunkServer::handle(Client *client, uint8_t type, const std::vector<uint8_t> &payload) {
+	if ((type == MESSAGE::REQUEST || type == MESSAGE::DROP || type == MESSAGE::PRIORITY) && payload.size() == 12) {
+		int cx = get32(&payload[0]);
+		int cy = get32(&payload[4]);
+		int cz = get32(&payload[8]);
+		if (!_world->getChunk(cx, cy, cz))
+			return false;
+
+		int index = (cx * WORLD::Y + cy) * WORLD::Z + cz;
+		if (type == MESSAGE::REQUEST) {
+			client->requests.push_back(index);
+		}
+		else if (type == MESSAGE::PRIORITY) {
+			std::deque<int>::iterator i = std::find(client->requests.begin(), client->requests.end(), index);
+			if (i != client->requests.end()) {
+				client->requests.erase(i);
+				client->requests.push_front(index);
+			}
+		}
+		else {
+			for (size_t i = 0; i < client->requests.size(); ++i)
+				if (client->requests[i] == index)
+					client->requests.erase(client->requests.begin() + i--);
+			client->keeps[index] = false;
+		}
+		return true;
+	}
+
+	if (type == MESSAGE::EDIT && payload.size() == 13) {
+		int x = get32(&payload[0]);
+		int y = get32(&payload[4]);
+		int z = get32(&payload[8]);
+		Chunk *chunk = _world->findChunk(x, y, z);
+		if (!chunk)
+			return true;
+
+		_world->generate(chunk);
+		_world->setBlock(x, y, z, payload[12]);
+
+		int index = ((chunk->getX() + WORLD::X / 2) * WORLD::Y + chunk->getY() + WORLD::Y / 2) * WORLD::Z + chunk->getZ() + WORLD::Z / 2;
+		std::vector<uint8_t>().swap(_encoded[index]);
+
+		for (size_t i = 0; i < _clients.size(); ++i) {
+			if (_clients[i]->keeps[index]) {
+				_clients[i]->connection.send(MESSAGE::DELTA, payload);
+				++_edits;
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// The CHUNK payload of the chunk at index, generating and encoding it if needed.
+const std::vector<uint8_t> &ChunkServer::encoded(int index) {
+	std::vector<uint8_t> &message = _encoded[index];
+	if (!message.empty())
+		return message;
+
+	int cx = index / (WORLD::Y * WORLD::Z);
+	int cy = index / WORLD::Z % WORLD::Y;
+	int cz = index % WORLD::Z;
+	Chunk *chunk = _world->getChunk(cx, cy, cz);
+	_world->generate(chunk);
+
+	uint8_t blocks[CHUNK::X * CHUNK::Y * CHUNK::Z];
+	chunk->getBlocks(blocks);
+
+	put32(message, cx);
+	put32(message, cy);
+	put32(message, cz);
+	encode_blocks(blocks, sizeof(blocks), message);
+	return message;
+}
+
+int ChunkServer::getClients() const {
+	return (int)_clients.size();
+}
+
+uint64_t ChunkServer::getChunksSent() const {
+	return _chunks;
+}
+
+uint64_t ChunkServer::getBytesSent() const {
+	return _bytes;
+}
+
+// DELTA messages sent, one per edit and client that keeps its chunk
+uint64_t ChunkServer::getEditsSent() const {
+	return _edits;
+}
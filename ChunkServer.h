@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "Constants.h"
+#include "Network.h"
+
+class World;
+
+// Serves the chunks of a World to ChunkClients over TCP. Chunks are generated when first
+// asked for and sent run-length encoded; edits from any client are applied to the world
+// and passed on to every client that keeps the chunk they are in.
+// Everything happens on the thread that calls serve().
+class ChunkServer {
+public:
+	ChunkServer(World *world);
+	~ChunkServer();
+
+	bool listen(int port);
+	int getPort() const;
+	void serve(int ms);
+	int getClients() const;
+	uint64_t getChunksSent() const;
+	uint64_t getBytesSent() const;
+	uint64_t getEditsSent() const;
+
+private:
+	struct Client {
+		Connection connection;
+		// Chunk indices asked for and not sent yet, oldest first
+		std::deque<int> requests;
+		// Per chunk index: was it sent and not dropped since?
+		std::vector<bool> keeps;
+	};
+
+	void accept();
+	bool handle(Client *client, uint8_t type, const std::vector<uint8_t> &payload);
+	const std::vector<uint8_t> &encoded(int index);
+
+	World *_world;
+	socket_t _listener;
+	std::vector<Client *> _clients;
+	// Per chunk index: its CHUNK message payload, empty until needed and after edits
+	std::vector<std::vector<uint8_t> > _encoded;
+	std::atomic<uint64_t> _chunks, _bytes, _edits;
+};
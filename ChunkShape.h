@@ -0,0 +1,239 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "BlockRegistry.h"
+#include "ChunkLayout.h"
+
+// Dimensions of a chunk fixed at compile time, the vertex format that goes with them and
+// the mesher. Chunk uses ChunkShape<CHUNK::X, CHUNK::Y, CHUNK::Z>; other shapes can be
+// instantiated to compare them.
+template <int X, int Y, int Z>
+struct ChunkShape {
+	static_assert(X > 0 && Y > 0 && Z > 0, "a chunk needs blocks");
+	static_assert((X & (X - 1)) == 0 && (Y & (Y - 1)) == 0 && (Z & (Z - 1)) == 0,
+		"world coordinates are masked into chunks, so chunk sizes must be powers of two");
+
+	enum {
+		SIZE_X = X,
+		SIZE_Y = Y,
+		SIZE_Z = Z,
+		BLOCKS = X * Y * Z,
+		// Worst case vertex count of a mesh: six faces on every block, as a chunk full of
+		// clear blocks that keep the faces between them has
+		VERTICES = X * Y * Z * 36
+	};
+
+	// Vertex coordinates go up to X, Y and Z, so bigger chunks need wider vertices
+	typedef typename std::conditional<(X < 128 && Y < 128 && Z < 128), GLbyte, GLshort>::type Coordinate;
+	typedef glm::tvec4<Coordinate, glm::mediump> Vertex;
+	static_assert(X < (1 << (8 * sizeof(Coordinate) - 1)) && Y < (1 << (8 * sizeof(Coordinate) - 1)) && Z < (1 << (8 * sizeof(Coordinate) - 1)),
+		"chunk too large for its vertex coordinates");
+
+	// Builds the vertices of all visible faces into vertex, which must hold VERTICES.
+	// blocks.getBlock(x, y, z) gives the block at chunk-local coordinates, where one of
+	// them may be one step outside the chunk. The vertices come out bucketed by the
+	// direction their faces point in, in Orientation order: front (-z), back (+z), above,
+	// below, left (-x), right (+x); faces gets the vertex count of each bucket if given.
+	// Which faces are hidden and their tiles come from registry. Blocks are read in the
+	// order Layout stores them; returns the number of vertices written.
+	template <typename Layout = RowMajorLayout<X, Y, Z>, typename Blocks>
+	static int mesh(const Blocks &blocks, Vertex *vertex, int *faces = 0, const BlockRegistry &registry = BlockRegistry::get());
+
+	// A face packed into 32 bits for the vertex pulling shader, pullShader.vert, which
+	// expands it into the same six vertices mesh() writes: the block in bits 0-20, seven
+	// bits each of x, y and z, the Orientation it faces in bits 21-23 and its tile in
+	// bits 24-30.
+	typedef uint32_t Face;
+
+	static void pack(const Vertex *vertex, const int *faces, Face *face);
+	static Vertex unpack(Face face, int corner);
+};
+
+// Corners of a face in the order mesh() writes them, as steps along its two axes
+static const int FACE_CORNERS[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 1, 1 }, { 0, 1 }, { 0, 0 } };
+
+// Packs the mesh() output vertex, with faces vertices facing each Orientation, into one
+// Face each in face.
+template <int X, int Y, int Z>
+void ChunkShape<X, Y, Z>::pack(const Vertex *vertex, const int *faces, Face *face) {
+	static_assert(X <= 128 && Y <= 128 && Z <= 128, "chunk too large for packed faces");
+
+	for (int d = 0; d < 6; ++d) {
+		for (int i = 0; i < faces[d]; i += 6, vertex += 6) {
+			// The first corner is the one nearest the origin, on the far side of the block
+			// for back, top and right faces
+			int x = vertex->x - (d == 5), y = vertex->y - (d == 2), z = vertex->z - (d == 1);
+			*face++ = (Face)x | (Face)y << 7 | (Face)z << 14 | (Face)d << 21 | (Face)(vertex->w & 127) << 24;
+		}
+	}
+}
+
+// The vertex at corner 0 to 5 of a packed face, as pullShader.vert computes it.
+template <int X, int Y, int Z>
+typename ChunkShape<X, Y, Z>::Vertex ChunkShape<X, Y, Z>::unpack(Face face, int corner) {
+	int x = face & 127, y = face >> 7 & 127, z = face >> 14 & 127;
+	int d = face >> 21 & 7, tile = face >> 24 & 127;
+	int u = FACE_CORNERS[corner][0], v = FACE_CORNERS[corner][1];
+
+	if (d < 2)
+		return Vertex(x + u, y + v, z + d, tile);
+	if (d < 4)
+		return Vertex(x + u, y + (d == 2), z + v, (GLbyte)(tile + 128));
+	return Vertex(x + (d == 5), y + v, z + u, tile);
+}
+
+template <int X, int Y, int Z>
+template <typename Layout, typename Blocks>
+int ChunkShape<X, Y, Z>::mesh(const Blocks &blocks, Vertex *vertex, int *faces, const BlockRegistry &registry) {
+	// No direction can have more than a face per block, so each bucket is built in its
+	// own sixth of the buffer and they are moved together at the end
+	static const int SLOT = VERTICES / 6;
+	Vertex *bucket[6];
+	for (int d = 0; d < 6; ++d)
+		bucket[d] = vertex + d * SLOT;
+
+	const BlockTables tables = registry.getTables();
+
+	// The blocks with their neighbours around them, so each face is checked with a plain
+	// read rather than a getBlock that tests bounds
+	static const int PX = (Y + 2) * (Z + 2), PY = Z + 2;
+	std::vector<uint8_t> padded((X + 2) * PX);
+	uint8_t *at = &padded[PX + PY + 1];
+	for (int i = 0; i < BLOCKS; ++i) {
+		int x, y, z;
+		Layout::position(i, &x, &y, &z);
+		at[x * PX + y * PY + z] = blocks.getBlock(x, y, z);
+	}
+	for (int y = 0; y < Y; ++y) {
+		for (int z = 0; z < Z; ++z) {
+			at[-PX + y * PY + z] = blocks.getBlock(-1, y, z);
+			at[X * PX + y * PY + z] = blocks.getBlock(X, y, z);
+		}
+	}
+	for (int x = 0; x < X; ++x) {
+		for (int z = 0; z < Z; ++z) {
+			at[x * PX - PY + z] = blocks.getBlock(x, -1, z);
+			at[x * PX + Y * PY + z] = blocks.getBlock(x, Y, z);
+		}
+	}
+	for (int x = 0; x < X; ++x) {
+		for (int y = 0; y < Y; ++y) {
+			at[x * PX + y * PY - 1] = blocks.getBlock(x, y, -1);
+			at[x * PX + y * PY + Z] = blocks.getBlock(x, y, Z);
+		}
+	}
+
+	for (int x = 0; x < X; ++x) {
+		for (int y = 0; y < Y; ++y) {
+			for (int z = 0; z < Z; ++z) {
+				const uint8_t *p = at + x * PX + y * PY + z;
+				BlockId block = *p;
+				if (block != 0) {
+					// Looked up before any vertex is written, as those writes could alias the
+					// tables and force them to be read again
+					bool front = !tables.hides(block, p[-1]), back = !tables.hides(block, p[1]);
+					bool left = !tables.hides(block, p[-PX]), right = !tables.hides(block, p[PX]);
+					bool bottom = !tables.hides(block, p[-PY]), top = !tables.hides(block, p[PY]);
+
+					//Check X min boundaries, add front faces
+					if (front) {
+						Coordinate tile = tables.getTile(block, 0);
+						Vertex *v = bucket[0];
+						v[0] = Vertex(x, y, z, tile);
+						v[1] = Vertex(x + 1, y, z, tile);
+						v[2] = Vertex(x + 1, y + 1, z, tile);
+						v[3] = Vertex(x + 1, y + 1, z, tile);
+						v[4] = Vertex(x, y + 1, z, tile);
+						v[5] = Vertex(x, y, z, tile);
+						bucket[0] += 6;
+					}
+
+					//Check X max boundaries, add back faces
+					if (back) {
+						Coordinate tile = tables.getTile(block, 1);
+						Vertex *v = bucket[1];
+						v[0] = Vertex(x, y, z + 1, tile);
+						v[1] = Vertex(x + 1, y, z + 1, tile);
+						v[2] = Vertex(x + 1, y + 1, z + 1, tile);
+						v[3] = Vertex(x + 1, y + 1, z + 1, tile);
+						v[4] = Vertex(x, y + 1, z + 1, tile);
+						v[5] = Vertex(x, y, z + 1, tile);
+						bucket[1] += 6;
+					}
+
+					//Check Z min boundaries, add left faces
+					if (left) {
+						Coordinate tile = tables.getTile(block, 4);
+						Vertex *v = bucket[4];
+						v[0] = Vertex(x, y, z, tile);
+						v[1] = Vertex(x, y, z + 1, tile);
+						v[2] = Vertex(x, y + 1, z + 1, tile);
+						v[3] = Vertex(x, y + 1, z + 1, tile);
+						v[4] = Vertex(x, y + 1, z, tile);
+						v[5] = Vertex(x, y, z, tile);
+						bucket[4] += 6;
+					}
+
+					//Check Z max boundaries, add right faces
+					if (right) {
+						Coordinate tile = tables.getTile(block, 5);
+						Vertex *v = bucket[5];
+						v[0] = Vertex(x + 1, y, z, tile);
+						v[1] = Vertex(x + 1, y, z + 1, tile);
+						v[2] = Vertex(x + 1, y + 1, z + 1, tile);
+						v[3] = Vertex(x + 1, y + 1, z + 1, tile);
+						v[4] = Vertex(x + 1, y + 1, z, tile);
+						v[5] = Vertex(x + 1, y, z, tile);
+						bucket[5] += 6;
+					}
+
+					//Check Y min boundaries, add bottom faces
+					if (bottom) {
+						// Top and bottom faces are told apart by the sign of w
+						Coordinate flat = (GLbyte)(tables.getTile(block, 3) + 128);
+						Vertex *v = bucket[3];
+						v[0] = Vertex(x, y, z, flat);
+						v[1] = Vertex(x + 1, y, z, flat);
+						v[2] = Vertex(x + 1, y, z + 1, flat);
+						v[3] = Vertex(x + 1, y, z + 1, flat);
+						v[4] = Vertex(x, y, z + 1, flat);
+						v[5] = Vertex(x, y, z, flat);
+						bucket[3] += 6;
+					}
+
+					//Check Y max boundaries, add top faces
+					if (top) {
+						// Top and bottom faces are told apart by the sign of w
+						Coordinate flat = (GLbyte)(tables.getTile(block, 2) + 128);
+						Vertex *v = bucket[2];
+						v[0] = Vertex(x, y + 1, z, flat);
+						v[1] = Vertex(x + 1, y + 1, z, flat);
+						v[2] = Vertex(x + 1, y + 1, z + 1, flat);
+						v[3] = Vertex(x + 1, y + 1, z + 1, flat);
+						v[4] = Vertex(x, y + 1, z + 1, flat);
+						v[5] = Vertex(x, y + 1, z, flat);
+						bucket[2] += 6;
+					}
+				}
+			}
+		}
+	}
+
+	// Close the gaps between the buckets
+	int i = 0;
+	for (int d = 0; d < 6; ++d) {
+		int count = (int)(bucket[d] - (vertex + d * SLOT));
+		memmove(vertex + i, vertex + d * SLOT, count * sizeof(Vertex));
+		if (faces)
+			faces[d] = count;
+		i += count;
+	}
+
+	return i;
+}
@@ -8,23 +8,29 @@ namespace WINDOW {
 	static const int HEIGHT = 768;
 }
 
+// Locations in the program chunks are drawn with, set in main.cpp
 namespace PROGRAM {
-	static GLint attribute_coord;
-	static GLint uniform_mvp;
+	extern GLint attribute_coord;
+	extern GLint uniform_mvp;
 }
 
 namespace BLOCK {
-	static const int TRANSPARENCY[16] = { 2, 0, 0, 0, 1, 0, 0, 0, 3, 4, 0, 0, 0, 0, 0, 0 };
-	static const char *NAMES[16] = {
-		"air", "dirt", "topsoil", "grass", "leaves", "wood", "stone", "sand",
-		"water", "glass", "brick", "ore", "woodrings", "white", "black", "x-y"
-	};
+	// Block types are described in BlockRegistry; these are the ones code refers to
+	static const int AIR = 0;
+	static const int SAND = 7;
+	static const int WATER = 8;
 }
 
 namespace CHUNK {
 	static const int X = 16;
 	static const int Y = 16;
 	static const int Z = 16;
+	// Worst case vertex count of a chunk mesh: six faces on every block
+	static const int VERTICES = X * Y * Z * 36;
+	// Far chunks that differ from generation in at most this many blocks keep only those
+	static const int MAX_DIFF = 512;
+	// Store blocks in Z-order instead of row-major; see ChunkLayout.h
+	static const bool MORTON = false;
 }
 
 namespace WORLD {
@@ -32,4 +38,122 @@ namespace WORLD {
 	static const int X = 8;
 	static const int Y = 8;
 	static const int Z = 8;
+	// Height reported for columns without any blocks, one below the bottom of the world
+	static const int NO_SURFACE = -CHUNK::Y * (Y / 2) - 1;
+	// Chunks further than this many chunks from the camera, and not changed in the last
+	// HOT_FRAMES frames, are run-length encoded instead of held as a dense array; 0 keeps
+	// everything dense.
+	static const int COMPACT_DISTANCE = 3;
+	static const int HOT_FRAMES = 300;
+	// Beyond this many chunks they are stored as generation plus the blocks that differ
+	// from it, or failing that as a sparse voxel DAG
+	static const int FAR_DISTANCE = 5;
+	// Chunks converted between storage forms per frame
+	static const int COMPACT_BUDGET = 8;
+}
+
+namespace MEMORY {
+	// Limits on chunk memory in megabytes, for voxels and meshes together and for each;
+	// 0 is no limit
+	static const int TOTAL_MB = 0;
+	static const int MESHES_MB = 0;
+	static const int VOXELS_MB = 0;
+	// Chunks drawn or edited within this many frames are never evicted
+	static const int KEEP_FRAMES = 60;
+	// Chunks evicted per frame
+	static const int EVICTIONS = 16;
+}
+
+namespace MESH_CACHE {
+	// Bumped whenever the mesher's output changes, which invalidates cached meshes
+	static const int VERSION = 1;
+	// Size the cache file is kept under, in megabytes
+	static const int MAX_MB = 64;
+	// Meshes not used in this many sessions are dropped when the file is compacted
+	static const int MAX_AGE = 8;
+	// Threads reading meshes ahead, and the reads each takes from the queue at once
+	static const int IO_THREADS = 2;
+	static const int IO_BATCH = 8;
+	// Meshes read ahead that are kept; past that those asked for longest ago are dropped
+	static const int READY = 256;
+	// Chunks whose meshes are read ahead per frame, and how many seconds ahead along its
+	// velocity the camera is looked for
+	static const int PREFETCH = 64;
+	static const float LOOKAHEAD = 1.0f;
+	// Points along the way there the view is checked from, and how many screen widths it
+	// is widened by on each side for the camera turning
+	static const int STEPS = 4;
+	static const float MARGIN = 0.25f;
+}
+
+namespace TICK {
+	// Block updates run at a fixed rate, independent of the frame rate.
+	static const int RATE = 20;
+	// Ticks to catch up on in one frame before dropping the backlog.
+	static const int MAX_STEPS = 4;
+	static const int WATER_DELAY = 5;
+	static const int SAND_DELAY = 2;
+	// Flowing water stops this many blocks away from its source.
+	static const int WATER_SPREAD = 7;
+}
+
+namespace PHYSICS {
+	static const float GRAVITY = 20.0f;
+	static const float MAX_SPEED = 50.0f;
+	// Gap kept between a box and the block it stopped against
+	static const float SKIN = 0.001f;
+	// Cell size of the spatial hash used to find neighbouring entities,
+	// at least as large as the largest entity
+	static const float CELL = 2.0f;
+	// Entities per task handed to the thread pool
+	static const int BATCH = 512;
+}
+
+namespace JOURNAL {
+	// How long the journal writer waits for more edits to share one disk sync
+	static const int COMMIT_MS = 5;
+	// Edits that end the wait early
+	static const int BATCH = 4096;
+	// Edits after which the journal is folded into chunk snapshots
+	static const int COMPACT_EDITS = 100000;
+}
+
+namespace NET {
+	// Port the world server listens on unless told otherwise
+	static const int PORT = 25570;
+	// Chunks sent to one client per server round, so no client starves the others
+	static const int BATCH = 16;
+	// Largest payload either side accepts; a chunk run-length encodes to at most 12 + 2
+	// bytes per block. Longer ones drop the connection.
+	static const int MAX_MESSAGE = 16384;
+	// Input buffered before a connection stops reading from the socket until it is drained
+	static const int MAX_INPUT = 64 * MAX_MESSAGE;
+}
+
+namespace GOVERNOR {
+	// Frame time the governor aims for, in milliseconds
+	static const double TARGET_MS = 1000.0 / 60;
+	// Frames averaged between two adjustments
+	static const int FRAMES = 8;
+	// Budgets are cut when frames take more than this share of the target, and raised
+	// again when they take less than LOW
+	static const double HIGH = 0.9;
+	static const double LOW = 0.6;
+	// Time left unslept at the end of a frame, for the wake-up to be late
+	static const double SLACK_MS = 1.0;
+	static const float MIN_DISTANCE = 2.0f * CHUNK::X;
+	static const float MAX_DISTANCE = 2.0f * CHUNK::X * WORLD::X;
+	static const int MAX_GENERATE = 8;
+	static const int MIN_MESH = 2;
+	static const int MAX_MESH = 64;
+}
+
+namespace LOAD {
+	// Chunks within this many blocks of the camera are loaded, if the render budget's view
+	// distance isn't shorter
+	static const float RADIUS = 4.0f * CHUNK::X;
+	// Load priority: a chunk right behind the camera counts as 1 + BEHIND times as far
+	// away, one the camera is moving straight towards as 1 - AHEAD times
+	static const float BEHIND = 1.0f;
+	static const float AHEAD = 0.3f;
 }
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "EditJournal.h"
+#include "World.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Journal segment: "VXJ1", int64 seed, then Records until the end of the file.
+// World file: "VXW2", int64 seed, uint32 first journal segment after the snapshots,
+// uint32 chunk count, then per chunk int32 index, uint32 block count, per block uint16
+// index and uint8 type, and a uint32 checksum of it all.
+static const char JOURNAL_MAGIC[4] = { 'V', 'X', 'J', '1' };
+static const char WORLD_MAGIC[4] = { 'V', 'X', 'W', '2' };
+static const int BLOCKS = CHUNK::X * CHUNK::Y * CHUNK::Z;
+
+static uint32_t checksum(const void *data, size_t length, uint32_t h = 2166136261u) {
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < length; ++i)
+		h = (h ^ bytes[i]) * 16777619u;
+	return h;
+}
+
+// Pushes everything written to file through to the disk.
+static void sync(FILE *file) {
+	fflush(file);
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+}
+
+static bool exists(const std::string &filename) {
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (file)
+		fclose(file);
+	return file != 0;
+}
+
+// Grid index of the chunk holding world block (x, y, z), -1 outside the world.
+static int chunk_index(int x, int y, int z) {
+	x += CHUNK::X * (WORLD::X / 2);
+	y += CHUNK::Y * (WORLD::Y / 2);
+	z += CHUNK::Z * (WORLD::Z / 2);
+
+	if ((unsigned)x >= (unsigned)(WORLD::X * CHUNK::X) || (unsigned)y >= (unsigned)(WORLD::Y * CHUNK::Y) || (unsigned)z >= (unsigned)(WORLD::Z * CHUNK::Z))
+		return -1;
+
+	return (x / CHUNK::X * WORLD::Y + y / CHUNK::Y) * WORLD::Z + z / CHUNK::Z;
+}
+
+EditJournal::EditJournal() : _seed(0), _file(0), _first(0), _segment(0), _sinceCompact(0),
+	_next(0), _rotateAt(0), _appended(0), _durable(0), _syncs(0), _quit(false), _compacting(false) {
+}
+
+EditJournal::~EditJournal() {
+	close();
+}
+
+// Opens the world saved under name, reading its snapshots and journal. The world's seed
+// is returned in seed; a new world is created with the seed passed in.
+bool EditJournal::open(const char *name, time_t *seed) {
+	close();
+	_name = name;
+	_seed = *seed;
+	_first = 0;
+	_snapshots.clear();
+	_loaded.clear();
+	_dirty.clear();
+
+	if (exists(_name + ".world") && !readSnapshots())
+		return false;
+
+	// Read every segment after the snapshots; new edits go into a fresh one
+	uint32_t segment = _first;
+	for (; exists(segmentName(segment)); ++segment)
+		if (!readSegment(segment))
+			return false;
+
+	*seed = _seed;
+	_quit = false;
+	_file = startSegment(segment);
+	if (!_file)
+		return false;
+	sync(_file);
+	_segment = segment;
+
+	_writer = std::thread(&EditJournal::writer, this);
+	return true;
+}
+
+// Lays the saved snapshots and journaled edits over the generated terrain of world.
+// Returns the number of journaled edits applied.
+int EditJournal::replay(World *world) {
+	for (std::map<int, Diff>::iterator i = _snapshots.begin(); i != _snapshots.end(); ++i) {
+		int cx = i->first / (WORLD::Y * WORLD::Z);
+		int cy = i->first / WORLD::Z % WORLD::Y;
+		int cz = i->first % WORLD::Z;
+		Chunk *chunk = world->getChunk(cx, cy, cz);
+		world->generate(chunk);
+
+		for (size_t j = 0; j < i->second.size(); ++j) {
+			int x = i->second[j].index / (CHUNK::Y * CHUNK::Z);
+			int y = i->second[j].index / CHUNK::Z % CHUNK::Y;
+			int z = i->second[j].index % CHUNK::Z;
+			uint8_t type = i->second[j].type;
+
+			chunk->setBlock(x, y, z, type);
+			world->updateHeight(chunk->getX() * CHUNK::X + x, chunk->getY() * CHUNK::Y + y, chunk->getZ() * CHUNK::Z + z, type);
+		}
+	}
+
+	for (size_t i = 0; i < _loaded.size(); ++i) {
+		const Record &r = _loaded[i];
+		int index = chunk_index(r.x, r.y, r.z);
+		if (index < 0)
+			continue;
+
+		world->generate(world->findChunk(r.x, r.y, r.z));
+		world->setBlock(r.x, r.y, r.z, r.type);
+		_dirty.insert(index);
+	}
+
+	int count = (int)_loaded.size();
+	_sinceCompact = count;
+	std::vector<Record>().swap(_loaded);
+	return count;
+}
+
+// Queues an edit for the writer thread. Returns at once; the edit is on disk a few
+// milliseconds later, or when flush() returns.
+void EditJournal::append(int x, int y, int z, uint8_t type) {
+	int index = chunk_index(x, y, z);
+	if (!_writer.joinable() || index < 0)
+		return;
+
+	Record r;
+	r.x = x;
+	r.y = y;
+	r.z = z;
+	r.type = type;
+	memset(r.pad, 0, sizeof(r.pad));
+	r.check = checksum(&r, offsetof(Record, check));
+
+	_dirty.insert(index);
+	++_sinceCompact;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pending.push_back(r);
+	++_appended;
+	if (_pending.size() == 1 || _pending.size() >= (size_t)JOURNAL::BATCH)
+		_wake.notify_one();
+}
+
+// Waits until every appended edit has been synced to disk.
+void EditJournal::flush() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_wake.notify_one();
+	_synced.wait(lock, [&] { return _durable == _appended || !_writer.joinable(); });
+}
+
+// Folds the journal into snapshots once enough edits have piled up.
+void EditJournal::update(const World *world) {
+	if (_sinceCompact >= JOURNAL::COMPACT_EDITS && !_compacting)
+		compact(world);
+}
+
+// Takes the chunks edited since the last compaction as they are now and starts a new
+// journal segment for the edits after. A background thread then works out the
+// snapshots, writes them and deletes the old segments. Dense chunks, the usual case,
+// are shared rather than copied, and nothing here waits for the disk.
+void EditJournal::compact(const World *world) {
+	if (!_writer.joinable() || _compacting)
+		return;
+	if (_compactor.joinable())
+		_compactor.join();
+
+	// Opened here so a failure leaves everything as it was; the writer syncs it
+	FILE *next = startSegment(_segment + 1);
+	if (!next)
+		return;
+
+	std::vector<Dirty> dirty(_dirty.size());
+	int n = 0;
+	for (std::set<int>::iterator i = _dirty.begin(); i != _dirty.end(); ++i, ++n) {
+		Chunk *chunk = world->getChunk(*i / (WORLD::Y * WORLD::Z), *i / WORLD::Z % WORLD::Y, *i % WORLD::Z);
+		Dirty &d = dirty[n];
+		d.index = *i;
+		d.x = chunk->getX();
+		d.y = chunk->getY();
+		d.z = chunk->getZ();
+		d.seed = chunk->getSeed();
+		d.generated = chunk->isNoised();
+		d.shared = chunk->shareBlocks();
+		d.procedural = false;
+		if (d.shared)
+			continue;
+
+		if (chunk->isProcedural()) {
+			d.procedural = true;
+			chunk->diff(d.diff);
+		} else {
+			d.blocks.resize(BLOCKS);
+			chunk->getBlocks(&d.blocks[0]);
+		}
+	}
+	_dirty.clear();
+	_sinceCompact = 0;
+
+	// Every edit appended so far is in the copies; only this thread appends
+	uint32_t first = _first;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_next = next;
+		_rotateAt = _appended;
+	}
+	_wake.notify_one();
+
+	_first = ++_segment;
+	_compacting = true;
+	_compactor = std::thread(&EditJournal::writeSnapshots, this, std::move(dirty), first, _segment);
+}
+
+// Syncs outstanding edits and stops the background threads.
+void EditJournal::close() {
+	if (_writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_wake.notify_one();
+		_writer.join();
+	}
+
+	if (_compactor.joinable())
+		_compactor.join();
+
+	if (_file)
+		fclose(_file);
+	_file = 0;
+}
+
+// Is a compaction still working out or writing snapshots?
+bool EditJournal::isCompacting() const {
+	return _compacting;
+}
+
+uint64_t EditJournal::getAppended() const {
+	return _appended;
+}
+
+// Number of disk syncs the writer has done; appended / syncs is the average batch.
+int EditJournal::getSyncs() const {
+	return _syncs;
+}
+
+std::string EditJournal::segmentName(uint32_t segment) const {
+	char suffix[32];
+	sprintf(suffix, ".journal.%u", segment);
+	return _name + suffix;
+}
+
+bool EditJournal::readSnapshots() {
+	std::string filename = _name + ".world";
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char magic[4];
+	int64_t seed;
+	uint32_t count;
+	if (fread(magic, 4, 1, file) != 1 || memcmp(magic, WORLD_MAGIC, 4) || fread(&seed, sizeof(seed), 1, file) != 1 ||
+		fread(&_first, sizeof(_first), 1, file) != 1 || fread(&count, sizeof(count), 1, file) != 1) {
+		fprintf(stderr, "%s: not a world file\n", filename.c_str());
+		fclose(file);
+		return false;
+	}
+	_seed = (time_t)seed;
+
+	// The file only replaces the old one once it is complete, so any damage is real
+	for (uint32_t i = 0; i < count; ++i) {
+		int32_t index;
+		uint32_t blocks, check;
+		std::vector<uint8_t> data;
+		bool ok = fread(&index, sizeof(index), 1, file) == 1 && fread(&blocks, sizeof(blocks), 1, file) == 1 && blocks <= (uint32_t)BLOCKS;
+		if (ok) {
+			data.resize(blocks * 3 + 1);
+			ok = fread(&data[0], 3, blocks, file) == blocks && fread(&check, sizeof(check), 1, file) == 1 &&
+				check == checksum(&data[0], blocks * 3, checksum(&blocks, sizeof(blocks), checksum(&index, sizeof(index)))) &&
+				index >= 0 && index < WORLD::X * WORLD::Y * WORLD::Z;
+		}
+		if (!ok) {
+			fprintf(stderr, "%s: chunk %u is damaged\n", filename.c_str(), i);
+			fclose(file);
+			return false;
+		}
+
+		Diff &diff = _snapshots[index];
+		diff.resize(blocks);
+		for (uint32_t j = 0; j < blocks; ++j) {
+			diff[j].index = data[j * 3] | data[j * 3 + 1] << 8;
+			diff[j].type = data[j * 3 + 2];
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Reads the edits of one segment. A crash can leave a partly written record at the end,
+// which ends the segment there.
+bool EditJournal::readSegment(uint32_t segment) {
+	std::string filename = segmentName(segment);
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char magic[4];
+	int64_t seed;
+	if (fread(magic, 4, 1, file) != 1 || memcmp(magic, JOURNAL_MAGIC, 4) || fread(&seed, sizeof(seed), 1, file) != 1) {
+		fprintf(stderr, "%s: not a journal file\n", filename.c_str());
+		fclose(file);
+		return false;
+	}
+	_seed = (time_t)seed;
+
+	Record r;
+	while (fread(&r, sizeof(r), 1, file) == 1) {
+		if (r.check != checksum(&r, offsetof(Record, check))) {
+			fprintf(stderr, "%s: ignoring damaged edits at the end\n", filename.c_str());
+			break;
+		}
+		_loaded.push_back(r);
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Creates a journal segment and writes its header, without syncing it.
+FILE *EditJournal::startSegment(uint32_t segment) {
+	std::string filename = segmentName(segment);
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "Error: could not write %s\n", filename.c_str());
+		return 0;
+	}
+
+	int64_t seed = _seed;
+	fwrite(JOURNAL_MAGIC, 4, 1, file);
+	fwrite(&seed, sizeof(seed), 1, file);
+	return file;
+}
+
+// Writer thread: takes everything appended so far, waiting up to JOURNAL::COMMIT_MS
+// for more to share the sync, writes it and syncs once for the whole batch. When
+// compact() has handed it a new segment, the edits made before that end the old
+// segment and the rest start the new one.
+void EditJournal::writer() {
+	std::vector<Record> batch;
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	for (;;) {
+		_wake.wait(lock, [&] { return _quit || _next || !_pending.empty(); });
+		if (_pending.empty() && !_next)
+			break;
+
+		if (!_quit && !_next)
+			_wake.wait_for(lock, std::chrono::milliseconds(JOURNAL::COMMIT_MS), [&] { return _quit || _pending.size() >= (size_t)JOURNAL::BATCH; });
+
+		batch.swap(_pending);
+		uint64_t appended = _appended;
+		FILE *next = _next;
+		size_t old = next ? (size_t)(_rotateAt - (appended - batch.size())) : batch.size();
+		lock.unlock();
+
+		if (old)
+			fwrite(&batch[0], sizeof(Record), old, _file);
+		sync(_file);
+		if (next) {
+			fclose(_file);
+			_file = next;
+			if (old < batch.size())
+				fwrite(&batch[old], sizeof(Record), batch.size() - old, _file);
+			sync(_file);
+		}
+		batch.clear();
+
+		lock.lock();
+		if (next)
+			_next = 0;
+		++_syncs;
+		_durable = appended;
+		_synced.notify_all();
+	}
+
+	_synced.notify_all();
+}
+
+// Compaction thread: diffs the copied chunks against generation, writes the snapshots
+// next to the world file and swaps it in, after which the journal segments from first
+// up to (not including) last are redundant.
+void EditJournal::writeSnapshots(std::vector<Dirty> dirty, uint32_t first, uint32_t last) {
+	std::vector<uint8_t> generated(BLOCKS);
+
+	// Chunks edited back to what generation gives drop out of the snapshots
+	for (size_t i = 0; i < dirty.size(); ++i) {
+		if (dirty[i].procedural) {
+			if (dirty[i].diff.empty())
+				_snapshots.erase(dirty[i].index);
+			else
+				_snapshots[dirty[i].index].swap(dirty[i].diff);
+			continue;
+		}
+
+		if (dirty[i].shared) {
+			dirty[i].blocks.resize(BLOCKS);
+			for (int x = 0; x < CHUNK::X; ++x)
+				for (int y = 0; y < CHUNK::Y; ++y)
+					for (int z = 0; z < CHUNK::Z; ++z)
+						dirty[i].blocks[(x * CHUNK::Y + y) * CHUNK::Z + z] = dirty[i].shared->block[ChunkLayout::index(x, y, z)];
+			Chunk::releaseBlocks(dirty[i].shared);
+		}
+
+		if (dirty[i].generated)
+			Chunk::generate(dirty[i].x, dirty[i].y, dirty[i].z, dirty[i].seed, &generated[0]);
+		else
+			std::fill(generated.begin(), generated.end(), 0);
+
+		Diff diff;
+		for (int b = 0; b < BLOCKS; ++b) {
+			if (dirty[i].blocks[b] != generated[b]) {
+				BlockDiff d = { (uint16_t)b, dirty[i].blocks[b] };
+				diff.push_back(d);
+			}
+		}
+
+		if (diff.empty())
+			_snapshots.erase(dirty[i].index);
+		else
+			_snapshots[dirty[i].index].swap(diff);
+	}
+
+	// The old segments may only go once the writer has moved on from them
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_synced.wait(lock, [&] { return !_next; });
+	}
+
+	std::string filename = _name + ".world";
+	std::string temporary = filename + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "wb");
+
+	if (file) {
+		int64_t seed = _seed;
+		uint32_t count = (uint32_t)_snapshots.size();
+		fwrite(WORLD_MAGIC, 4, 1, file);
+		fwrite(&seed, sizeof(seed), 1, file);
+		fwrite(&last, sizeof(last), 1, file);
+		fwrite(&count, sizeof(count), 1, file);
+
+		std::vector<uint8_t> data;
+		for (std::map<int, Diff>::iterator i = _snapshots.begin(); i != _snapshots.end(); ++i) {
+			int32_t index = i->first;
+			uint32_t blocks = (uint32_t)i->second.size();
+
+			data.resize(blocks * 3 + 1);
+			for (uint32_t j = 0; j < blocks; ++j) {
+				data[j * 3] = i->second[j].index & 0xff;
+				data[j * 3 + 1] = i->second[j].index >> 8;
+				data[j * 3 + 2] = i->second[j].type;
+			}
+
+			uint32_t check = checksum(&data[0], blocks * 3, checksum(&blocks, sizeof(blocks), checksum(&index, sizeof(index))));
+			fwrite(&index, sizeof(index), 1, file);
+			fwrite(&blocks, sizeof(blocks), 1, file);
+			fwrite(&data[0], 3, blocks, file);
+			fwrite(&check, sizeof(check), 1, file);
+		}
+
+		sync(file);
+		bool ok = !ferror(file);
+		fclose(file);
+
+		// Readers see either the old file or the complete new one
+#ifdef _WIN32
+		ok = ok && MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+		ok = ok && !rename(temporary.c_str(), filename.c_str());
+#endif
+		if (ok) {
+			for (uint32_t segment = first; segment < last; ++segment)
+				remove(segmentName(segment).c_str());
+		}
+		else {
+			fprintf(stderr, "Error: could not write %s\n", filename.c_str());
+		}
+	}
+	else {
+		fprintf(stderr, "Error: could not write %s\n", temporary.c_str());
+	}
+
+	_compacting = false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Constants.h"
+#include "Chunk.h"
+
+class World;
+
+// Crash-safe persistence of block edits. Edits go into an append-only journal of
+// checksummed records, which a background thread writes and syncs to disk in batches
+// (group commit). Every so often the journal is folded into snapshots of the edited
+// chunks, written in the background too: the calling thread only takes copy-on-write
+// references to the chunks and hands the writer a new segment, so a save doesn't stall
+// the frame. Terrain comes from the seed, so a snapshot only holds the blocks that
+// differ from generation.
+// Files: <name>.world holds the seed and the snapshots, <name>.journal.<n> the edits
+// made after them, one segment per session or compaction.
+class EditJournal {
+public:
+	EditJournal();
+	~EditJournal();
+
+	bool open(const char *name, time_t *seed);
+	int replay(World *world);
+	void append(int x, int y, int z, uint8_t type);
+	void flush();
+	void update(const World *world);
+	void compact(const World *world);
+	void close();
+	bool isCompacting() const;
+	uint64_t getAppended() const;
+	int getSyncs() const;
+
+private:
+	// One edit as stored on disk
+	struct Record {
+		int32_t x, y, z;
+		uint8_t type;
+		uint8_t pad[3];
+		uint32_t check;
+	};
+
+	typedef std::vector<BlockDiff> Diff;
+
+	// An edited chunk as it was when compaction started: its blocks shared with it if it
+	// is dense, its diff if it is procedural, and a copy of its blocks otherwise. The chunk
+	// itself may be gone by the time they are diffed, so what generation needs is copied.
+	struct Dirty {
+		int index;
+		int x, y, z, seed;
+		bool generated;
+		const ChunkBlocks *shared;
+		bool procedural;
+		Diff diff;
+		std::vector<uint8_t> blocks;
+	};
+
+	std::string segmentName(uint32_t segment) const;
+	bool readSnapshots();
+	bool readSegment(uint32_t segment);
+	FILE *startSegment(uint32_t segment);
+	void writer();
+	void writeSnapshots(std::vector<Dirty> dirty, uint32_t first, uint32_t last);
+
+	std::string _name;
+	time_t _seed;
+	// The segment being written, owned by the writer thread while it runs
+	FILE *_file;
+	uint32_t _first, _segment;
+	// Chunk index -> blocks differing from generation, the contents of the .world file.
+	// Owned by the compaction thread while it runs.
+	std::map<int, Diff> _snapshots;
+	// Edits read by open(), applied by replay()
+	std::vector<Record> _loaded;
+	// Chunks edited since the last compaction
+	std::set<int> _dirty;
+	int _sinceCompact;
+
+	std::thread _writer, _compactor;
+	std::mutex _mutex;
+	std::condition_variable _wake, _synced;
+	// Appended but not yet picked up by the writer
+	std::vector<Record> _pending;
+	// Segment for the writer to switch to once it has written the first _rotateAt edits
+	FILE *_next;
+	uint64_t _rotateAt;
+	uint64_t _appended, _durable;
+	int _syncs;
+	bool _quit;
+	std::atomic<bool> _compacting;
+};
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <string.h>
+
+#include "FrameGovernor.h"
+
+// Starts from the full view distance and a moderate meshing budget, and cuts from there.
+FrameGovernor::FrameGovernor(double target) : _target(target), _total(0), _frames(0) {
+	memset(&_stats, 0, sizeof(_stats));
+	_budget.distance = GOVERNOR::MAX_DISTANCE;
+	_budget.generate = 1;
+	_budget.mesh = GOVERNOR::MAX_MESH / 4;
+}
+
+// Takes the cost in milliseconds of the frame that just ended, the time spent working
+// and not sleeping, and adjusts the budget for the frames to come.
+void FrameGovernor::frame(double cost) {
+	_total += cost;
+	++_frames;
+
+	// A frame that blew the whole budget twice over is acted on at once
+	if (cost < 2 * _target && _frames < GOVERNOR::FRAMES)
+		return;
+
+	_stats.average = _total / _frames;
+	_total = 0;
+	_frames = 0;
+
+	if (_stats.average > _target * GOVERNOR::HIGH)
+		cut();
+	else if (_stats.average < _target * GOVERNOR::LOW)
+		raise();
+}
+
+void FrameGovernor::cut() {
+	if (_budget.generate > 1)
+		_budget.generate /= 2;
+	else if (_budget.mesh > GOVERNOR::MIN_MESH)
+		_budget.mesh = std::max(GOVERNOR::MIN_MESH, _budget.mesh / 2);
+	else if (_budget.distance > GOVERNOR::MIN_DISTANCE)
+		_budget.distance = std::max(GOVERNOR::MIN_DISTANCE, _budget.distance * 0.8f);
+	else
+		return;
+
+	++_stats.cuts;
+}
+
+void FrameGovernor::raise() {
+	if (_budget.distance < GOVERNOR::MAX_DISTANCE)
+		_budget.distance = std::min(GOVERNOR::MAX_DISTANCE, _budget.distance * 1.1f);
+	else if (_budget.mesh < GOVERNOR::MAX_MESH)
+		_budget.mesh = std::min(GOVERNOR::MAX_MESH, _budget.mesh * 2);
+	else if (_budget.generate < GOVERNOR::MAX_GENERATE)
+		++_budget.generate;
+	else
+		return;
+
+	++_stats.raises;
+}
+
+const RenderBudget &FrameGovernor::getBudget() const {
+	return _budget;
+}
+
+// Time in milliseconds to sleep before starting the next frame, given that elapsed
+// milliseconds of this one are gone, including any wait for the buffer swap.
+// 0 when there is none to spare.
+double FrameGovernor::sleep(double elapsed) {
+	_stats.sleep = std::max(0.0, _target - elapsed - GOVERNOR::SLACK_MS);
+	return _stats.sleep;
+}
+
+double FrameGovernor::getTarget() const {
+	return _target;
+}
+
+const GovernorStats &FrameGovernor::getStats() const {
+	return _stats;
+}
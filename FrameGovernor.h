@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Constants.h"
+#include "World.h"
+
+// What the governor decided after the last frame.
+struct GovernorStats {
+	// Average cost of the frames since the last adjustment, in milliseconds
+	double average;
+	// Time slept before the next frame
+	double sleep;
+	// Adjustments that cut or raised the budget so far
+	int cuts, raises;
+};
+
+// Holds frames to a target time. When frames run long it cuts the render budget, first
+// how much generation and meshing a frame may do, then view distance; when they run short
+// it gives that back in reverse order, and sleeps off whatever time is left over.
+class FrameGovernor {
+public:
+	FrameGovernor(double target = GOVERNOR::TARGET_MS);
+
+	void frame(double cost);
+	const RenderBudget &getBudget() const;
+	double sleep(double elapsed);
+	double getTarget() const;
+	const GovernorStats &getStats() const;
+
+private:
+	void cut();
+	void raise();
+
+	double _target;
+	RenderBudget _budget;
+	GovernorStats _stats;
+	double _total;
+	int _frames;
+};
@@ -0,0 +1,147 @@
+#include <string.h>
+#include <algorithm>
+
+#include "IoRing.h"
+
+#if defined(__linux__) && defined(__has_include) && !defined(NO_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+IoRing::IoRing() : _ring(-1), _file(-1), _entries(0), _rings(0), _sqes(0), _ringsSize(0), _sqesSize(0),
+	_sqTail(0), _sqMask(0), _sqArray(0), _cqHead(0), _cqTail(0), _cqMask(0), _cqes(0) {
+}
+
+IoRing::~IoRing() {
+	close();
+}
+
+// Opens filename for reading through a ring taking up to entries reads at once. Returns
+// false if that isn't possible here.
+bool IoRing::open(const char *filename, unsigned entries) {
+	close();
+#ifdef HAVE_IO_URING
+	_file = ::open(filename, O_RDONLY | O_CLOEXEC);
+	if (_file < 0)
+		return false;
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	_ring = (int)syscall(__NR_io_uring_setup, entries, &params);
+	// Kernels that map the two queues separately are older than IORING_OP_READ anyway
+	if (_ring < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+		close();
+		return false;
+	}
+
+	_ringsSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_ringsSize = std::max(_ringsSize, (size_t)(params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)));
+	_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	_rings = mmap(0, _ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, IORING_OFF_SQ_RING);
+	_sqes = mmap(0, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, IORING_OFF_SQES);
+	if (_rings == MAP_FAILED || _sqes == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	char *rings = (char *)_rings;
+	_sqTail = (unsigned *)(rings + params.sq_off.tail);
+	_sqMask = (unsigned *)(rings + params.sq_off.ring_mask);
+	_sqArray = (unsigned *)(rings + params.sq_off.array);
+	_cqHead = (unsigned *)(rings + params.cq_off.head);
+	_cqTail = (unsigned *)(rings + params.cq_off.tail);
+	_cqMask = (unsigned *)(rings + params.cq_off.ring_mask);
+	_cqes = rings + params.cq_off.cqes;
+	_entries = params.sq_entries;
+	return true;
+#else
+	(void)filename;
+	(void)entries;
+	return false;
+#endif
+}
+
+void IoRing::close() {
+#ifdef HAVE_IO_URING
+	if (_rings && _rings != MAP_FAILED)
+		munmap(_rings, _ringsSize);
+	if (_sqes && _sqes != MAP_FAILED)
+		munmap(_sqes, _sqesSize);
+	if (_ring >= 0)
+		::close(_ring);
+	if (_file >= 0)
+		::close(_file);
+#endif
+	_ring = _file = -1;
+	_rings = _sqes = 0;
+	_entries = 0;
+}
+
+bool IoRing::isOpen() const {
+	return _entries > 0;
+}
+
+// Reads at most getEntries() at once
+unsigned IoRing::getEntries() const {
+	return _entries;
+}
+
+// Queues count reads, submits them together and waits for all of them, setting each
+// one's result. Returns false if the ring itself failed, which closes it; the results are
+// unset then.
+bool IoRing::readAll(IoRead *reads, int count) {
+	if (!isOpen() || count <= 0 || (unsigned)count > _entries)
+		return false;
+#ifdef HAVE_IO_URING
+	// Every read of the last call completed, so the queue is empty
+	unsigned tail = *_sqTail;
+	for (int i = 0; i < count; ++i, ++tail) {
+		unsigned slot = tail & *_sqMask;
+		io_uring_sqe *sqe = (io_uring_sqe *)_sqes + slot;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = _file;
+		sqe->addr = (uint64_t)(uintptr_t)reads[i].buffer;
+		sqe->len = reads[i].bytes;
+		sqe->off = reads[i].offset;
+		sqe->user_data = (uint64_t)i;
+		_sqArray[slot] = slot;
+	}
+	__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+	unsigned submit = (unsigned)count;
+	for (int done = 0; done < count;) {
+		int entered = (int)syscall(__NR_io_uring_enter, _ring, submit, 1, IORING_ENTER_GETEVENTS, 0, 0);
+		// EINTR only means a signal cut the wait short; anything else leaves the ring unusable
+		if (entered < 0 && errno != EINTR) {
+			close();
+			return false;
+		}
+		if (entered > 0)
+			submit -= std::min(submit, (unsigned)entered);
+
+		unsigned head = *_cqHead;
+		unsigned ready = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+		for (; head != ready; ++head, ++done) {
+			const io_uring_cqe *cqe = (const io_uring_cqe *)_cqes + (head & *_cqMask);
+			if (cqe->user_data < (uint64_t)count)
+				reads[cqe->user_data].result = cqe->res;
+		}
+		__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+	}
+	return true;
+#else
+	(void)reads;
+	return false;
+#endif
+}
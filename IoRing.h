@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One read for IoRing::readAll: bytes from offset into buffer. result is set to the
+// bytes read, or a negative errno.
+struct IoRead {
+	void *buffer;
+	unsigned bytes;
+	uint64_t offset;
+	int result;
+};
+
+// Reads a file through a Linux io_uring, so a batch of reads takes one system call to
+// submit and wait for instead of a seek and a read each. Built only on Linux with the
+// io_uring header, unless NO_IO_URING is defined; elsewhere, or where the kernel refuses
+// a ring, open fails and the caller reads with stdio instead. Each thread needs its own
+// instance.
+class IoRing {
+public:
+	IoRing();
+	~IoRing();
+
+	bool open(const char *filename, unsigned entries);
+	void close();
+	bool isOpen() const;
+	bool readAll(IoRead *reads, int count);
+	unsigned getEntries() const;
+
+private:
+	int _ring, _file;
+	unsigned _entries;
+	// The ring mappings, and where in them the kernel put the queues' fields
+	void *_rings, *_sqes;
+	size_t _ringsSize, _sqesSize;
+	unsigned *_sqTail, *_sqMask, *_sqArray;
+	unsigned *_cqHead, *_cqTail, *_cqMask;
+	void *_cqes;
+};
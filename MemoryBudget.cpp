@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <string.h>
+
+#include "MemoryBudget.h"
+#include "Chunk.h"
+
+using namespace glm;
+
+MemoryBudget::MemoryBudget() : _frame(0) {
+	memset(&_stats, 0, sizeof(_stats));
+	_used.assign(WORLD::X * WORLD::Y * WORLD::Z, 0);
+}
+
+void MemoryBudget::setLimits(const MemoryLimits &limits) {
+	_limits = limits;
+}
+
+const MemoryLimits &MemoryBudget::getLimits() const {
+	return _limits;
+}
+
+// Marks the chunk at index (cx * WORLD::Y + cy) * WORLD::Z + cz as drawn or edited now.
+void MemoryBudget::use(int chunk) {
+	if (chunk >= (int)_used.size())
+		_used.resize(chunk + 1, 0);
+	_used[chunk] = _frame;
+}
+
+// Accounts the memory of count chunks, by index, and evicts from those that weren't used
+// lately until it is within the limits or the per-update allowance is spent. Chunks
+// within keepDistance blocks of eye may lose their mesh but keep their voxels. scratch is
+// the CPU buffer meshes are built in, reported but not evicted.
+void MemoryBudget::update(Chunk *const *chunks, int count, const vec3 &eye, float keepDistance, size_t scratch) {
+	if (count > (int)_used.size())
+		_used.resize(count, 0);
+	++_frame;
+
+	_stats.voxels = _stats.meshes = 0;
+	_stats.voxelChunks = _stats.meshChunks = 0;
+	_stats.meshEvictions = _stats.voxelEvictions = 0;
+	_stats.scratch = scratch;
+
+	std::vector<Candidate> candidates;
+	std::vector<float> distances(count);
+	for (int i = 0; i < count; ++i) {
+		Chunk *chunk = chunks[i];
+		size_t voxels = chunk->getBytes(), mesh = chunk->getMeshBytes();
+		_stats.voxels += voxels;
+		_stats.meshes += mesh;
+		_stats.voxelChunks += voxels > 0;
+		_stats.meshChunks += mesh > 0;
+
+		vec3 center = (vec3(chunk->getX(), chunk->getY(), chunk->getZ()) + 0.5f) * vec3(CHUNK::X, CHUNK::Y, CHUNK::Z);
+		distances[i] = length(center - eye);
+		if ((voxels || mesh) && _frame - _used[i] > (uint32_t)_limits.keepFrames) {
+			Candidate candidate = { _limits.order == EVICT_LRU ? (double)_used[i] : -distances[i], i };
+			candidates.push_back(candidate);
+		}
+	}
+
+	// Least recently used or furthest first; ties keep index order
+	std::stable_sort(candidates.begin(), candidates.end());
+	int evictions = _limits.evictions;
+
+	// Meshes first, as rebuilding one costs a meshing and no generation
+	for (size_t c = 0; c < candidates.size() && evictions > 0 && (overTotal() || overMeshes()); ++c) {
+		Chunk *chunk = chunks[candidates[c].index];
+		size_t mesh = chunk->getMeshBytes();
+		if (!mesh)
+			continue;
+
+		chunk->dropMesh();
+		_stats.meshes -= mesh;
+		--_stats.meshChunks;
+		++_stats.meshEvictions;
+		--evictions;
+	}
+
+	for (size_t c = 0; c < candidates.size() && evictions > 0 && (overTotal() || overVoxels()); ++c) {
+		Chunk *chunk = chunks[candidates[c].index];
+		size_t voxels = chunk->getBytes();
+		if (!voxels || distances[candidates[c].index] <= keepDistance || !chunk->evictBlocks())
+			continue;
+
+		size_t left = chunk->getBytes();
+		_stats.voxels -= voxels - std::min(voxels, left);
+		_stats.voxelChunks -= left == 0;
+		++_stats.voxelEvictions;
+		--evictions;
+	}
+
+	_stats.meshEvicted += _stats.meshEvictions;
+	_stats.voxelEvicted += _stats.voxelEvictions;
+	_stats.over = overTotal() || overMeshes() || overVoxels();
+}
+
+const MemoryStats &MemoryBudget::getStats() const {
+	return _stats;
+}
+
+bool MemoryBudget::overTotal() const {
+	return _limits.total && _stats.voxels + _stats.meshes > _limits.total;
+}
+
+bool MemoryBudget::overMeshes() const {
+	return _limits.meshes && _stats.meshes > _limits.meshes;
+}
+
+bool MemoryBudget::overVoxels() const {
+	return _limits.voxels && _stats.voxels > _limits.voxels;
+}
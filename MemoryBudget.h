@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Constants.h"
+
+class Chunk;
+
+// Which chunks MemoryBudget evicts first, within meshes and within voxels
+enum EvictionOrder {
+	// Longest since they were drawn or edited
+	EVICT_LRU,
+	// Furthest from the camera
+	EVICT_DISTANCE
+};
+
+// Limits on the memory chunks hold, in bytes, 0 for none. The defaults come from MEMORY.
+struct MemoryLimits {
+	// Voxels and meshes together
+	size_t total;
+	size_t meshes;
+	size_t voxels;
+	// Chunks used within this many updates are never evicted
+	int keepFrames;
+	// Chunks evicted per update
+	int evictions;
+	EvictionOrder order;
+
+	MemoryLimits() : total((size_t)MEMORY::TOTAL_MB << 20), meshes((size_t)MEMORY::MESHES_MB << 20),
+		voxels((size_t)MEMORY::VOXELS_MB << 20), keepFrames(MEMORY::KEEP_FRAMES), evictions(MEMORY::EVICTIONS), order(EVICT_LRU) {}
+};
+
+// Memory held after the last MemoryBudget::update and what it evicted.
+struct MemoryStats {
+	// Bytes of blocks, of meshes on the GPU, and of the CPU buffer meshes are built in
+	// before upload, which all chunks share
+	size_t voxels, meshes, scratch;
+	// Chunks holding voxels or a mesh
+	int voxelChunks, meshChunks;
+	// Evicted by the last update, and in all
+	int meshEvictions, voxelEvictions;
+	uint64_t meshEvicted, voxelEvicted;
+	// Still over a limit after the last update
+	bool over;
+};
+
+// Keeps the memory of the world's chunks within MemoryLimits. Every update accounts the
+// voxel and mesh bytes of each chunk and, under pressure, evicts meshes first, as they
+// are rebuilt from the voxels when next drawn, then voxels, which are rebuilt from the
+// seed: a chunk keeps only the blocks that differ from generation, or if there are too
+// many of those, their runs. Chunks recently used are left alone.
+class MemoryBudget {
+public:
+	MemoryBudget();
+
+	void setLimits(const MemoryLimits &limits);
+	const MemoryLimits &getLimits() const;
+	void use(int chunk);
+	void update(Chunk *const *chunks, int count, const glm::vec3 &eye, float keepDistance, size_t scratch);
+	const MemoryStats &getStats() const;
+
+private:
+	bool overTotal() const;
+	bool overMeshes() const;
+	bool overVoxels() const;
+
+	struct Candidate {
+		double key;
+		int index;
+
+		bool operator<(const Candidate &other) const {
+			return key < other.key;
+		}
+	};
+
+	MemoryLimits _limits;
+	MemoryStats _stats;
+	uint32_t _frame;
+	// Per chunk index: the update it was last used before
+	std::vector<uint32_t> _used;
+};
@@ -0,0 +1,552 @@
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "MeshCache.h"
+#include "BlockRegistry.h"
+#include "IoRing.h"
+#include "Timer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static const char CACHE_MAGIC[4] = { 'V', 'X', 'M', '1' };
+static const long HEADER = 16;
+static const uint32_t TOUCH = 0xffffffffu;
+
+static uint32_t checksum(const void *data, size_t length, uint32_t h = 2166136261u) {
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < length; ++i)
+		h = (h ^ bytes[i]) * 16777619u;
+	return h;
+}
+
+// Vertices are checked a word at a time, as every hit reads them back
+static uint32_t checksum_words(const void *data, size_t words) {
+	uint32_t h = 2166136261u;
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < words; ++i) {
+		uint32_t word;
+		memcpy(&word, bytes + i * 4, 4);
+		h = (h ^ word) * 16777619u;
+	}
+	return h;
+}
+
+static const long RECORD = 48;
+
+// Bytes a record takes in the file with count vertices after it
+static long record_size(uint32_t count) {
+	return RECORD + (long)((count * sizeof(byte4) + 15) & ~(size_t)15);
+}
+
+MeshCache::MeshCache() : _file(0), _limit(0), _session(0), _end(HEADER), _used(0), _hits(0), _misses(0), _stamp(0), _readable(HEADER), _quit(false) {
+	memset(&_prefetch, 0, sizeof(_prefetch));
+	static_assert(sizeof(Record) == RECORD, "records keep the vertices after them 16-byte aligned");
+}
+
+MeshCache::~MeshCache() {
+	close();
+}
+
+// Opens the cache in filename, creating it if needed, to be kept under limit bytes, and
+// starts a new session in it. A damaged file or one from another mesher version is
+// started over. Returns false if the file can't be written.
+bool MeshCache::open(const char *filename, size_t limit) {
+	close();
+	_filename = filename;
+	_limit = limit;
+	_entries.clear();
+	_session = 0;
+	_end = HEADER;
+	_used = 0;
+	_hits = _misses = 0;
+	memset(&_prefetch, 0, sizeof(_prefetch));
+
+	_file = fopen(filename, "r+b");
+	if (_file && !read()) {
+		fclose(_file);
+		_file = 0;
+		_entries.clear();
+		_session = 0;
+		_end = HEADER;
+		_used = 0;
+	}
+	if (!_file)
+		_file = fopen(filename, "w+b");
+
+	++_session;
+	if (!_file || !writeHeader()) {
+		fprintf(stderr, "Error: could not open mesh cache %s\n", filename);
+		close();
+		return false;
+	}
+
+	if ((size_t)_end > _limit || (size_t)_end - HEADER > 2 * _used)
+		compact();
+	if (_file)
+		fflush(_file);
+	_readable = _end;
+	startReaders();
+	return true;
+}
+
+// Makes room for the next session, then closes the file.
+void MeshCache::close() {
+	stopReaders();
+	if (!_file)
+		return;
+
+	if ((size_t)_end > _limit * 3 / 4 || (size_t)_end - HEADER > 2 * _used)
+		compact();
+	if (_file)
+		fclose(_file);
+	_file = 0;
+}
+
+// Key of the mesh of snapshot: a hash of what meshing reads, seeded with the mesher
+// version and the block registry's tables, so either changing misses every old mesh.
+uint64_t MeshCache::key(const ChunkSnapshot &snapshot) {
+	return snapshot.getHash(BlockRegistry::get().getHash() * 31 + MESH_CACHE::VERSION);
+}
+
+// Reads the mesh stored under key into vertex, which must hold CHUNK::VERTICES, and its
+// vertex counts by Orientation into faces. Returns false if there is none. A mesh read
+// ahead is taken from the ready queue; one still waiting for an I/O thread is read here.
+bool MeshCache::load(uint64_t key, byte4 *vertex, int *faces) {
+	double t = now_ms();
+	bool stalled = false, found = false;
+	Record record;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	std::deque<uint64_t>::iterator queued = std::find(_queue.begin(), _queue.end(), key);
+	if (queued != _queue.end()) {
+		_queue.erase(queued);
+		_reading.erase(key);
+	}
+	else if (_reading.count(key)) {
+		stalled = true;
+		_done.wait(lock, [&] { return !_reading.count(key); });
+	}
+
+	std::unordered_map<uint64_t, Ready>::iterator ready = _ready.find(key);
+	if (ready != _ready.end()) {
+		record = ready->second.record;
+		if (record.count)
+			memcpy(vertex, &ready->second.vertex[0], record.count * sizeof(byte4));
+		++_prefetch.used;
+		found = true;
+	}
+
+	std::unordered_map<uint64_t, Entry>::iterator i = _entries.find(key);
+	if (!found && _file && i != _entries.end()) {
+		// Only this thread changes the index, so the entry holds without the lock
+		Entry entry = i->second;
+		lock.unlock();
+		stalled = true;
+		found = readRecord(_file, entry, key, &record, vertex);
+		lock.lock();
+		i = _entries.find(key);
+
+		// A mesh that doesn't read back is gone for good
+		if (!found) {
+			_used -= record_size(entry.count);
+			_entries.erase(i);
+		}
+	}
+
+	if (stalled) {
+		++_prefetch.stalls;
+		_prefetch.stallMs += now_ms() - t;
+	}
+	if (!found || i == _entries.end()) {
+		++_misses;
+		return false;
+	}
+
+	for (int o = 0; o < 6; ++o)
+		faces[o] = record.faces[o];
+	++_hits;
+
+	// Meshes used this session are the last to go
+	if (i->second.session != _session) {
+		record.session = _session;
+		record.count = TOUCH;
+		record.data = 0;
+		record.check = checksum(&record, offsetof(Record, check));
+		if ((size_t)(_end + record_size(0)) <= _limit && append(record, 0, 0))
+			i->second.session = _session;
+	}
+	return true;
+}
+
+// Adds the mesh in vertex, with faces vertices facing each Orientation, under key.
+// Nothing is added once the file has reached its limit.
+void MeshCache::store(uint64_t key, const byte4 *vertex, const int *faces) {
+	uint32_t count = 0;
+	for (int o = 0; o < 6; ++o)
+		count += faces[o];
+	if (!_file || (size_t)(_end + record_size(count)) > _limit)
+		return;
+
+	Record record;
+	memset(&record, 0, sizeof(record));
+	record.key = key;
+	record.session = _session;
+	record.count = count;
+	for (int o = 0; o < 6; ++o)
+		record.faces[o] = faces[o];
+	record.data = checksum_words(vertex, count);
+	record.check = checksum(&record, offsetof(Record, check));
+
+	Entry entry = { _end, _session, count };
+	if (!append(record, vertex, count * sizeof(byte4)))
+		return;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::pair<std::unordered_map<uint64_t, Entry>::iterator, bool> i = _entries.insert(std::make_pair(key, entry));
+	if (!i.second) {
+		_used -= record_size(i.first->second.count);
+		i.first->second = entry;
+	}
+	_used += record_size(count);
+}
+
+// Has the I/O threads read the meshes under keys ahead of their load, skipping those
+// queued, under way or read already. The queue is kept to MESH_CACHE::READY keys.
+void MeshCache::prefetch(const uint64_t *keys, int count) {
+	if (_readers.empty() || !_file)
+		return;
+
+	// What this session added becomes readable once it is flushed
+	if (_end > _readable)
+		fflush(_file);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_readable = _end;
+	_prefetch.backlog += (int)_reading.size();
+
+	int queued = 0;
+	for (int k = 0; k < count && (int)_queue.size() < MESH_CACHE::READY; ++k) {
+		std::unordered_map<uint64_t, Ready>::iterator ready = _ready.find(keys[k]);
+		if (ready != _ready.end())
+			touchReady(keys[k], &ready->second);
+		if (ready != _ready.end() || !_entries.count(keys[k]) || !_reading.insert(keys[k]).second)
+			continue;
+		_queue.push_back(keys[k]);
+		++queued;
+	}
+	_prefetch.requested += queued;
+	int depth = (int)_reading.size();
+	_prefetch.depthSum += depth;
+	_prefetch.maxDepth = std::max(_prefetch.maxDepth, depth);
+	++_prefetch.samples;
+	if (queued)
+		_wake.notify_all();
+}
+
+PrefetchStats MeshCache::getPrefetchStats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _prefetch;
+}
+
+int MeshCache::getHits() const {
+	return _hits;
+}
+
+int MeshCache::getMisses() const {
+	return _misses;
+}
+
+// Size of the file.
+size_t MeshCache::getBytes() const {
+	return _file ? (size_t)_end : 0;
+}
+
+// Reads the index of the file: where each mesh is and the last session it was used in.
+// A record that is damaged or cut short, as a crash can leave, ends the file there.
+bool MeshCache::read() {
+	char magic[4];
+	uint32_t version, session, check;
+	if (fread(magic, 4, 1, _file) != 1 || memcmp(magic, CACHE_MAGIC, 4) || fread(&version, sizeof(version), 1, _file) != 1 ||
+		fread(&session, sizeof(session), 1, _file) != 1 || fread(&check, sizeof(check), 1, _file) != 1 ||
+		version != (uint32_t)MESH_CACHE::VERSION || check != checksum(&session, sizeof(session), checksum(&version, sizeof(version))))
+		return false;
+	_session = session;
+
+	fseek(_file, 0, SEEK_END);
+	long size = ftell(_file);
+
+	long offset = HEADER;
+	Record record;
+	while (!fseek(_file, offset, SEEK_SET) && fread(&record, sizeof(record), 1, _file) == 1) {
+		if (record.check != checksum(&record, offsetof(Record, check)) ||
+			(record.count != TOUCH && (record.count > (uint32_t)CHUNK::VERTICES || offset + record_size(record.count) > size)))
+			break;
+
+		std::unordered_map<uint64_t, Entry>::iterator i = _entries.find(record.key);
+		if (record.count == TOUCH) {
+			if (i != _entries.end())
+				i->second.session = std::max(i->second.session, record.session);
+			offset += record_size(0);
+			continue;
+		}
+
+		Entry entry = { offset, record.session, record.count };
+		if (i != _entries.end()) {
+			_used -= record_size(i->second.count);
+			i->second = entry;
+		}
+		else
+			_entries.insert(std::make_pair(record.key, entry));
+		_used += record_size(record.count);
+		offset += record_size(record.count);
+	}
+
+	_end = offset;
+	return true;
+}
+
+bool MeshCache::writeHeader() {
+	uint32_t version = MESH_CACHE::VERSION;
+	uint32_t check = checksum(&_session, sizeof(_session), checksum(&version, sizeof(version)));
+	return !fseek(_file, 0, SEEK_SET) && fwrite(CACHE_MAGIC, 4, 1, _file) == 1 && fwrite(&version, sizeof(version), 1, _file) == 1 &&
+		fwrite(&_session, sizeof(_session), 1, _file) == 1 && fwrite(&check, sizeof(check), 1, _file) == 1;
+}
+
+// Reads the record of entry and its vertices from file, checking they are what was stored.
+bool MeshCache::readRecord(FILE *file, const Entry &entry, uint64_t key, Record *record, byte4 *vertex) {
+	return !fseek(file, entry.offset, SEEK_SET) && fread(record, sizeof(*record), 1, file) == 1 &&
+		record->key == key && record->count == entry.count && record->check == checksum(record, offsetof(Record, check)) &&
+		fread(vertex, sizeof(byte4), record->count, file) == record->count && record->data == checksum_words(vertex, record->count);
+}
+
+// Checks a record read into data with its vertices, as readRecord does, and copies it out.
+bool MeshCache::parseRecord(const uint8_t *data, const Entry &entry, uint64_t key, Record *record, byte4 *vertex) {
+	memcpy(record, data, sizeof(*record));
+	if (record->key != key || record->count != entry.count || record->check != checksum(record, offsetof(Record, check)))
+		return false;
+	memcpy(vertex, data + sizeof(*record), record->count * sizeof(byte4));
+	return record->data == checksum_words(vertex, record->count);
+}
+
+// Writes record and the bytes after it at the end of the file, padded to 16 bytes.
+bool MeshCache::append(const Record &record, const void *data, size_t bytes) {
+	static const char zeros[16] = { 0 };
+	size_t pad = (16 - bytes % 16) % 16;
+	if (fseek(_file, _end, SEEK_SET) || fwrite(&record, sizeof(record), 1, _file) != 1 ||
+		(bytes && fwrite(data, bytes, 1, _file) != 1) || (pad && fwrite(zeros, pad, 1, _file) != 1)) {
+		fprintf(stderr, "Error: could not write mesh cache %s\n", _filename.c_str());
+		return false;
+	}
+	_end += (long)(sizeof(record) + bytes + pad);
+	return true;
+}
+
+// Rewrites the file with the meshes used most recently, up to half the limit so it has
+// room to grow again, dropping those unused for MESH_CACHE::MAX_AGE sessions and the
+// space of replaced meshes and touches.
+void MeshCache::compact() {
+	std::vector<std::pair<uint32_t, uint64_t> > order;
+	for (std::unordered_map<uint64_t, Entry>::iterator i = _entries.begin(); i != _entries.end(); ++i)
+		if (_session - i->second.session < (uint32_t)MESH_CACHE::MAX_AGE)
+			order.push_back(std::make_pair(i->second.session, i->first));
+	std::sort(order.begin(), order.end(), std::greater<std::pair<uint32_t, uint64_t> >());
+
+	std::string temporary = _filename + ".tmp";
+	FILE *old = _file;
+	_file = fopen(temporary.c_str(), "w+b");
+	if (!_file) {
+		_file = old;
+		return;
+	}
+
+	std::unordered_map<uint64_t, Entry> entries;
+	entries.swap(_entries);
+	_end = HEADER;
+	_used = 0;
+	bool ok = writeHeader();
+
+	std::vector<byte4> vertex(CHUNK::VERTICES);
+	for (size_t k = 0; k < order.size() && ok; ++k) {
+		const Entry &entry = entries[order[k].second];
+		if ((size_t)(_end + record_size(entry.count)) > _limit / 2)
+			break;
+
+		// Meshes that don't read back are dropped
+		Record record;
+		if (!readRecord(old, entry, order[k].second, &record, &vertex[0]))
+			continue;
+
+		Entry moved = { _end, entry.session, entry.count };
+		record.session = entry.session;
+		record.check = checksum(&record, offsetof(Record, check));
+		ok = append(record, &vertex[0], record.count * sizeof(byte4));
+		_entries.insert(std::make_pair(order[k].second, moved));
+		_used += record_size(entry.count);
+	}
+
+	fclose(old);
+	ok = !fflush(_file) && !ferror(_file) && ok;
+	fclose(_file);
+	_file = 0;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temporary.c_str(), _filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && !rename(temporary.c_str(), _filename.c_str());
+#endif
+	if (!ok) {
+		fprintf(stderr, "Error: could not compact mesh cache %s\n", _filename.c_str());
+		remove(temporary.c_str());
+		_entries.clear();
+		_end = HEADER;
+		_used = 0;
+	}
+
+	// Whatever happened, the cache goes on in a file that is whole
+	_file = fopen(_filename.c_str(), ok ? "r+b" : "w+b");
+	if (_file && !ok)
+		writeHeader();
+}
+
+// The I/O threads. They read from handles of their own, so stop them before the file is
+// compacted or closed.
+void MeshCache::startReaders() {
+	_quit = false;
+	for (int i = 0; i < MESH_CACHE::IO_THREADS; ++i)
+		_readers.push_back(std::thread(&MeshCache::reader, this));
+}
+
+void MeshCache::stopReaders() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (size_t i = 0; i < _readers.size(); ++i)
+		_readers[i].join();
+	_readers.clear();
+
+	_queue.clear();
+	_reading.clear();
+	_ready.clear();
+	_readyOrder.clear();
+	_done.notify_all();
+}
+
+// Makes the mesh read ahead under key the last to be dropped. Call with _mutex held.
+void MeshCache::touchReady(uint64_t key, Ready *ready) {
+	ready->stamp = ++_stamp;
+	_readyOrder.push_back(std::make_pair(ready->stamp, key));
+}
+
+// Drops the meshes read ahead that were touched longest ago, down to MESH_CACHE::READY.
+// Those touched again since are still in the order, further back; the stale places are
+// skipped, and swept out when they pile up. Call with _mutex held.
+void MeshCache::trimReady() {
+	while ((int)_ready.size() > MESH_CACHE::READY && !_readyOrder.empty()) {
+		std::unordered_map<uint64_t, Ready>::iterator i = _ready.find(_readyOrder.front().second);
+		if (i != _ready.end() && i->second.stamp == _readyOrder.front().first)
+			_ready.erase(i);
+		_readyOrder.pop_front();
+	}
+
+	if (_readyOrder.size() > 4 * (size_t)MESH_CACHE::READY) {
+		std::deque<std::pair<uint64_t, uint64_t> > order;
+		for (size_t k = 0; k < _readyOrder.size(); ++k) {
+			std::unordered_map<uint64_t, Ready>::iterator i = _ready.find(_readyOrder[k].second);
+			if (i != _ready.end() && i->second.stamp == _readyOrder[k].first)
+				order.push_back(_readyOrder[k]);
+		}
+		_readyOrder.swap(order);
+	}
+}
+
+// Reads queued meshes a batch at a time, in file order, into the ready queue.
+void MeshCache::reader() {
+	FILE *file = fopen(_filename.c_str(), "rb");
+	IoRing ring;
+	ring.open(_filename.c_str(), MESH_CACHE::IO_BATCH);
+	std::vector<std::pair<Entry, uint64_t> > batch;
+	std::vector<std::pair<bool, Ready> > read;
+	std::vector<std::vector<uint8_t> > buffers;
+	std::vector<IoRead> reads;
+	int ringRead = 0;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_wake.wait(lock, [this] { return _quit || !_queue.empty(); });
+		if (_quit)
+			break;
+
+		// Meshes added since the last flush aren't in the file for this handle yet
+		batch.clear();
+		while (!_queue.empty() && (int)batch.size() < MESH_CACHE::IO_BATCH) {
+			uint64_t key = _queue.front();
+			_queue.pop_front();
+			std::unordered_map<uint64_t, Entry>::iterator i = _entries.find(key);
+			if (i == _entries.end() || i->second.offset + record_size(i->second.count) > _readable)
+				_reading.erase(key);
+			else
+				batch.push_back(std::make_pair(i->second, key));
+		}
+		if (batch.empty()) {
+			_done.notify_all();
+			continue;
+		}
+		lock.unlock();
+
+		// In file order, so a batch reads mostly forwards
+		std::sort(batch.begin(), batch.end(), [](const std::pair<Entry, uint64_t> &a, const std::pair<Entry, uint64_t> &b) {
+			return a.first.offset < b.first.offset;
+		});
+		// The whole batch in one submission if there is a ring; what it fails to read
+		// is read again with stdio
+		bool ringed = false;
+		if (ring.isOpen() && batch.size() <= ring.getEntries()) {
+			buffers.resize(batch.size());
+			reads.resize(batch.size());
+			for (size_t k = 0; k < batch.size(); ++k) {
+				buffers[k].resize(RECORD + batch[k].first.count * sizeof(byte4));
+				IoRead io = { &buffers[k][0], (unsigned)buffers[k].size(), (uint64_t)batch[k].first.offset, -1 };
+				reads[k] = io;
+			}
+			ringed = ring.readAll(&reads[0], (int)batch.size());
+		}
+
+		read.resize(batch.size());
+		ringRead = 0;
+		for (size_t k = 0; k < batch.size(); ++k) {
+			Ready &ready = read[k].second;
+			ready.vertex.resize(std::max<uint32_t>(batch[k].first.count, 1));
+			read[k].first = ringed && reads[k].result == (int)reads[k].bytes &&
+				parseRecord(&buffers[k][0], batch[k].first, batch[k].second, &ready.record, &ready.vertex[0]);
+			ringRead += read[k].first;
+			if (!read[k].first)
+				read[k].first = file && readRecord(file, batch[k].first, batch[k].second, &ready.record, &ready.vertex[0]);
+		}
+
+		lock.lock();
+		for (size_t k = 0; k < batch.size(); ++k) {
+			uint64_t key = batch[k].second;
+			_reading.erase(key);
+			if (!read[k].first)
+				continue;
+			Ready &ready = _ready[key];
+			ready.record = read[k].second.record;
+			ready.vertex.swap(read[k].second.vertex);
+			touchReady(key, &ready);
+			++_prefetch.read;
+		}
+		_prefetch.ringRead += ringRead;
+		trimReady();
+		_done.notify_all();
+	}
+	lock.unlock();
+
+	if (file)
+		fclose(file);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Constants.h"
+#include "Chunk.h"
+
+// What reading ahead has done since MeshCache::open.
+struct PrefetchStats {
+	// Meshes asked for, read by the I/O threads, and loaded from what they read; and of
+	// those read, how many went through an io_uring
+	int requested, read, used;
+	int ringRead;
+	// Loads that had to read the file themselves or wait for a read under way, and the
+	// milliseconds they spent on it
+	int stalls;
+	double stallMs;
+	// Reads queued or under way once each prefetch call has queued its own: summed, at
+	// most, and calls; and those still left from earlier calls, summed
+	uint64_t depthSum;
+	int maxDepth, samples;
+	uint64_t backlog;
+};
+
+// Chunk meshes kept on disk across sessions, so chunks whose blocks and borders haven't
+// changed are read back instead of meshed again. A mesh is found by a hash of what
+// meshing reads, the mesher version and the block tables; it is stored as the raw
+// vertices mesh() writes, ready to upload, 16-byte aligned so the file could be mapped.
+// The file only grows during a session; past its size limit it stops taking new meshes,
+// and on open and close it is rewritten without the meshes not used for longest.
+// Meshes about to be needed can be read ahead with prefetch: I/O threads read them in
+// batches, in file order, into a ready queue load takes them from, so the thread that
+// meshes doesn't wait on the disk. Where IoRing works each batch is one submission,
+// otherwise the threads seek and read with stdio.
+// File: "VXM1", uint32 MESH_CACHE::VERSION, uint32 session, uint32 checksum, then Records
+// each followed by its vertices and padding to 16 bytes.
+class MeshCache {
+public:
+	MeshCache();
+	~MeshCache();
+
+	bool open(const char *filename, size_t limit = (size_t)MESH_CACHE::MAX_MB << 20);
+	void close();
+	static uint64_t key(const ChunkSnapshot &snapshot);
+	bool load(uint64_t key, byte4 *vertex, int *faces);
+	void store(uint64_t key, const byte4 *vertex, const int *faces);
+	void prefetch(const uint64_t *keys, int count);
+	PrefetchStats getPrefetchStats() const;
+	int getHits() const;
+	int getMisses() const;
+	size_t getBytes() const;
+
+private:
+	// A mesh as stored with count vertices after it, or with count TOUCH a note that the
+	// one stored earlier was used in session
+	struct Record {
+		uint64_t key;
+		uint32_t session;
+		uint32_t count;
+		int32_t faces[6];
+		// Checksums of the vertices and of the record before this
+		uint32_t data;
+		uint32_t check;
+	};
+
+	struct Entry {
+		long offset;
+		uint32_t session;
+		uint32_t count;
+	};
+
+	// A mesh read ahead, and when it was last asked for
+	struct Ready {
+		Record record;
+		std::vector<byte4> vertex;
+		uint64_t stamp;
+	};
+
+	bool read();
+	bool writeHeader();
+	void compact();
+	static bool readRecord(FILE *file, const Entry &entry, uint64_t key, Record *record, byte4 *vertex);
+	static bool parseRecord(const uint8_t *data, const Entry &entry, uint64_t key, Record *record, byte4 *vertex);
+	bool append(const Record &record, const void *data, size_t bytes);
+	void startReaders();
+	void stopReaders();
+	void reader();
+	void touchReady(uint64_t key, Ready *ready);
+	void trimReady();
+
+	std::string _filename;
+	FILE *_file;
+	size_t _limit;
+	uint32_t _session;
+	// Where the next record goes, and the bytes of stored meshes still in use
+	long _end;
+	size_t _used;
+	// Written by the calling thread only, but looked up by the I/O threads under _mutex
+	std::unordered_map<uint64_t, Entry> _entries;
+	int _hits, _misses;
+
+	std::vector<std::thread> _readers;
+	mutable std::mutex _mutex;
+	std::condition_variable _wake, _done;
+	// Keys waiting for an I/O thread, and those plus the ones being read
+	std::deque<uint64_t> _queue;
+	std::unordered_set<uint64_t> _reading;
+	// Meshes read ahead, kept after they are loaded for chunks with the same blocks, and
+	// (stamp, key) in the order they were asked for, to drop the oldest
+	std::unordered_map<uint64_t, Ready> _ready;
+	std::deque<std::pair<uint64_t, uint64_t> > _readyOrder;
+	uint64_t _stamp;
+	// Bytes of the file flushed to it, which the I/O threads can read
+	long _readable;
+	bool _quit;
+	PrefetchStats _prefetch;
+};
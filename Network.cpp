@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Network.h"
+#include "Constants.h"
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static const size_t HEADER = 5;
+
+// Was the last socket call only refused because it would have blocked?
+static bool would_block() {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
+
+// Switches a socket to non-blocking mode and turns off Nagle's algorithm, since
+// messages are small and latency matters more than packet count.
+static void configure(socket_t socket) {
+#ifdef _WIN32
+	u_long on = 1;
+	ioctlsocket(socket, FIONBIO, &on);
+#else
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+	int flag = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&flag, sizeof(flag));
+}
+
+Connection::Connection() : _socket(NO_SOCKET), _sent(0) {
+}
+
+Connection::~Connection() {
+	close();
+}
+
+// Connects to host:port, waiting until the connection is up.
+bool Connection::connect(const char *host, int port) {
+	close();
+	if (!net_startup())
+		return false;
+
+	char service[16];
+	sprintf(service, "%d", port);
+	addrinfo hints, *address = 0;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, service, &hints, &address) || !address) {
+		fprintf(stderr, "Error: could not resolve %s\n", host);
+		return false;
+	}
+
+	socket_t s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+	bool ok = s != NO_SOCKET && ::connect(s, address->ai_addr, (int)address->ai_addrlen) == 0;
+	freeaddrinfo(address);
+
+	if (!ok) {
+		fprintf(stderr, "Error: could not connect to %s:%d\n", host, port);
+		if (s != NO_SOCKET)
+			net_close(s);
+		return false;
+	}
+
+	adopt(s);
+	return true;
+}
+
+// Takes over an accepted socket.
+void Connection::adopt(socket_t socket) {
+	close();
+	_socket = socket;
+	configure(_socket);
+}
+
+void Connection::close() {
+	if (_socket != NO_SOCKET)
+		net_close(_socket);
+	_socket = NO_SOCKET;
+	_in.clear();
+	_out.clear();
+	_sent = 0;
+}
+
+bool Connection::isOpen() const {
+	return _socket != NO_SOCKET;
+}
+
+socket_t Connection::getSocket() const {
+	return _socket;
+}
+
+// Queues a message; flush() sends it.
+void Connection::send(uint8_t type, const std::vector<uint8_t> &payload) {
+	put32(_out, (uint32_t)payload.size());
+	_out.push_back(type);
+	_out.insert(_out.end(), payload.begin(), payload.end());
+}
+
+// Writes as much queued output as the socket takes without blocking.
+// Returns false if the connection failed.
+bool Connection::flush() {
+	while (_sent < _out.size()) {
+		int n = ::send(_socket, (const char *)&_out[_sent], (int)(_out.size() - _sent), 0);
+		if (n < 0) {
+			if (would_block())
+				break;
+			return false;
+		}
+		_sent += n;
+	}
+
+	if (_sent == _out.size()) {
+		_out.clear();
+		_sent = 0;
+	}
+	return true;
+}
+
+bool Connection::hasOutput() const {
+	return _sent < _out.size();
+}
+
+// Reads whatever has arrived, up to NET::MAX_INPUT buffered; the rest waits in the socket
+// until next() has taken some. Returns false once the other side has closed the connection.
+bool Connection::receive() {
+	uint8_t buffer[16384];
+	while (_in.size() < (size_t)NET::MAX_INPUT) {
+		int n = recv(_socket, (char *)buffer, sizeof(buffer), 0);
+		if (n > 0) {
+			_in.insert(_in.end(), buffer, buffer + n);
+			continue;
+		}
+		return n < 0 && would_block();
+	}
+	return true;
+}
+
+// Takes the next complete message out of the input, if there is one. A message longer
+// than NET::MAX_MESSAGE closes the connection, so check isOpen() when this returns false.
+bool Connection::next(uint8_t *type, std::vector<uint8_t> &payload) {
+	if (_in.size() < HEADER)
+		return false;
+
+	// Checked before adding HEADER, which could wrap a 32-bit size_t
+	uint32_t size = get32(&_in[0]);
+	if (size > (uint32_t)NET::MAX_MESSAGE) {
+		fprintf(stderr, "Error: message of %u bytes, dropping the connection\n", size);
+		close();
+		return false;
+	}
+	if (_in.size() < HEADER + size)
+		return false;
+
+	*type = _in[4];
+	payload.assign(_in.begin() + HEADER, _in.begin() + HEADER + size);
+	_in.erase(_in.begin(), _in.begin() + HEADER + size);
+	return true;
+}
+
+// Waits up to ms milliseconds for input. Returns true if there is some.
+bool Connection::wait(int ms) {
+	fd_set read;
+	FD_ZERO(&read);
+	FD_SET(_socket, &read);
+	timeval timeout = { ms / 1000, ms % 1000 * 1000 };
+	return select((int)_socket + 1, &read, 0, 0, &timeout) > 0;
+}
+
+// Initializes the socket library once; a no-op outside Windows.
+bool net_startup() {
+#ifdef _WIN32
+	static bool started = false;
+	WSADATA data;
+	if (!started && WSAStartup(MAKEWORD(2, 2), &data)) {
+		fprintf(stderr, "Error: could not initialize Winsock\n");
+		return false;
+	}
+	started = true;
+#endif
+	return true;
+}
+
+// Listening socket on port of every interface, or NO_SOCKET. Port 0 picks a free one.
+socket_t net_listen(int port) {
+	if (!net_startup())
+		return NO_SOCKET;
+
+	socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+	if (s == NO_SOCKET)
+		return NO_SOCKET;
+
+	int flag = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&flag, sizeof(flag));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((unsigned short)port);
+
+	if (bind(s, (sockaddr *)&address, sizeof(address)) || listen(s, 64)) {
+		fprintf(stderr, "Error: could not listen on port %d\n", port);
+		net_close(s);
+		return NO_SOCKET;
+	}
+
+	configure(s);
+	return s;
+}
+
+// Local port a socket is bound to.
+int net_port(socket_t socket) {
+	sockaddr_in address;
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size))
+		return 0;
+	return ntohs(address.sin_port);
+}
+
+// Next pending connection on listener, or NO_SOCKET if there is none.
+socket_t net_accept(socket_t listener) {
+	return accept(listener, 0, 0);
+}
+
+void net_close(socket_t socket) {
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	::close(socket);
+#endif
+}
+
+void put32(std::vector<uint8_t> &out, uint32_t v) {
+	for (int i = 0; i < 4; ++i)
+		out.push_back((v >> (i * 8)) & 0xff);
+}
+
+uint32_t get32(const uint8_t *in) {
+	return in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// Run-length encodes count blocks as (run length - 1, type) byte pairs.
+// Terrain has long runs of air, stone and water along z, so chunks shrink a lot.
+void encode_blocks(const uint8_t *block, int count, std::vector<uint8_t> &out) {
+	for (int i = 0; i < count;) {
+		int run = 1;
+		while (i + run < count && run < 256 && block[i + run] == block[i])
+			++run;
+		out.push_back((uint8_t)(run - 1));
+		out.push_back(block[i]);
+		i += run;
+	}
+}
+
+// Decodes what encode_blocks wrote. Returns false unless it comes to exactly count blocks.
+bool decode_blocks(const uint8_t *in, size_t size, uint8_t *block, int count) {
+	int n = 0;
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		int run = in[i] + 1;
+		if (n + run > count)
+			return false;
+		memset(block + n, in[i + 1], run);
+		n += run;
+	}
+	return n == count && size % 2 == 0;
+}
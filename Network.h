@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET socket_t;
+#else
+typedef int socket_t;
+#endif
+
+// Messages between ChunkServer and ChunkClient. Each one is a uint32 payload size and a
+// uint8 type, followed by the payload. All integers are little endian.
+namespace MESSAGE {
+	// Server: int64 seed, sent once on connect
+	static const uint8_t HELLO = 1;
+	// Client: int32 cx, cy, cz, the grid index of a chunk it wants
+	static const uint8_t REQUEST = 2;
+	// Client: int32 cx, cy, cz of a chunk it no longer keeps
+	static const uint8_t DROP = 3;
+	// Server: int32 cx, cy, cz, then the chunk's blocks run-length encoded
+	static const uint8_t CHUNK = 4;
+	// Client: int32 x, y, z, uint8 type, a block edit
+	static const uint8_t EDIT = 5;
+	// Server: int32 x, y, z, uint8 type, an edit inside a chunk the client keeps
+	static const uint8_t DELTA = 6;
+	// Client: int32 cx, cy, cz of a chunk asked for and not sent yet, to send before the
+	// others
+	static const uint8_t PRIORITY = 7;
+}
+
+static const socket_t NO_SOCKET = (socket_t)-1;
+
+// A non-blocking TCP connection that carries framed messages. Output is buffered until
+// the socket takes it; input is buffered until whole messages have arrived.
+class Connection {
+public:
+	Connection();
+	~Connection();
+
+	bool connect(const char *host, int port);
+	void adopt(socket_t socket);
+	void close();
+	bool isOpen() const;
+	socket_t getSocket() const;
+
+	void send(uint8_t type, const std::vector<uint8_t> &payload);
+	bool flush();
+	bool hasOutput() const;
+	bool receive();
+	bool next(uint8_t *type, std::vector<uint8_t> &payload);
+	bool wait(int ms);
+
+private:
+	socket_t _socket;
+	std::vector<uint8_t> _in, _out;
+	size_t _sent;
+};
+
+bool net_startup();
+socket_t net_listen(int port);
+int net_port(socket_t socket);
+socket_t net_accept(socket_t listener);
+void net_close(socket_t socket);
+
+void put32(std::vector<uint8_t> &out, uint32_t v);
+uint32_t get32(const uint8_t *in);
+void encode_blocks(const uint8_t *block, int count, std::vector<uint8_t> &out);
+bool decode_blocks(const uint8_t *in, size_t size, uint8_t *block, int count);
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <vector>
+
+#include "Offscreen.h"
+#include "PngWriter.h"
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+Offscreen::Offscreen() : _display(0), _context(0), _fbo(0), _color(0), _depth(0), _width(0), _height(0) {
+}
+
+Offscreen::~Offscreen() {
+	destroy();
+}
+
+bool Offscreen::create(int width, int height) {
+#ifdef _WIN32
+	fprintf(stderr, "Offscreen rendering needs EGL, which this build does not have\n");
+	return false;
+#else
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	// Prefer a surfaceless display, which needs neither X nor a GPU
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		fprintf(stderr, "Error: no EGL display (0x%x)\n", eglGetError());
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		fprintf(stderr, "Error: EGL has no desktop OpenGL\n");
+		eglTerminate(display);
+		return false;
+	}
+
+	static const EGLint attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = 0;
+	EGLint configs = 0;
+	eglChooseConfig(display, attributes, &config, 1, &configs);
+
+	// Surfaceless contexts don't need a config at all
+	EGLContext context = eglCreateContext(display, configs ? config : 0, EGL_NO_CONTEXT, 0);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fprintf(stderr, "Error: could not create an EGL context (0x%x)\n", eglGetError());
+		eglTerminate(display);
+		return false;
+	}
+
+	_display = display;
+	_context = context;
+
+	// GLEW may complain about the missing GLX display, but the GL entry points load fine
+	glewInit();
+	if (!GLEW_VERSION_2_0) {
+		fprintf(stderr, "No support for OpenGL 2.0 found\n");
+		destroy();
+		return false;
+	}
+
+	_width = width;
+	_height = height;
+
+	glGenRenderbuffers(1, &_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, _color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glGenFramebuffers(1, &_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Error: offscreen framebuffer is incomplete\n");
+		destroy();
+		return false;
+	}
+
+	glViewport(0, 0, width, height);
+	fprintf(stderr, "Offscreen %dx%d on %s\n", width, height, glGetString(GL_RENDERER));
+	return true;
+#endif
+}
+
+void Offscreen::destroy() {
+#ifndef _WIN32
+	if (!_display)
+		return;
+
+	if (_fbo) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &_fbo);
+		glDeleteRenderbuffers(1, &_color);
+		glDeleteRenderbuffers(1, &_depth);
+		_fbo = _color = _depth = 0;
+	}
+
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(_display, _context);
+	eglTerminate(_display);
+	_display = _context = 0;
+#endif
+}
+
+// Saves what has been rendered so far as a PNG image.
+bool Offscreen::capture(const char *filename) {
+	if (!_fbo)
+		return false;
+
+	std::vector<uint8_t> pixels((size_t)_width * _height * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	return write_png(filename, _width, _height, &pixels[0], true);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// A GL context without a window, rendering into a framebuffer object.
+// Uses an EGL surfaceless context, so it works with Mesa's software rasterizer
+// on machines without a display or GPU.
+class Offscreen {
+public:
+	Offscreen();
+	~Offscreen();
+	bool create(int width, int height);
+	void destroy();
+	bool capture(const char *filename);
+
+private:
+	void *_display;
+	void *_context;
+	GLuint _fbo, _color, _depth;
+	int _width, _height;
+};
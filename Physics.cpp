@@ -0,0 +1,286 @@
+#include <math.h>
+#include <algorithm>
+
+#include "Physics.h"
+#include "World.h"
+
+using namespace glm;
+
+VoxelQuery::VoxelQuery(const World *world) : _world(world), _chunk(0), _ox(0), _oy(0), _oz(0) {
+}
+
+bool VoxelQuery::isSolid(int x, int y, int z) {
+	int lx = x - _ox;
+	int ly = y - _oy;
+	int lz = z - _oz;
+
+	// Only go through the world when we leave the cached chunk
+	if (!_chunk || (unsigned)lx >= (unsigned)CHUNK::X || (unsigned)ly >= (unsigned)CHUNK::Y || (unsigned)lz >= (unsigned)CHUNK::Z) {
+		_chunk = _world->findChunk(x, y, z);
+		if (!_chunk)
+			return false;
+
+		_ox = _chunk->getX() * CHUNK::X;
+		_oy = _chunk->getY() * CHUNK::Y;
+		_oz = _chunk->getZ() * CHUNK::Z;
+		lx = x - _ox;
+		ly = y - _oy;
+		lz = z - _oz;
+	}
+
+	// Terrain that hasn't been generated yet is empty
+	if (!_chunk->isNoised())
+		return false;
+
+	uint8_t type = _chunk->getBlock(lx, ly, lz);
+	return type != BLOCK::AIR && type != BLOCK::WATER;
+}
+
+int EntityStore::add(const vec3 &position, const vec3 &halfExtents) {
+	px.push_back(position.x);
+	py.push_back(position.y);
+	pz.push_back(position.z);
+	vx.push_back(0);
+	vy.push_back(0);
+	vz.push_back(0);
+	hx.push_back(halfExtents.x);
+	hy.push_back(halfExtents.y);
+	hz.push_back(halfExtents.z);
+	ground.push_back(0);
+	return size() - 1;
+}
+
+void EntityStore::remove(int id) {
+	int last = size() - 1;
+
+	px[id] = px[last];
+	py[id] = py[last];
+	pz[id] = pz[last];
+	vx[id] = vx[last];
+	vy[id] = vy[last];
+	vz[id] = vz[last];
+	hx[id] = hx[last];
+	hy[id] = hy[last];
+	hz[id] = hz[last];
+	ground[id] = ground[last];
+
+	px.pop_back();
+	py.pop_back();
+	pz.pop_back();
+	vx.pop_back();
+	vy.pop_back();
+	vz.pop_back();
+	hx.pop_back();
+	hy.pop_back();
+	hz.pop_back();
+	ground.pop_back();
+}
+
+int EntityStore::size() const {
+	return (int)px.size();
+}
+
+Physics::Physics(const World *world, ThreadPool *pool) : _world(world), _pool(pool), _mask(0) {
+}
+
+// Is any block in the slab at coordinate cell along axis a, spanning [b0, b1] x [c0, c1]
+// along the other two axes, solid?
+static bool blocked(VoxelQuery &query, int a, int cell, int b0, int b1, int c0, int c1) {
+	int p[3];
+	int b = (a + 1) % 3;
+	int c = (a + 2) % 3;
+
+	p[a] = cell;
+	for (p[b] = b0; p[b] <= b1; ++p[b])
+		for (p[c] = c0; p[c] <= c1; ++p[c])
+			if (query.isSolid(p[0], p[1], p[2]))
+				return true;
+
+	return false;
+}
+
+// Moves a box by delta one axis at a time, stopping each axis at the first solid block in
+// its way. Every block the box passes is checked, so fast boxes can't tunnel through walls.
+// Returns the new position; hit[a] tells whether movement along axis a was cut short.
+vec3 Physics::sweep(VoxelQuery &query, const vec3 &position, const vec3 &halfExtents, const vec3 &delta, bool *hit) {
+	// Vertical first, so boxes settle onto the ground before sliding along it
+	static const int order[3] = { 1, 0, 2 };
+
+	vec3 lo = position - halfExtents;
+	vec3 hi = position + halfExtents;
+
+	for (int n = 0; n < 3; ++n) {
+		int a = order[n];
+		int b = (a + 1) % 3;
+		int c = (a + 2) % 3;
+		float d = delta[a];
+
+		hit[a] = false;
+		if (d == 0)
+			continue;
+
+		// Blocks the box overlaps on the other two axes; touching a face doesn't count
+		int b0 = (int)floorf(lo[b]);
+		int b1 = (int)ceilf(hi[b]) - 1;
+		int c0 = (int)floorf(lo[c]);
+		int c1 = (int)ceilf(hi[c]) - 1;
+
+		if (d > 0) {
+			int last = (int)ceilf(hi[a] + d) - 1;
+			for (int cell = (int)ceilf(hi[a]); cell <= last; ++cell) {
+				if (blocked(query, a, cell, b0, b1, c0, c1)) {
+					d = cell - PHYSICS::SKIN - hi[a];
+					hit[a] = true;
+					break;
+				}
+			}
+		}
+		else {
+			int last = (int)floorf(lo[a] + d);
+			for (int cell = (int)floorf(lo[a]) - 1; cell >= last; --cell) {
+				if (blocked(query, a, cell, b0, b1, c0, c1)) {
+					d = cell + 1 + PHYSICS::SKIN - lo[a];
+					hit[a] = true;
+					break;
+				}
+			}
+		}
+
+		lo[a] += d;
+		hi[a] += d;
+	}
+
+	return (lo + hi) * 0.5f;
+}
+
+// Sweeps a single box, e.g. the camera, from the main thread.
+vec3 Physics::move(const vec3 &position, const vec3 &halfExtents, const vec3 &delta) {
+	VoxelQuery query(_world);
+	bool hit[3];
+	return sweep(query, position, halfExtents, delta, hit);
+}
+
+static inline unsigned hash_cell(int x, int y, int z) {
+	return (unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u;
+}
+
+static inline int cell_of(float v) {
+	return (int)floorf(v / PHYSICS::CELL);
+}
+
+// Advances every entity by dt: gravity, separation from overlapping entities and
+// collision with the world. Entities are split into batches that run on the thread pool.
+void Physics::step(float dt) {
+	int count = entities.size();
+	if (!count)
+		return;
+
+	// Entities read each other's positions from a copy, so batches can write freely
+	_x = entities.px;
+	_y = entities.py;
+	_z = entities.pz;
+	buildHash();
+
+	int batches = (count + PHYSICS::BATCH - 1) / PHYSICS::BATCH;
+	_pool->parallelFor(batches, [&](int i) {
+		stepRange(i * PHYSICS::BATCH, std::min(count, (i + 1) * PHYSICS::BATCH), dt);
+	});
+}
+
+// Counting sort of entity indices into hash buckets: bucket k holds
+// _order[_bucket[k]] .. _order[_bucket[k + 1] - 1].
+void Physics::buildHash() {
+	int count = entities.size();
+	int size = 64;
+	while (size < count * 2)
+		size *= 2;
+	_mask = size - 1;
+
+	_bucket.assign(size + 1, 0);
+	_order.resize(count);
+
+	std::vector<int> key(count);
+	for (int i = 0; i < count; ++i) {
+		key[i] = hash_cell(cell_of(_x[i]), cell_of(_y[i]), cell_of(_z[i])) & _mask;
+		++_bucket[key[i] + 1];
+	}
+
+	for (int k = 0; k < size; ++k)
+		_bucket[k + 1] += _bucket[k];
+
+	std::vector<int> next(_bucket.begin(), _bucket.end() - 1);
+	for (int i = 0; i < count; ++i)
+		_order[next[key[i]]++] = i;
+}
+
+void Physics::stepRange(int begin, int end, float dt) {
+	VoxelQuery query(_world);
+
+	for (int i = begin; i < end; ++i) {
+		vec3 position(_x[i], _y[i], _z[i]);
+		vec3 half(entities.hx[i], entities.hy[i], entities.hz[i]);
+		vec3 push(0, 0, 0);
+
+		// Push apart horizontally from every overlapping entity in the surrounding cells.
+		// Different cells can share a bucket, so skip buckets we have already seen.
+		int cx = cell_of(position.x);
+		int cy = cell_of(position.y);
+		int cz = cell_of(position.z);
+		int seen[27];
+		int seenCount = 0;
+
+		for (int dx = -1; dx <= 1; ++dx) {
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dz = -1; dz <= 1; ++dz) {
+					int k = hash_cell(cx + dx, cy + dy, cz + dz) & _mask;
+					bool visited = false;
+					for (int s = 0; s < seenCount; ++s)
+						visited |= seen[s] == k;
+					if (visited)
+						continue;
+					seen[seenCount++] = k;
+
+					for (int o = _bucket[k]; o < _bucket[k + 1]; ++o) {
+						int j = _order[o];
+						if (j == i)
+							continue;
+
+						float ox = half.x + entities.hx[j] - fabsf(_x[j] - position.x);
+						float oy = half.y + entities.hy[j] - fabsf(_y[j] - position.y);
+						float oz = half.z + entities.hz[j] - fabsf(_z[j] - position.z);
+						if (ox <= 0 || oy <= 0 || oz <= 0)
+							continue;
+
+						// Each side of the pair moves half the way out along the shallower axis.
+						// Entities at the same spot are told apart by index.
+						bool before = i < j;
+						if (ox < oz)
+							push.x += (position.x < _x[j] || (position.x == _x[j] && before) ? -0.5f : 0.5f) * ox;
+						else
+							push.z += (position.z < _z[j] || (position.z == _z[j] && before) ? -0.5f : 0.5f) * oz;
+					}
+				}
+			}
+		}
+
+		vec3 velocity(entities.vx[i], entities.vy[i] - PHYSICS::GRAVITY * dt, entities.vz[i]);
+		for (int a = 0; a < 3; ++a)
+			velocity[a] = clamp(velocity[a], -PHYSICS::MAX_SPEED, PHYSICS::MAX_SPEED);
+
+		bool hit[3];
+		vec3 delta = velocity * dt + push;
+		position = sweep(query, position, half, delta, hit);
+
+		for (int a = 0; a < 3; ++a)
+			if (hit[a])
+				velocity[a] = 0;
+
+		entities.px[i] = position.x;
+		entities.py[i] = position.y;
+		entities.pz[i] = position.z;
+		entities.vx[i] = velocity.x;
+		entities.vy[i] = velocity.y;
+		entities.vz[i] = velocity.z;
+		entities.ground[i] = hit[1] && delta.y < 0;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Constants.h"
+#include "Chunk.h"
+#include "ThreadPool.h"
+
+class World;
+
+// Answers "is this block solid" for a stream of nearby queries.
+// The last chunk looked up is cached, so only queries that cross into another chunk
+// go through World. Each thread needs its own instance.
+class VoxelQuery {
+public:
+	VoxelQuery(const World *world);
+	bool isSolid(int x, int y, int z);
+
+private:
+	const World *_world;
+	Chunk *_chunk;
+	int _ox, _oy, _oz;
+};
+
+// Simple entities stored as structure of arrays. Entity ids are indices,
+// and removing an entity moves the last one into its slot.
+struct EntityStore {
+	std::vector<float> px, py, pz;
+	std::vector<float> vx, vy, vz;
+	std::vector<float> hx, hy, hz;
+	std::vector<uint8_t> ground;
+
+	int add(const glm::vec3 &position, const glm::vec3 &halfExtents);
+	void remove(int id);
+	int size() const;
+};
+
+// Moves axis-aligned boxes through the world without entering solid blocks.
+class Physics {
+public:
+	Physics(const World *world, ThreadPool *pool);
+
+	static glm::vec3 sweep(VoxelQuery &query, const glm::vec3 &position, const glm::vec3 &halfExtents, const glm::vec3 &delta, bool *hit);
+	glm::vec3 move(const glm::vec3 &position, const glm::vec3 &halfExtents, const glm::vec3 &delta);
+	void step(float dt);
+
+	EntityStore entities;
+
+private:
+	void buildHash();
+	void stepRange(int begin, int end, float dt);
+
+	const World *_world;
+	ThreadPool *_pool;
+	// Spatial hash of entity positions from the start of the step, bucketed by cell
+	std::vector<float> _x, _y, _z;
+	std::vector<int> _bucket, _order;
+	int _mask;
+};
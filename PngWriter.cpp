@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "PngWriter.h"
+
+static uint32_t crc_table[256];
+
+static void init_crc_table() {
+	for (uint32_t n = 0; n < 256; ++n) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; ++k)
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		crc_table[n] = c;
+	}
+}
+
+static uint32_t crc(uint32_t c, const uint8_t *data, size_t length) {
+	for (size_t i = 0; i < length; ++i)
+		c = crc_table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+	return c;
+}
+
+static void put32(std::vector<uint8_t> &out, uint32_t v) {
+	out.push_back(v >> 24);
+	out.push_back(v >> 16);
+	out.push_back(v >> 8);
+	out.push_back(v);
+}
+
+static void chunk(FILE *file, const char *type, const std::vector<uint8_t> &data) {
+	std::vector<uint8_t> out;
+	put32(out, (uint32_t)data.size());
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put32(out, crc(0xffffffffu, &out[4], out.size() - 4) ^ 0xffffffffu);
+	fwrite(&out[0], 1, out.size(), file);
+}
+
+bool write_png(const char *filename, int width, int height, const uint8_t *rgba, bool flip) {
+	static const uint8_t signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+	if (!crc_table[1])
+		init_crc_table();
+
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	fwrite(signature, 1, sizeof(signature), file);
+
+	std::vector<uint8_t> header;
+	put32(header, width);
+	put32(header, height);
+	header.push_back(8);	// bits per channel
+	header.push_back(6);	// RGBA
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	chunk(file, "IHDR", header);
+
+	// Scanlines, each with a "no filter" byte in front
+	size_t stride = (size_t)width * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * height);
+	for (int y = 0; y < height; ++y) {
+		const uint8_t *row = rgba + stride * (flip ? height - 1 - y : y);
+		raw.push_back(0);
+		raw.insert(raw.end(), row, row + stride);
+	}
+
+	// zlib stream made of stored (uncompressed) deflate blocks
+	std::vector<uint8_t> z;
+	z.push_back(0x78);
+	z.push_back(0x01);
+	for (size_t i = 0; i < raw.size() || i == 0; i += 65535) {
+		size_t n = raw.size() - i < 65535 ? raw.size() - i : 65535;
+		z.push_back(i + n == raw.size());
+		z.push_back(n & 0xff);
+		z.push_back(n >> 8);
+		z.push_back(~n & 0xff);
+		z.push_back((~n >> 8) & 0xff);
+		z.insert(z.end(), raw.begin() + i, raw.begin() + i + n);
+	}
+
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); ++i) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	put32(z, b << 16 | a);
+	chunk(file, "IDAT", z);
+
+	chunk(file, "IEND", std::vector<uint8_t>());
+	return fclose(file) == 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Writes 8-bit RGBA pixels to an uncompressed PNG file.
+// With flip set, rows are taken bottom-up, as glReadPixels returns them.
+bool write_png(const char *filename, int width, int height, const uint8_t *rgba, bool flip);
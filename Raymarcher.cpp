@@ -0,0 +1,382 @@
+#include <math.h>
+#include <emmintrin.h>
+#include <algorithm>
+
+#include "Raymarcher.h"
+#include "World.h"
+#include "textures.c"
+
+using namespace glm;
+
+// Tiles are square blocks of pixels handed out to the thread pool
+static const int TILE = 32;
+static const float FAR = 1e30f;
+static const float FOG_DENSITY = .00005f;
+static const float FOG[3] = { 0.6f, 0.8f, 1.0f };
+
+// World bounds in blocks
+static const int LO[3] = { -CHUNK::X * (WORLD::X / 2), -CHUNK::Y * (WORLD::Y / 2), -CHUNK::Z * (WORLD::Z / 2) };
+static const int SIZE[3] = { CHUNK::X * WORLD::X, CHUNK::Y * WORLD::Y, CHUNK::Z * WORLD::Z };
+static const int SHIFT = 4;
+static const int BRICK = 2;
+
+static_assert(CHUNK::X == 1 << SHIFT && CHUNK::Y == 1 << SHIFT && CHUNK::Z == 1 << SHIFT, "Raymarcher expects 16^3 chunks");
+
+union Floats {
+	__m128 v;
+	float f[4];
+};
+
+union Ints {
+	__m128i v;
+	int i[4];
+};
+
+// Four rays traced in lockstep, one per SSE lane. Each lane runs its own DDA through
+// the block grid: cell is the block the ray is in, entered at distance t by crossing
+// the axis in axis, and tMax holds the distances at which it leaves along x, y and z.
+struct Packet {
+	Floats tMax[3], tDelta[3];
+	Ints cell[3], step[3];
+	Floats t;
+	vec3 origin[4], dir[4];
+	float end[4], depth[4];
+	int axis[4];
+	bool active[4];
+};
+
+Raymarcher::Raymarcher(const World *world, ThreadPool *pool) : _world(world), _pool(pool), _rays(0) {
+}
+
+// Renders a perspective image looking from eye towards target, fovy in radians.
+void Raymarcher::renderView(const vec3 &eye, const vec3 &target, float fovy, int width, int height, std::vector<uint8_t> &rgba) {
+	View view;
+	view.map = false;
+	view.eye = eye;
+	view.forward = normalize(target - eye);
+	view.right = normalize(cross(view.forward, vec3(0, 1, 0)));
+	view.up = cross(view.right, view.forward);
+	view.scaleY = tanf(fovy / 2);
+	view.scaleX = view.scaleY * width / height;
+	view.width = width;
+	view.height = height;
+	render(view, rgba);
+}
+
+// Renders a top-down map tile of size x size blocks with its corner at (x, z), pixels wide.
+// Image rows run along +z and columns along +x.
+void Raymarcher::renderMap(float x, float z, float size, int pixels, std::vector<uint8_t> &rgba) {
+	View view;
+	view.map = true;
+	view.eye = vec3(x, (float)(LO[1] + SIZE[1]) + 1, z);
+	view.forward = vec3(0, -1, 0);
+	view.right = vec3(1, 0, 0);
+	view.up = vec3(0, 0, 1);
+	view.scaleX = view.scaleY = size / pixels;
+	view.width = view.height = pixels;
+	render(view, rgba);
+}
+
+// Total number of primary rays traced so far.
+long long Raymarcher::getRays() const {
+	return _rays;
+}
+
+// Finds the chunks and bricks worth marching through. Chunks that are not generated yet
+// or hold nothing but air, and all-air bricks, are crossed by the rays in one step.
+void Raymarcher::prepare() {
+	_blocks.resize(WORLD::X * WORLD::Y * WORLD::Z * CHUNK::X * CHUNK::Y * CHUNK::Z);
+	uint8_t *block = &_blocks[0];
+
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z, block += CHUNK::X * CHUNK::Y * CHUNK::Z) {
+				Chunk *chunk = _world->getChunk(x, y, z);
+				uint64_t bricks = 0;
+
+				if (chunk->isNoised()) {
+					chunk->getBlocks(block);
+					for (int i = 0; i < CHUNK::X; ++i)
+						for (int j = 0; j < CHUNK::Y; ++j)
+							for (int k = 0; k < CHUNK::Z; ++k)
+								if (block[(i * CHUNK::Y + j) * CHUNK::Z + k] != BLOCK::AIR)
+									bricks |= 1ull << ((i >> BRICK) * 16 + (j >> BRICK) * 4 + (k >> BRICK));
+				}
+
+				_solid[x][y][z] = bricks ? block : 0;
+				_bricks[x][y][z] = bricks;
+			}
+		}
+	}
+}
+
+void Raymarcher::render(const View &view, std::vector<uint8_t> &rgba) {
+	prepare();
+	rgba.resize(view.width * view.height * 4);
+
+	int columns = (view.width + TILE - 1) / TILE;
+	int rows = (view.height + TILE - 1) / TILE;
+	uint8_t *pixels = &rgba[0];
+
+	_pool->parallelFor(columns * rows, [&](int i) {
+		renderTile(view, i % columns, i / columns, pixels);
+	});
+}
+
+// Sets up lane to march from origin + t * dir, clipped to the world box. If the ray
+// crosses a block boundary at t, axis is the axis it crosses, otherwise -1.
+static void start(Packet &p, int lane, float t, int axis) {
+	const vec3 &o = p.origin[lane];
+	const vec3 &d = p.dir[lane];
+	float enter = t;
+	float leave = p.end[lane];
+
+	for (int a = 0; a < 3; ++a) {
+		if (d[a] == 0) {
+			if (o[a] < LO[a] || o[a] >= LO[a] + SIZE[a])
+				leave = -1;
+			continue;
+		}
+
+		float t0 = (LO[a] - o[a]) / d[a];
+		float t1 = (LO[a] + SIZE[a] - o[a]) / d[a];
+		if (std::min(t0, t1) > enter) {
+			enter = std::min(t0, t1);
+			axis = a;
+		}
+		leave = std::min(leave, std::max(t0, t1));
+	}
+
+	p.end[lane] = leave;
+	if (enter >= leave) {
+		p.active[lane] = false;
+		return;
+	}
+
+	vec3 position = o + d * enter;
+	p.t.f[lane] = enter;
+	if (axis >= 0)
+		p.axis[lane] = axis;
+
+	for (int a = 0; a < 3; ++a) {
+		// On the boundary being crossed, rounding decides which side the ray is on
+		int cell = a == axis ? (int)floorf(position[a] + 0.5f) - (d[a] < 0) : (int)floorf(position[a]);
+		cell = std::min(std::max(cell, LO[a]), LO[a] + SIZE[a] - 1);
+		p.cell[a].i[lane] = cell;
+
+		if (d[a] > 0) {
+			p.step[a].i[lane] = 1;
+			p.tDelta[a].f[lane] = 1 / d[a];
+			p.tMax[a].f[lane] = (cell + 1 - o[a]) / d[a];
+		}
+		else if (d[a] < 0) {
+			p.step[a].i[lane] = -1;
+			p.tDelta[a].f[lane] = -1 / d[a];
+			p.tMax[a].f[lane] = (cell - o[a]) / d[a];
+		}
+		else {
+			p.step[a].i[lane] = 0;
+			p.tDelta[a].f[lane] = FAR;
+			p.tMax[a].f[lane] = FAR;
+		}
+	}
+
+	p.active[lane] = true;
+}
+
+// Distance at which the lane's ray leaves the aligned cube of 2^shift blocks it is in,
+// and across which axis.
+static float leave_cube(const Packet &p, int lane, int shift, int *axis) {
+	float leave = FAR;
+	for (int a = 0; a < 3; ++a) {
+		float d = p.dir[lane][a];
+		if (d == 0)
+			continue;
+
+		int corner = ((p.cell[a].i[lane] - LO[a]) >> shift << shift) + LO[a];
+		float t = ((d > 0 ? corner + (1 << shift) : corner) - p.origin[lane][a]) / d;
+		if (t < leave) {
+			leave = t;
+			*axis = a;
+		}
+	}
+	return leave;
+}
+
+// Colour of a block face hit at point, as baseShader would draw it. Returns false for
+// see-through texels, which the ray passes.
+static bool shade(uint8_t type, int axis, const vec3 &point, float *rgb) {
+	float u, v;
+	if (axis == 1) {
+		u = point.x - floorf(point.x);
+		v = point.z - floorf(point.z);
+	}
+	else {
+		float s = point.x + point.z;
+		u = s - floorf(s);
+		v = -point.y - floorf(-point.y);
+	}
+
+	int tx = std::min((int)(u * 16), 15) + type * 16;
+	int ty = std::min((int)(v * 16), 15);
+	const unsigned char *texel = textures.pixel_data + ((ty * textures.width + (tx & 255)) * 4);
+
+	if (texel[3] < 0.4f * 255)
+		return false;
+
+	float intensity = axis == 1 ? 1.0f : 0.85f;
+	for (int c = 0; c < 3; ++c)
+		rgb[c] = texel[c] / 255.0f * intensity;
+	return true;
+}
+
+// Marches the four rays of a packet until each hits something or leaves the world.
+// The stepping is done for all lanes at once; block lookups and shading per lane.
+static void march(const uint8_t *(*solid)[WORLD::Y][WORLD::Z], const uint64_t (*bricks)[WORLD::Y][WORLD::Z], Packet &p, float *rgb, bool *hit) {
+	for (int lane = 0; lane < 4; ++lane) {
+		hit[lane] = false;
+		if (p.active[lane])
+			start(p, lane, 0, -1);
+	}
+
+	for (;;) {
+		int live = 0;
+
+		for (int lane = 0; lane < 4; ++lane) {
+			while (p.active[lane]) {
+				int x = p.cell[0].i[lane] - LO[0];
+				int y = p.cell[1].i[lane] - LO[1];
+				int z = p.cell[2].i[lane] - LO[2];
+				if (p.t.f[lane] >= p.end[lane] || (unsigned)x >= (unsigned)SIZE[0] || (unsigned)y >= (unsigned)SIZE[1] || (unsigned)z >= (unsigned)SIZE[2]) {
+					p.active[lane] = false;
+					break;
+				}
+
+				const uint8_t *chunk = solid[x >> SHIFT][y >> SHIFT][z >> SHIFT];
+				int lx = x & (CHUNK::X - 1);
+				int ly = y & (CHUNK::Y - 1);
+				int lz = z & (CHUNK::Z - 1);
+
+				// Jump straight across empty chunks and bricks
+				int shift = !chunk ? SHIFT : !(bricks[x >> SHIFT][y >> SHIFT][z >> SHIFT] >> ((lx >> BRICK) * 16 + (ly >> BRICK) * 4 + (lz >> BRICK)) & 1) ? BRICK : 0;
+				if (shift) {
+					int axis = 0;
+					float leave = leave_cube(p, lane, shift, &axis);
+					start(p, lane, leave, axis);
+					continue;
+				}
+
+				uint8_t type = chunk[(lx * CHUNK::Y + ly) * CHUNK::Z + lz];
+				if (type != BLOCK::AIR) {
+					vec3 point = p.origin[lane] + p.dir[lane] * p.t.f[lane];
+					if (shade(type, p.axis[lane], point, rgb + lane * 3)) {
+						p.depth[lane] = p.t.f[lane];
+						hit[lane] = true;
+						p.active[lane] = false;
+						break;
+					}
+				}
+
+				++live;
+				break;
+			}
+		}
+
+		if (!live)
+			return;
+
+		// One DDA step for every live lane: move across whichever boundary comes first
+		__m128 mask = _mm_castsi128_ps(_mm_set_epi32(p.active[3] ? -1 : 0, p.active[2] ? -1 : 0, p.active[1] ? -1 : 0, p.active[0] ? -1 : 0));
+		__m128 tx = p.tMax[0].v, ty = p.tMax[1].v, tz = p.tMax[2].v;
+		__m128 mx = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(tx, ty), _mm_cmple_ps(tx, tz)), mask);
+		__m128 my = _mm_and_ps(_mm_andnot_ps(mx, _mm_cmple_ps(ty, tz)), mask);
+		__m128 mz = _mm_andnot_ps(_mm_or_ps(mx, my), mask);
+		__m128 m[3] = { mx, my, mz };
+
+		p.t.v = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(tx, _mm_min_ps(ty, tz))), _mm_andnot_ps(mask, p.t.v));
+
+		for (int a = 0; a < 3; ++a) {
+			p.cell[a].v = _mm_add_epi32(p.cell[a].v, _mm_and_si128(p.step[a].v, _mm_castps_si128(m[a])));
+			p.tMax[a].v = _mm_add_ps(p.tMax[a].v, _mm_and_ps(p.tDelta[a].v, m[a]));
+		}
+
+		for (int a = 0; a < 3; ++a) {
+			int bits = _mm_movemask_ps(m[a]);
+			for (int lane = 0; lane < 4; ++lane)
+				if (bits & (1 << lane))
+					p.axis[lane] = a;
+		}
+	}
+}
+
+void Raymarcher::renderTile(const View &view, int tx, int ty, uint8_t *rgba) {
+	int x0 = tx * TILE;
+	int y0 = ty * TILE;
+	int x1 = std::min(x0 + TILE, view.width);
+	int y1 = std::min(y0 + TILE, view.height);
+	long long rays = 0;
+
+	for (int y = y0; y < y1; y += 2) {
+		for (int x = x0; x < x1; x += 2) {
+			Packet p;
+			float rgb[12];
+			bool hit[4];
+
+			for (int lane = 0; lane < 4; ++lane) {
+				int px = x + (lane & 1);
+				int py = y + (lane >> 1);
+				p.active[lane] = px < x1 && py < y1;
+				p.end[lane] = FAR;
+				p.axis[lane] = 1;
+
+				if (view.map) {
+					p.origin[lane] = view.eye + view.right * ((px + 0.5f) * view.scaleX) + view.up * ((py + 0.5f) * view.scaleY);
+					p.dir[lane] = view.forward;
+				}
+				else {
+					float sx = (2 * (px + 0.5f) / view.width - 1) * view.scaleX;
+					float sy = (1 - 2 * (py + 0.5f) / view.height) * view.scaleY;
+					p.origin[lane] = view.eye;
+					p.dir[lane] = normalize(view.forward + view.right * sx + view.up * sy);
+				}
+
+				rays += p.active[lane];
+			}
+
+			bool inside[4] = { p.active[0], p.active[1], p.active[2], p.active[3] };
+			march(_solid, _bricks, p, rgb, hit);
+
+			for (int lane = 0; lane < 4; ++lane) {
+				if (!inside[lane])
+					continue;
+
+				float *c = rgb + lane * 3;
+				if (!hit[lane]) {
+					c[0] = FOG[0];
+					c[1] = FOG[1];
+					c[2] = FOG[2];
+				}
+				else if (view.map) {
+					// Darker further down, so the terrain's relief shows
+					float top = view.eye.y - p.depth[lane];
+					float light = 0.6f + 0.4f * (top - LO[1]) / SIZE[1];
+					for (int i = 0; i < 3; ++i)
+						c[i] *= light;
+				}
+				else {
+					float z = p.depth[lane] * dot(p.dir[lane], view.forward);
+					float fog = std::min(std::max(expf(-FOG_DENSITY * z * z), 0.2f), 1.0f);
+					for (int i = 0; i < 3; ++i)
+						c[i] = FOG[i] + (c[i] - FOG[i]) * fog;
+				}
+
+				uint8_t *out = rgba + ((y + (lane >> 1)) * view.width + x + (lane & 1)) * 4;
+				for (int i = 0; i < 3; ++i)
+					out[i] = (uint8_t)(std::min(std::max(c[i], 0.0f), 1.0f) * 255 + 0.5f);
+				out[3] = 255;
+			}
+		}
+	}
+
+	_rays += rays;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Constants.h"
+#include "ThreadPool.h"
+
+class World;
+class Chunk;
+
+// Renders the world on the CPU by marching rays through the block grid, with the same
+// texture atlas and shading as baseShader. The image is split into tiles that are
+// rendered on the thread pool, each tile tracing 2x2 pixel packets with SSE.
+class Raymarcher {
+public:
+	Raymarcher(const World *world, ThreadPool *pool);
+
+	void renderView(const glm::vec3 &eye, const glm::vec3 &target, float fovy, int width, int height, std::vector<uint8_t> &rgba);
+	void renderMap(float x, float z, float size, int pixels, std::vector<uint8_t> &rgba);
+	long long getRays() const;
+
+private:
+	// Where the rays of an image start and which way they go
+	struct View {
+		bool map;
+		glm::vec3 eye, forward, right, up;
+		float scaleX, scaleY;
+		int width, height;
+	};
+
+	void prepare();
+	void render(const View &view, std::vector<uint8_t> &rgba);
+	void renderTile(const View &view, int tx, int ty, uint8_t *rgba);
+
+	const World *_world;
+	ThreadPool *_pool;
+	// Copy of the world's blocks, chunk after chunk, taken before each image
+	std::vector<uint8_t> _blocks;
+	// Blocks of the generated chunks that hold at least one block, 0 for the rest, which
+	// are skipped whole. Bit (x * 4 + y) * 4 + z of _bricks is set if the 4^3 brick at
+	// x, y, z isn't all air.
+	const uint8_t *_solid[WORLD::X][WORLD::Y][WORLD::Z];
+	uint64_t _bricks[WORLD::X][WORLD::Y][WORLD::Z];
+	std::atomic<long long> _rays;
+};
@@ -0,0 +1,88 @@
+#include "Replay.h"
+
+// File layout, one record per line:
+//   voxelreplay <version>
+//   seed <seed>
+//   e <x> <y> <z> <type>               block edit, applied before the next frame
+//   f <dt> <px> <py> <pz> <ax> <ay>    frame
+static const int VERSION = 1;
+
+ReplayRecorder::ReplayRecorder() : _file(0) {
+}
+
+ReplayRecorder::~ReplayRecorder() {
+	close();
+}
+
+bool ReplayRecorder::open(const char *filename, time_t seed) {
+	close();
+
+	_file = fopen(filename, "w");
+	if (!_file)
+		return false;
+
+	fprintf(_file, "voxelreplay %d\n", VERSION);
+	fprintf(_file, "seed %lld\n", (long long)seed);
+	return true;
+}
+
+void ReplayRecorder::frame(float dt, const glm::vec3 &position, const glm::vec3 &angle) {
+	if (_file)
+		fprintf(_file, "f %.9g %.9g %.9g %.9g %.9g %.9g\n", dt, position.x, position.y, position.z, angle.x, angle.y);
+}
+
+void ReplayRecorder::edit(int x, int y, int z, uint8_t type) {
+	if (_file)
+		fprintf(_file, "e %d %d %d %d\n", x, y, z, type);
+}
+
+void ReplayRecorder::close() {
+	if (_file)
+		fclose(_file);
+	_file = 0;
+}
+
+bool Replay::load(const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (!file)
+		return false;
+
+	int version = 0;
+	long long s = 0;
+	if (fscanf(file, "voxelreplay %d seed %lld", &version, &s) != 2 || version != VERSION) {
+		fprintf(stderr, "%s: not a replay file\n", filename);
+		fclose(file);
+		return false;
+	}
+
+	seed = (time_t)s;
+	frames.clear();
+
+	std::vector<ReplayEdit> edits;
+	char kind;
+
+	while (fscanf(file, " %c", &kind) == 1) {
+		if (kind == 'e') {
+			ReplayEdit edit;
+			int type;
+			if (fscanf(file, "%d %d %d %d", &edit.x, &edit.y, &edit.z, &type) != 4)
+				break;
+			edit.type = type;
+			edits.push_back(edit);
+		}
+		else if (kind == 'f') {
+			ReplayFrame frame;
+			if (fscanf(file, "%f %f %f %f %f %f", &frame.dt, &frame.position.x, &frame.position.y, &frame.position.z, &frame.angle.x, &frame.angle.y) != 6)
+				break;
+			frame.angle.z = 0;
+			frame.edits.swap(edits);
+			frames.push_back(frame);
+		}
+		else {
+			break;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct ReplayEdit {
+	int x, y, z;
+	uint8_t type;
+};
+
+// One recorded frame: the camera after that frame's input,
+// and the block edits made since the previous frame.
+struct ReplayFrame {
+	float dt;
+	glm::vec3 position;
+	glm::vec3 angle;
+	std::vector<ReplayEdit> edits;
+};
+
+// Writes the camera path and block edits to a text file as they happen.
+class ReplayRecorder {
+public:
+	ReplayRecorder();
+	~ReplayRecorder();
+	bool open(const char *filename, time_t seed);
+	void frame(float dt, const glm::vec3 &position, const glm::vec3 &angle);
+	void edit(int x, int y, int z, uint8_t type);
+	void close();
+
+private:
+	FILE *_file;
+};
+
+// A recording read back into memory.
+class Replay {
+public:
+	bool load(const char *filename);
+
+	time_t seed;
+	std::vector<ReplayFrame> frames;
+};
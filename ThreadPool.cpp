@@ -0,0 +1,80 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads) : _task(0), _next(0), _count(0), _busy(0), _generation(0), _quit(false) {
+	if (threads <= 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+
+	// The caller is one of the workers
+	for (int i = 1; i < threads; ++i)
+		_threads.push_back(std::thread(&ThreadPool::worker, this));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+
+	for (size_t i = 0; i < _threads.size(); ++i)
+		_threads[i].join();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &task) {
+	if (count <= 0)
+		return;
+
+	// Not worth waking anyone for a single item
+	if (count == 1 || _threads.empty()) {
+		for (int i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_task = &task;
+		_count = count;
+		_next = 0;
+		_busy = (int)_threads.size();
+		++_generation;
+	}
+	_wake.notify_all();
+
+	drain();
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this] { return _busy == 0; });
+	_task = 0;
+}
+
+int ThreadPool::size() const {
+	return (int)_threads.size() + 1;
+}
+
+void ThreadPool::worker() {
+	unsigned seen = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&] { return _quit || _generation != seen; });
+			if (_quit)
+				return;
+			seen = _generation;
+		}
+
+		drain();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_busy == 0)
+			_done.notify_one();
+	}
+}
+
+void ThreadPool::drain() {
+	for (int i = _next++; i < _count; i = _next++)
+		(*_task)(i);
+}
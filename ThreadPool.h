@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run index ranges in parallel.
+// The calling thread takes part in the work, so a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+	ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	// Calls task(i) for every i in [0, count) and returns when all calls are done.
+	void parallelFor(int count, const std::function<void(int)> &task);
+	int size() const;
+
+private:
+	void worker();
+	void drain();
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _wake, _done;
+	const std::function<void(int)> *_task;
+	std::atomic<int> _next;
+	int _count, _busy;
+	unsigned _generation;
+	bool _quit;
+};
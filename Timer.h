@@ -0,0 +1,9 @@
+#pragma once
+
+#include <chrono>
+
+// Monotonic wall-clock time in milliseconds, for profiling and fixed-rate loops.
+static inline double now_ms() {
+	using namespace std::chrono;
+	return duration_cast<duration<double, std::milli>>(steady_clock::now().time_since_epoch()).count();
+}
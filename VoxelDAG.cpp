@@ -0,0 +1,170 @@
+#include <string.h>
+
+#include "VoxelDAG.h"
+
+static_assert(CHUNK::X == CHUNK::Y && CHUNK::Y == CHUNK::Z && (CHUNK::X & (CHUNK::X - 1)) == 0,
+	"VoxelDAG needs cubic chunks with a power of two size");
+
+static inline int index(int x, int y, int z) {
+	return (x * CHUNK::Y + y) * CHUNK::Z + z;
+}
+
+// Marks for slots of the hash table
+static const uint32_t EMPTY = 0xffffffffu;
+static const uint32_t DELETED = 0xfffffffeu;
+
+static inline size_t hash(const uint32_t *child) {
+	uint32_t h = 2166136261u;
+	for (int i = 0; i < 8; ++i)
+		h = (h ^ child[i]) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+bool VoxelDAG::Node::operator==(const Node &other) const {
+	return !memcmp(child, other.child, sizeof(child));
+}
+
+VoxelDAG::VoxelDAG() : _used(0), _deleted(0) {
+	_table.assign(1024, EMPTY);
+}
+
+// Turns a dense chunk ([X][Y][Z] blocks) into a tree and returns its root reference.
+// The caller owns one reference to the root and hands it back with release().
+uint32_t VoxelDAG::build(const uint8_t *block) {
+	return build(block, 0, 0, 0, CHUNK::X);
+}
+
+// Writes the tree at root back into a dense chunk.
+void VoxelDAG::expand(uint32_t root, uint8_t *block) const {
+	expand(root, block, 0, 0, 0, CHUNK::X);
+}
+
+// Drops one reference to a tree; nodes nobody refers to any more are freed.
+void VoxelDAG::release(uint32_t ref) {
+	if (ref & LEAF)
+		return;
+
+	if (--_refs[ref])
+		return;
+
+	Node node = _nodes[ref];
+	_table[find(node)] = DELETED;
+	--_used;
+	++_deleted;
+	_free.push_back(ref);
+
+	for (int i = 0; i < 8; ++i)
+		release(node.child[i]);
+}
+
+// Number of nodes in use.
+int VoxelDAG::getNodes() const {
+	return (int)(_nodes.size() - _free.size());
+}
+
+// Memory held by the nodes, their reference counts and the dedup index.
+size_t VoxelDAG::getBytes() const {
+	return _nodes.capacity() * (sizeof(Node) + sizeof(uint32_t)) + (_table.size() + _free.capacity()) * sizeof(uint32_t);
+}
+
+uint32_t VoxelDAG::build(const uint8_t *block, int x, int y, int z, int size) {
+	if (size == 1)
+		return LEAF | block[index(x, y, z)];
+
+	int half = size / 2;
+	Node node;
+	bool uniform = true;
+
+	for (int i = 0; i < 8; ++i) {
+		node.child[i] = build(block, x + (i & 1 ? half : 0), y + (i & 2 ? half : 0), z + (i & 4 ? half : 0), half);
+		uniform = uniform && node.child[i] == node.child[0];
+	}
+
+	// Eight equal leaves collapse into one; equal inner nodes still need a parent
+	if (uniform && (node.child[0] & LEAF))
+		return node.child[0];
+
+	return intern(node);
+}
+
+void VoxelDAG::expand(uint32_t ref, uint8_t *block, int x, int y, int z, int size) const {
+	if (ref & LEAF) {
+		for (int i = x; i < x + size; ++i)
+			for (int j = y; j < y + size; ++j)
+				memset(block + index(i, j, z), ref & 0xff, size);
+		return;
+	}
+
+	int half = size / 2;
+	const Node &node = _nodes[ref];
+	for (int i = 0; i < 8; ++i)
+		expand(node.child[i], block, x + (i & 1 ? half : 0), y + (i & 2 ? half : 0), z + (i & 4 ? half : 0), half);
+}
+
+// Returns the shared copy of node, adding it if it is new. The node's child references
+// are handed over: kept by a new node, dropped again if an equal node already exists.
+uint32_t VoxelDAG::intern(const Node &node) {
+	size_t slot = find(node);
+	if (_table[slot] != EMPTY) {
+		uint32_t found = _table[slot];
+		for (int i = 0; i < 8; ++i)
+			release(node.child[i]);
+		++_refs[found];
+		return found;
+	}
+
+	uint32_t ref;
+	if (!_free.empty()) {
+		ref = _free.back();
+		_free.pop_back();
+		_nodes[ref] = node;
+		_refs[ref] = 1;
+	}
+	else {
+		ref = (uint32_t)_nodes.size();
+		_nodes.push_back(node);
+		_refs.push_back(1);
+	}
+
+	// Keep the table at most half full, counting deleted slots
+	if ((_used + _deleted + 1) * 2 > _table.size()) {
+		rehash(_used * 4 > _table.size() ? _table.size() * 2 : _table.size());
+		slot = find(node);
+	}
+
+	_table[slot] = ref;
+	++_used;
+	return ref;
+}
+
+// Slot holding node, or the empty slot where it would go.
+size_t VoxelDAG::find(const Node &node) const {
+	size_t mask = _table.size() - 1;
+	size_t slot = hash(node.child) & mask;
+
+	while (_table[slot] != EMPTY) {
+		if (_table[slot] != DELETED && _nodes[_table[slot]] == node)
+			return slot;
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+void VoxelDAG::rehash(size_t size) {
+	std::vector<uint32_t> old;
+	old.swap(_table);
+	_table.assign(size, EMPTY);
+	_deleted = 0;
+
+	size_t mask = size - 1;
+	for (size_t i = 0; i < old.size(); ++i) {
+		if (old[i] == EMPTY || old[i] == DELETED)
+			continue;
+
+		size_t slot = hash(_nodes[old[i]].child) & mask;
+		while (_table[slot] != EMPTY)
+			slot = (slot + 1) & mask;
+		_table[slot] = old[i];
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "Constants.h"
+
+// Sparse voxel octree storage for chunks, with identical subtrees shared between
+// all chunks that use the same VoxelDAG. A reference is either a node index, or,
+// with LEAF set, a uniform region of one block type.
+class VoxelDAG {
+public:
+	static const uint32_t LEAF = 0x80000000u;
+
+	VoxelDAG();
+
+	uint32_t build(const uint8_t *block);
+	void expand(uint32_t root, uint8_t *block) const;
+	void release(uint32_t ref);
+
+	// Block at chunk-local (x, y, z) of the tree at root
+	uint8_t getBlock(uint32_t root, int x, int y, int z) const {
+		uint32_t ref = root;
+		for (int size = CHUNK::X / 2; !(ref & LEAF); size /= 2) {
+			int child = ((x & size) ? 1 : 0) | ((y & size) ? 2 : 0) | ((z & size) ? 4 : 0);
+			ref = _nodes[ref].child[child];
+		}
+		return ref & 0xff;
+	}
+
+	int getNodes() const;
+	size_t getBytes() const;
+
+private:
+	struct Node {
+		uint32_t child[8];
+
+		bool operator==(const Node &other) const;
+	};
+
+	uint32_t build(const uint8_t *block, int x, int y, int z, int size);
+	void expand(uint32_t ref, uint8_t *block, int x, int y, int z, int size) const;
+	uint32_t intern(const Node &node);
+	size_t find(const Node &node) const;
+	void rehash(size_t size);
+
+	std::vector<Node> _nodes;
+	std::vector<uint32_t> _refs;
+	std::vector<uint32_t> _free;
+	// Open addressing hash set of node indices, used to find shared nodes
+	std::vector<uint32_t> _table;
+	size_t _used, _deleted;
+};
@@ -1,9 +1,40 @@
+#include <algorithm>
+
 #include "World.h"
+#include "ChunkClient.h"
+#include "MeshCache.h"
+#include "Timer.h"
 
 using namespace glm;
 
 World::World() {
 	time(&_seed);
+	init();
+}
+
+// A world with a fixed seed, for runs that have to be repeatable.
+World::World(time_t seed) : _seed(seed) {
+	init();
+}
+
+void World::init() {
+	_headless = false;
+	_pulling = false;
+	_client = 0;
+	_meshCache = 0;
+	_heading = vec3(0);
+	memset(_keyVersion, 0, sizeof(_keyVersion));
+	_budget = RenderBudget();
+	memset(&_stats, 0, sizeof(_stats));
+	_policy = StoragePolicy();
+	_storageFrame = 0;
+	memset(_seenVersion, 0, sizeof(_seenVersion));
+	memset(_changedAt, 0, sizeof(_changedAt));
+
+	for (int x = 0; x < WORLD::X * CHUNK::X; ++x)
+		for (int z = 0; z < WORLD::Z * CHUNK::Z; ++z)
+			_height[x][z] = WORLD::NO_SURFACE;
+
 	for (int x = 0; x < WORLD::X; ++x) {
 		for (int y = 0; y < WORLD::Y; ++y) {
 			for (int z = 0; z < WORLD::Z; ++z) {
@@ -42,88 +73,501 @@ World::~World() {
 	}
 }
 
-uint8_t World::getBlock(int x, int y, int z) const {
-	int cx = (x + CHUNK::X * (WORLD::X / 2)) / CHUNK::X;
-	int cy = (y + CHUNK::Y * (WORLD::Y / 2)) / CHUNK::Y;
-	int cz = (z + CHUNK::Z * (WORLD::Z / 2)) / CHUNK::Z;
+// Rounds towards negative infinity, where / rounds towards zero and would put the blocks
+// just outside the world's low edge into its first chunk.
+static int floor_div(int a, int b) {
+	return (a < 0 ? a - (b - 1) : a) / b;
+}
+
+// Grid index of the chunk holding the block at world coordinates (x, y, z); false outside
+// the world.
+bool World::locate(int x, int y, int z, int *cx, int *cy, int *cz) {
+	*cx = floor_div(x, CHUNK::X) + WORLD::X / 2;
+	*cy = floor_div(y, CHUNK::Y) + WORLD::Y / 2;
+	*cz = floor_div(z, CHUNK::Z) + WORLD::Z / 2;
+	return (unsigned)*cx < (unsigned)WORLD::X && (unsigned)*cy < (unsigned)WORLD::Y && (unsigned)*cz < (unsigned)WORLD::Z;
+}
 
-	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz <= 0 || cz >= WORLD::Z)
+uint8_t World::getBlock(int x, int y, int z) const {
+	int cx, cy, cz;
+	if (!locate(x, y, z, &cx, &cy, &cz))
 		return 0;
 
 	return _chunk[cx][cy][cz]->getBlock(x & (CHUNK::X - 1), y & (CHUNK::Y - 1), z & (CHUNK::Z - 1));
 }
 
 void World::setBlock(int x, int y, int z, uint8_t type) {
-	int cx = (x + CHUNK::X * (WORLD::X / 2)) / CHUNK::X;
-	int cy = (y + CHUNK::Y * (WORLD::Y / 2)) / CHUNK::Y;
-	int cz = (z + CHUNK::Z * (WORLD::Z / 2)) / CHUNK::Z;
-
-	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz <= 0 || cz >= WORLD::Z)
+	int cx, cy, cz;
+	if (!locate(x, y, z, &cx, &cy, &cz))
 		return;
 
 	_chunk[cx][cy][cz]->setBlock(x & (CHUNK::X - 1), y & (CHUNK::Y - 1), z & (CHUNK::Z - 1), type);
+	edited(cx, cy, cz, x, y, z, type);
 }
 
-void World::render(const mat4 &pv) {
-	float ud = 999999.0f;
-	int ux = -1;
-	int uy = -1;
-	int uz = -1;
+// Bookkeeping for a block changed at (x, y, z) in the chunk at grid index (cx, cy, cz).
+void World::edited(int cx, int cy, int cz, int x, int y, int z, uint8_t type) {
+	_memory.use((cx * WORLD::Y + cy) * WORLD::Z + cz);
+	updateHeight(x, y, z, type);
+}
+
+// Chunk at grid index (cx, cy, cz), or 0 outside the world.
+Chunk *World::getChunk(int cx, int cy, int cz) const {
+	if (cx < 0 || cx >= WORLD::X || cy < 0 || cy >= WORLD::Y || cz < 0 || cz >= WORLD::Z)
+		return 0;
+
+	return _chunk[cx][cy][cz];
+}
+
+// Chunk containing the block at world coordinates (x, y, z), or 0 outside the world.
+Chunk *World::findChunk(int x, int y, int z) const {
+	int cx, cy, cz;
+	return locate(x, y, z, &cx, &cy, &cz) ? _chunk[cx][cy][cz] : 0;
+}
+
+// Generates the terrain of chunk, if that hasn't happened yet, and raises the heights of
+// its columns to the blocks it got.
+void World::generate(Chunk *chunk) {
+	if (chunk->isNoised())
+		return;
+
+	chunk->noise(_seed);
+
+	for (int x = 0; x < CHUNK::X; ++x) {
+		for (int z = 0; z < CHUNK::Z; ++z) {
+			short &height = _height[(chunk->getX() + WORLD::X / 2) * CHUNK::X + x][(chunk->getZ() + WORLD::Z / 2) * CHUNK::Z + z];
+
+			for (int y = CHUNK::Y - 1; y >= 0; --y) {
+				if (chunk->getBlock(x, y, z) != BLOCK::AIR) {
+					height = std::max<short>(height, chunk->getY() * CHUNK::Y + y);
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Fills the chunk at grid index (cx, cy, cz) with blocks ([X][Y][Z] blocks) that came
+// from elsewhere, e.g. a server. It is meshed and drawn once its neighbours are in too.
+void World::load(int cx, int cy, int cz, const uint8_t *blocks) {
+	Chunk *chunk = getChunk(cx, cy, cz);
+	if (!chunk)
+		return;
+
+	chunk->setBlocks(blocks, (int)_seed);
+
+	for (int x = 0; x < CHUNK::X; ++x)
+		for (int z = 0; z < CHUNK::Z; ++z)
+			rescanHeight(cx * CHUNK::X + x, cz * CHUNK::Z + z, CHUNK::Y * (WORLD::Y / 2) - 1);
+}
+
+// With a client set, the world is a cache of a server's: render() requests chunks from
+// it instead of generating them, and they appear once client->poll() receives them.
+void World::setClient(ChunkClient *client) {
+	_client = client;
+}
+
+// Meshes are read from cache when it has them and added to it when not.
+void World::setMeshCache(MeshCache *cache) {
+	_meshCache = cache;
+}
+
+// Highest non-air block in the column at (x, z), WORLD::NO_SURFACE for empty
+// columns and outside the world.
+int World::getHeight(int x, int z) const {
+	x += CHUNK::X * (WORLD::X / 2);
+	z += CHUNK::Z * (WORLD::Z / 2);
+
+	if ((unsigned)x >= (unsigned)(WORLD::X * CHUNK::X) || (unsigned)z >= (unsigned)(WORLD::Z * CHUNK::Z))
+		return WORLD::NO_SURFACE;
+
+	return _height[x][z];
+}
+
+// Heights of the width x depth columns starting at (x, z), written row by row along x.
+void World::getHeights(int x, int z, int width, int depth, int *heights) const {
+	for (int j = 0; j < depth; ++j)
+		for (int i = 0; i < width; ++i)
+			heights[j * width + i] = getHeight(x + i, z + j);
+}
+
+// Keeps the column height at (x, z) up to date after the block at (x, y, z) became type.
+// Anything that writes blocks past setBlock has to call this itself.
+void World::updateHeight(int x, int y, int z, uint8_t type) {
+	int hx = x + CHUNK::X * (WORLD::X / 2);
+	int hz = z + CHUNK::Z * (WORLD::Z / 2);
+
+	if ((unsigned)hx >= (unsigned)(WORLD::X * CHUNK::X) || (unsigned)hz >= (unsigned)(WORLD::Z * CHUNK::Z))
+		return;
+
+	short &height = _height[hx][hz];
+	if (type != BLOCK::AIR && y > height)
+		height = y;
+	else if (type == BLOCK::AIR && y == height)
+		rescanHeight(hx, hz, y - 1);
+}
+
+// Walks down the column at heightmap index (x, z) from top for the next non-air block.
+void World::rescanHeight(int x, int z, int top) {
+	int lx = x & (CHUNK::X - 1);
+	int lz = z & (CHUNK::Z - 1);
+	int bottom = -CHUNK::Y * (WORLD::Y / 2);
+
+	for (int y = top; y >= bottom; --y) {
+		Chunk *chunk = _chunk[x / CHUNK::X][(y - bottom) / CHUNK::Y][z / CHUNK::Z];
+
+		// Chunks that aren't generated yet hold no blocks
+		if (!chunk->isNoised()) {
+			y -= (y - bottom) % CHUNK::Y;
+			continue;
+		}
+
+		if (chunk->getBlock(lx, (y - bottom) % CHUNK::Y, lz) != BLOCK::AIR) {
+			_height[x][z] = y;
+			return;
+		}
+	}
+
+	_height[x][z] = WORLD::NO_SURFACE;
+}
+
+time_t World::getSeed() const {
+	return _seed;
+}
+
+// In headless mode render() generates and meshes chunks as usual but makes no GL calls,
+// so the CPU side of a frame can be measured without a context.
+void World::setHeadless(bool headless) {
+	_headless = headless;
+}
+
+// Uploads meshes as packed faces for pullShader.vert rather than as vertices. Set before
+// the first render(), with the pulling program in use for it.
+void World::setPulling(bool pulling) {
+	_pulling = pulling;
+}
+
+const FrameStats &World::getStats() const {
+	return _stats;
+}
+
+// Queues the chunks around eye that need loading for render() to load, most urgent first:
+// near ones, those in front of the camera and those it is moving towards. Call once per
+// frame before render().
+void World::schedule(const vec3 &eye, const vec3 &forward, const vec3 &velocity) {
+	float radius = std::min(_budget.distance, LOAD::RADIUS);
+	_scheduler.update(this, eye, forward, velocity, radius);
+
+	// Chunks asked for from the server that left the radius aren't wanted any more, and
+	// those still wanted are sent in the order they are now needed
+	if (_client) {
+		int cx, cy, cz;
+		while (_scheduler.nextCancelled(&cx, &cy, &cz))
+			_client->cancel(cx, cy, cz);
+		_client->prioritize(_scheduler.getInFlight());
+	}
+
+	// No further than half the view, so what is read ahead is still in range when it's used
+	vec3 step = velocity * MESH_CACHE::LOOKAHEAD;
+	float length = glm::length(step);
+	_heading = length > radius / 2 ? step * (radius / 2 / length) : step;
+}
+
+// Is the chunk at grid index (cx, cy, cz) on its way from the server?
+bool World::isLoading(int cx, int cy, int cz) const {
+	return _client && _client->isRequested(cx, cy, cz) && !_chunk[cx][cy][cz]->isNoised();
+}
+
+// Limits how far render() draws and how much generation and meshing it does per frame.
+void World::setBudget(const RenderBudget &budget) {
+	_budget = budget;
+}
+
+const RenderBudget &World::getBudget() const {
+	return _budget;
+}
+
+// Moves chunks between storage forms and keeps their memory within the limits, as
+// eye moves and they are edited. Called once a frame.
+void World::updateStorage(const vec3 &eye) {
+	if (_policy.budget)
+		updateTiers(eye);
+	_memory.update(&_chunk[0][0][0], WORLD::X * WORLD::Y * WORLD::Z, eye, _policy.hotDistance, _vertices.capacity() * sizeof(byte4));
+}
+
+// Follows the storage policy: cold chunks are compressed, far ones compacted further, and
+// chunks that came near again expanded. Converts at most the policy's budget of chunks.
+void World::updateTiers(const vec3 &eye) {
+	++_storageFrame;
+	int budget = _policy.budget;
 
 	for (int x = 0; x < WORLD::X; ++x) {
 		for (int y = 0; y < WORLD::Y; ++y) {
 			for (int z = 0; z < WORLD::Z; ++z) {
-				mat4 model = translate(mat4(1.0f), vec3(_chunk[x][y][z]->getX() * CHUNK::X, _chunk[x][y][z]->getY() * CHUNK::Y, _chunk[x][y][z]->getZ() * CHUNK::Z));
-				mat4 mvp = pv * model;
+				Chunk *chunk = _chunk[x][y][z];
+				if (!chunk->isNoised())
+					continue;
 
-				// Is this chunk on the screen?
-				vec4 center = mvp * vec4(CHUNK::X / 2, CHUNK::Y / 2, CHUNK::Z / 2, 1);
+				// Every chunk is looked at each call so no change goes unseen
+				if (chunk->getVersion() != _seenVersion[x][y][z]) {
+					_seenVersion[x][y][z] = chunk->getVersion();
+					_changedAt[x][y][z] = _storageFrame;
+				}
+				if (!budget)
+					continue;
 
-				float d = length(center);
-				center.x /= center.w;
-				center.y /= center.w;
+				vec3 center = vec3(chunk->getX() * CHUNK::X, chunk->getY() * CHUNK::Y, chunk->getZ() * CHUNK::Z) + vec3(CHUNK::X, CHUNK::Y, CHUNK::Z) * 0.5f;
+				float distance = length(center - eye);
+				bool near = distance <= _policy.hotDistance;
+				bool hot = near || _storageFrame - _changedAt[x][y][z] < (uint32_t)_policy.hotFrames;
 
-				// If it is behind the camera, don't bother drawing it
-				if (center.z < -CHUNK::Y / 2)
+				// Chunks changed lately are only kept as they are; the write expanded them,
+				// unless the memory budget has evicted them since
+				if (hot) {
+					if (near && chunk->isCompact()) {
+						chunk->expand();
+						--budget;
+					}
+				}
+				else if (chunk->isChanged())
 					continue;
+				else if (distance > _policy.farDistance) {
+					ChunkStorage storage = chunk->getStorage();
+					if (storage == STORAGE_DENSE || storage == STORAGE_RUNS) {
+						if (!chunk->makeProcedural())
+							chunk->compact(&_dag);
+						--budget;
+					}
+				}
+				else if (chunk->getStorage() == STORAGE_DENSE) {
+					chunk->compress();
+					--budget;
+				}
+			}
+		}
+	}
+}
+
+void World::setStoragePolicy(const StoragePolicy &policy) {
+	_policy = policy;
+}
+
+const StoragePolicy &World::getStoragePolicy() const {
+	return _policy;
+}
+
+void World::setMemoryLimits(const MemoryLimits &limits) {
+	_memory.setLimits(limits);
+}
 
-				// If it is outside the screen, don't bother drawing it
-				if (fabsf(center.x) > 1 + fabsf(CHUNK::Y * 2 / center.w) || fabsf(center.y) > 1 + fabsf(CHUNK::Y * 2 / center.w))
+const MemoryStats &World::getMemoryStats() const {
+	return _memory.getStats();
+}
+
+// Is chunk on the screen pv projects to, widened by margin screen widths on every side,
+// and no further than the budget allows? Sets distance to how far it is, for drawing near
+// chunks first.
+bool World::isVisible(const mat4 &pv, Chunk *chunk, float *distance, float margin) const {
+	mat4 model = translate(mat4(1.0f), vec3(chunk->getX() * CHUNK::X, chunk->getY() * CHUNK::Y, chunk->getZ() * CHUNK::Z));
+	mat4 mvp = pv * model;
+
+	vec4 center = mvp * vec4(CHUNK::X / 2, CHUNK::Y / 2, CHUNK::Z / 2, 1);
+
+	*distance = length(center);
+	center.x /= center.w;
+	center.y /= center.w;
+
+	// If it is behind the camera, don't bother drawing it
+	if (center.z < -CHUNK::Y / 2)
+		return false;
+
+	// Nor if it is further away than the budget allows
+	if (center.w > _budget.distance + CHUNK::Y)
+		return false;
+
+	// If it is outside the screen, don't bother drawing it
+	float edge = 1 + 2 * margin + fabsf(CHUNK::Y * 2 / center.w);
+	return fabsf(center.x) <= edge && fabsf(center.y) <= edge;
+}
+
+// Has the mesh cache read ahead the meshes of the chunks ready to mesh that will come into
+// view as the camera moves along its heading, those seen soonest and nearest first, as
+// many as the budget allows. pv is the view now; it is widened, as the camera may turn.
+// Chunks are asked for every frame until they are meshed, which keeps what was read for
+// them from being dropped; the key, the hash meshing will look up, is only taken again
+// when the chunk changes.
+void World::prefetchMeshes(const mat4 &pv) {
+	mat4 views[MESH_CACHE::STEPS + 1];
+	for (int i = 0; i <= MESH_CACHE::STEPS; ++i)
+		views[i] = pv * translate(mat4(1.0f), -_heading * ((float)i / MESH_CACHE::STEPS));
+
+	std::vector<std::pair<float, int> > candidates;
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				Chunk *chunk = _chunk[x][y][z];
+				if (!chunk->isChanged() || !chunk->isReady())
 					continue;
 
-				// If this chunk is not initialized, skip it
-				if (!_chunk[x][y][z]->isInitialized()) {
-					// But if it is the closest to the camera, mark it for initialization
-					if (ux < 0 || d < ud) {
-						ud = d;
-						ux = x;
-						uy = y;
-						uz = z;
+				// Distances on the screen stay well under the furthest a step is worth
+				float d;
+				for (int i = 0; i <= MESH_CACHE::STEPS; ++i) {
+					if (isVisible(views[i], chunk, &d, MESH_CACHE::MARGIN)) {
+						candidates.push_back(std::make_pair(i * 1e6f + d, (x * WORLD::Y + y) * WORLD::Z + z));
+						break;
 					}
-					continue;
 				}
+			}
+		}
+	}
+
+	int count = std::min((int)candidates.size(), _budget.prefetch);
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+	std::vector<uint64_t> keys(count);
+	ChunkSnapshot snapshot;
+	for (int i = 0; i < count; ++i) {
+		int index = candidates[i].second;
+		int x = index / (WORLD::Y * WORLD::Z), y = index / WORLD::Z % WORLD::Y, z = index % WORLD::Z;
+		if (_keyVersion[x][y][z] != _chunk[x][y][z]->getVersion() + 1) {
+			_chunk[x][y][z]->takeSnapshot(&snapshot);
+			_meshKey[x][y][z] = MeshCache::key(snapshot);
+			_keyVersion[x][y][z] = _chunk[x][y][z]->getVersion() + 1;
+		}
+		keys[i] = _meshKey[x][y][z];
+	}
+
+	if (count)
+		_meshCache->prefetch(&keys[0], count);
+	_stats.prefetched = count;
+}
+
+StorageStats World::getStorageStats() const {
+	StorageStats stats;
+	memset(&stats, 0, sizeof(stats));
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				const Chunk *chunk = _chunk[x][y][z];
+				ChunkStorage storage = chunk->getStorage();
+				++stats.chunks[storage];
+				stats.bytes[storage] += chunk->getBytes();
+			}
+		}
+	}
+	stats.bytes[STORAGE_DAG] += _dag.getBytes();
+	return stats;
+}
+
+void World::render(const mat4 &pv) {
+	memset(&_stats, 0, sizeof(_stats));
+	if (_vertices.empty())
+		_vertices.resize(CHUNK::VERTICES);
+
+	// Chunks on screen by distance
+	std::vector<std::pair<float, Chunk *> > visible;
+
+	for (int x = 0; x < WORLD::X; ++x) {
+		for (int y = 0; y < WORLD::Y; ++y) {
+			for (int z = 0; z < WORLD::Z; ++z) {
+				float d;
+				if (!isVisible(pv, _chunk[x][y][z], &d))
+					continue;
 
-				glUniformMatrix4fv(PROGRAM::uniform_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+				// If this chunk or a neighbour isn't generated yet, skip it; the scheduler will
+				// get to it
+				if (!_chunk[x][y][z]->isReady())
+					continue;
 
-				_chunk[x][y][z]->render();
+				visible.push_back(std::make_pair(d, _chunk[x][y][z]));
+				_memory.use((x * WORLD::Y + y) * WORLD::Z + z);
 			}
 		}
 	}
 
-	if (ux >= 0) {
-		_chunk[ux][uy][uz]->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(LEFT))
-			_chunk[ux][uy][uz]->getNeighbour(LEFT)->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(RIGHT))
-			_chunk[ux][uy][uz]->getNeighbour(RIGHT)->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(BELOW))
-			_chunk[ux][uy][uz]->getNeighbour(BELOW)->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(ABOVE))
-			_chunk[ux][uy][uz]->getNeighbour(ABOVE)->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(FRONT))
-			_chunk[ux][uy][uz]->getNeighbour(FRONT)->noise(_seed);
-		if (_chunk[ux][uy][uz]->getNeighbour(BACK))
-			_chunk[ux][uy][uz]->getNeighbour(BACK)->noise(_seed);
-		_chunk[ux][uy][uz]->initialize();
+	// Near chunks are meshed first; the rest keep their old mesh until a later frame
+	std::sort(visible.begin(), visible.end());
+	for (size_t i = 0; i < visible.size(); ++i) {
+		Chunk *chunk = visible[i].second;
+		if (!chunk->isChanged())
+			continue;
+		if (_stats.meshed >= _budget.mesh) {
+			++_stats.deferred;
+			continue;
+		}
+
+		double t = now_ms();
+		int count = chunk->mesh(&_vertices[0], _meshCache);
+		_stats.mesh += now_ms() - t;
+		++_stats.meshed;
+
+		if (!_headless) {
+			t = now_ms();
+			if (_pulling)
+				chunk->uploadFaces(&_vertices[0], count);
+			else
+				chunk->upload(&_vertices[0], count);
+			_stats.upload += now_ms() - t;
+		}
+	}
+
+	// The camera is the point pv sends to w = 0 on the view axis
+	vec4 camera = inverse(pv) * vec4(0, 0, 1, 0);
+	vec3 eye = vec3(camera.x, camera.y, camera.z) / camera.w;
+
+	for (size_t i = 0; i < visible.size(); ++i) {
+		Chunk *chunk = visible[i].second;
+		vec3 origin(chunk->getX() * CHUNK::X, chunk->getY() * CHUNK::Y, chunk->getZ() * CHUNK::Z);
+
+		// Only the directions that can face the camera are drawn
+		int faces = Chunk::facing(eye - origin);
+
+		++_stats.chunks;
+		int count = chunk->getVertexCount(faces);
+		if (count) {
+			++_stats.drawCalls;
+			_stats.vertices += count;
+		}
+
+		if (_headless)
+			continue;
+
+		double t = now_ms();
+		mat4 mvp = pv * translate(mat4(1.0f), origin);
+		glUniformMatrix4fv(PROGRAM::uniform_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+
+		chunk->render(faces);
+		_stats.draw += now_ms() - t;
+	}
+
+	// Load the chunks the scheduler wants most, as many as the budget allows
+	int ux, uy, uz;
+	for (int i = 0; i < _budget.generate && _scheduler.next(&ux, &uy, &uz); ++i) {
+		Chunk *chunk = _chunk[ux][uy][uz];
+
+		if (_client) {
+			// The neighbours come along so the chunk meshes against them once they are all in
+			static const int step[7][3] = { { 0, 0, 0 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+			for (int s = 0; s < 7; ++s) {
+				_client->request(ux + step[s][0], uy + step[s][1], uz + step[s][2]);
+				_scheduler.requested(ux + step[s][0], uy + step[s][1], uz + step[s][2]);
+			}
+			continue;
+		}
+
+		// Meshing needs the chunk and its neighbours generated; those that already are
+		// are skipped, and every chunk this completes is released, not just this one
+		double t = now_ms();
+		generate(chunk);
+		for (int o = FRONT; o <= RIGHT; ++o)
+			if (chunk->getNeighbour((Orientation)o))
+				generate(chunk->getNeighbour((Orientation)o));
+		_stats.generate += now_ms() - t;
+		++_stats.generated;
 	}
+
+	// What will be in view from where the camera is heading is read while the next frames
+	// are on their way
+	if (_meshCache && _budget.prefetch > 0)
+		prefetchMeshes(pv);
 }
\ No newline at end of file
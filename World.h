@@ -1,23 +1,140 @@
 #pragma once
 
 #include <time.h>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Constants.h"
 #include "Chunk.h"
+#include "ChunkScheduler.h"
+#include "MemoryBudget.h"
+
+class ChunkClient;
+class MeshCache;
+
+// Where the time of the last World::render went, in milliseconds.
+struct FrameStats {
+	double generate, mesh, upload, draw;
+	int chunks, drawCalls, vertices;
+	// Chunks loaded and meshed, and changed chunks left for a later frame
+	int generated, meshed, deferred;
+	// Chunks whose cached meshes were asked to be read ahead
+	int prefetched;
+};
+
+// How much World::render may do in one frame. The defaults draw everything in range of
+// the world and load one chunk per frame.
+struct RenderBudget {
+	// Distance from the camera, in blocks, past which chunks aren't drawn
+	float distance;
+	// Chunks loaded per frame
+	int generate;
+	// Changed chunks meshed and uploaded per frame, nearest first
+	int mesh;
+	// Chunks whose cached meshes are read ahead per frame, those coming into view soonest
+	// first; 0 reads them only when they are meshed
+	int prefetch;
+
+	RenderBudget() : distance(1e9f), generate(1), mesh(1 << 30), prefetch(MESH_CACHE::PREFETCH) {}
+};
+
+// When World::updateStorage moves chunks between the ChunkStorage forms. Chunks near the
+// camera or changed lately are hot and kept dense; the rest are run-length encoded, and
+// far ones held as generation plus diff or in the shared DAG. The defaults come from WORLD.
+struct StoragePolicy {
+	// Distance from the camera, in blocks, within which chunks are hot
+	float hotDistance;
+	// Frames after a change that a chunk stays hot
+	int hotFrames;
+	// Distance past which cold chunks go to the smallest form
+	float farDistance;
+	// Chunks converted per frame; 0 leaves storage alone
+	int budget;
+
+	StoragePolicy() : hotDistance((float)WORLD::COMPACT_DISTANCE * CHUNK::X), hotFrames(WORLD::HOT_FRAMES),
+		farDistance((float)WORLD::FAR_DISTANCE * CHUNK::X), budget(WORLD::COMPACT_DISTANCE ? WORLD::COMPACT_BUDGET : 0) {}
+};
+
+// Chunks and the memory their blocks take up in each ChunkStorage form. The DAG's bytes
+// are its shared nodes.
+struct StorageStats {
+	int chunks[4];
+	size_t bytes[4];
+};
 
 class World
 {
 public:
 	World();
+	World(time_t seed);
 	~World();
 	uint8_t getBlock(int x, int y, int z) const;
 	void setBlock(int x, int y, int z, uint8_t type);
 	void render(const glm::mat4 &pv);
+	void schedule(const glm::vec3 &eye, const glm::vec3 &forward, const glm::vec3 &velocity);
+	bool isLoading(int cx, int cy, int cz) const;
+	void updateStorage(const glm::vec3 &eye);
+	void setStoragePolicy(const StoragePolicy &policy);
+	const StoragePolicy &getStoragePolicy() const;
+	StorageStats getStorageStats() const;
+	void setMemoryLimits(const MemoryLimits &limits);
+	const MemoryStats &getMemoryStats() const;
+	Chunk *getChunk(int cx, int cy, int cz) const;
+	Chunk *findChunk(int x, int y, int z) const;
+	static bool locate(int x, int y, int z, int *cx, int *cy, int *cz);
+	void generate(Chunk *chunk);
+	void load(int cx, int cy, int cz, const uint8_t *blocks);
+	void setClient(ChunkClient *client);
+	void setMeshCache(MeshCache *cache);
+	int getHeight(int x, int z) const;
+	void getHeights(int x, int z, int width, int depth, int *heights) const;
+	void updateHeight(int x, int y, int z, uint8_t type);
+	time_t getSeed() const;
+	void setHeadless(bool headless);
+	void setPulling(bool pulling);
+	const FrameStats &getStats() const;
+	void setBudget(const RenderBudget &budget);
+	const RenderBudget &getBudget() const;
 private:
+	friend class BlockAccessor;
+
+	void init();
+	void edited(int cx, int cy, int cz, int x, int y, int z, uint8_t type);
+	void rescanHeight(int x, int z, int top);
+	void updateTiers(const glm::vec3 &eye);
+	bool isVisible(const glm::mat4 &pv, Chunk *chunk, float *distance, float margin = 0) const;
+	void prefetchMeshes(const glm::mat4 &pv);
+
 	Chunk *_chunk[WORLD::X][WORLD::Y][WORLD::Z];
+	// Highest non-air block of every column, WORLD::NO_SURFACE if there is none
+	short _height[WORLD::X * CHUNK::X][WORLD::Z * CHUNK::Z];
+	VoxelDAG _dag;
+	StoragePolicy _policy;
+	// Calls to updateTiers so far, and for each chunk the version it last saw and the
+	// call it saw it change in
+	uint32_t _storageFrame;
+	uint32_t _seenVersion[WORLD::X][WORLD::Y][WORLD::Z];
+	uint32_t _changedAt[WORLD::X][WORLD::Y][WORLD::Z];
+	MemoryBudget _memory;
 	time_t _seed;
+	bool _headless;
+	// Meshes are uploaded as packed faces
+	bool _pulling;
+	// Where chunks come from when they aren't generated here
+	ChunkClient *_client;
+	// Where meshes are looked up before chunks are meshed, if anywhere
+	MeshCache *_meshCache;
+	// How far schedule() expects the camera to move in the next MESH_CACHE::LOOKAHEAD
+	// seconds, and per chunk the mesh cache key of its blocks and the version it was taken
+	// at, plus one
+	glm::vec3 _heading;
+	uint64_t _meshKey[WORLD::X][WORLD::Y][WORLD::Z];
+	uint32_t _keyVersion[WORLD::X][WORLD::Y][WORLD::Z];
+	FrameStats _stats;
+	RenderBudget _budget;
+	ChunkScheduler _scheduler;
+	std::vector<byte4> _vertices;
 };
 
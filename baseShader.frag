@@ -1,5 +1,7 @@
 varying vec4 texcoord;
 uniform sampler2D texture;
+// Tiles across the texture atlas
+uniform float tiles;
 
 const vec4 fogcolor = vec4(0.6, 0.8, 1.0, 1.0);
 const float fogdensity = .00005;
@@ -8,11 +10,12 @@ void main(void) {
 	vec2 coord2d;
 	float intensity;
 
+	// Top and bottom faces have their tile offset by -128
 	if(texcoord.w < 0.0) {
-		coord2d = vec2((fract(texcoord.x) + texcoord.w) / 16.0, texcoord.z);
+		coord2d = vec2((fract(texcoord.x) + texcoord.w + 128.0) / tiles, texcoord.z);
 		intensity = 1.0;
 	} else {
-		coord2d = vec2((fract(texcoord.x + texcoord.z) + texcoord.w) / 16.0, -texcoord.y);
+		coord2d = vec2((fract(texcoord.x + texcoord.z) + texcoord.w) / tiles, -texcoord.y);
 		intensity = 0.85;
 	}
 	
@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <time.h>
+#include <string>
+#include <chrono>
+#include <thread>
 
 #include <GL/glew.h>
 #include <GL/glut.h>
@@ -13,11 +17,37 @@
 #include "../common/shader_utils.h"
 #include "textures.c"
 #include "World.h"
+#include "BlockRegistry.h"
+#include "BlockTicker.h"
+#include "ChunkClient.h"
+#include "ChunkServer.h"
+#include "EditJournal.h"
+#include "FrameGovernor.h"
+#include "MeshCache.h"
+#include "Physics.h"
+#include "Replay.h"
+#include "Offscreen.h"
+#include "PngWriter.h"
+#include "Raymarcher.h"
+#include "Benchmark.h"
+#include "Timer.h"
+
+namespace PROGRAM {
+	GLint attribute_coord;
+	GLint uniform_mvp;
+}
 
 static GLuint program;
+static GLint program_mvp;
+// Draws chunks from packed faces instead of vertices, with --pull
+static GLuint pull_program;
+static GLint pull_mvp;
+static bool pull;
 static GLuint texture;
 static GLint uniform_texture;
+static GLint uniform_tiles;
 static GLuint cursor_vbo;
+static GLuint timer_query;
 
 static glm::vec3 position;
 static glm::vec3 forward;
@@ -25,16 +55,39 @@ static glm::vec3 right;
 static glm::vec3 up;
 static glm::vec3 lookat;
 static glm::vec3 angle;
+// How fast the camera moved over the last frame, in blocks per second
+static glm::vec3 velocity;
 
 static int ww, wh;
 static int mx, my, mz;
 static int face;
 
 static unsigned int keys;
+// Chunk memory limits, the total set with --memory
+static MemoryLimits memory_limits;
 
 #define M_PI 3.1415926535
 
 static World *world;
+static ThreadPool *pool;
+static BlockTicker *ticker;
+static Physics *physics;
+
+static EditJournal *journal;
+static const char *world_name;
+// Meshes of the saved world from earlier sessions, in <world_name>.meshes
+static MeshCache *mesh_cache;
+
+static ChunkClient *client;
+
+static FrameGovernor *governor;
+static double frame_start;
+
+static ReplayRecorder *recorder;
+static Replay *replay;
+static size_t replay_frame;
+static double replay_start;
+static bool offscreen;
 
 static void update_vectors() {
 	forward.x = sinf(angle.x);
@@ -52,6 +105,130 @@ static void update_vectors() {
 	up = glm::cross(right, lookat);
 }
 
+static void init_world() {
+	// A replay has to see the same terrain it was recorded in, a saved world its own and
+	// a connected client the server's
+	time_t seed = replay ? replay->seed : client ? client->getSeed() : time(0);
+	if (world_name && !replay) {
+		journal = new EditJournal;
+		if (!journal->open(world_name, &seed)) {
+			delete journal;
+			journal = 0;
+		}
+	}
+
+	world = new World(seed);
+	world->setClient(client);
+	if (world_name) {
+		mesh_cache = new MeshCache;
+		if (mesh_cache->open((std::string(world_name) + ".meshes").c_str()))
+			world->setMeshCache(mesh_cache);
+	}
+	world->setMemoryLimits(memory_limits);
+	if (journal) {
+		double t = now_ms();
+		int edits = journal->replay(world);
+		fprintf(stderr, "loaded %s with %d journaled edits in %.1f ms\n", world_name, edits, now_ms() - t);
+	}
+
+	pool = new ThreadPool;
+	// The server's world doesn't tick, and a client ticking its copy alone would drift
+	// from it and from the other clients, so water and sand only move offline
+	if (!client)
+		ticker = new BlockTicker(world, pool);
+	physics = new Physics(world, pool);
+
+	// Start just above the ground
+	for (int y = 0; y < WORLD::Y; ++y) {
+		if (client)
+			client->request(WORLD::X / 2, y, WORLD::Z / 2);
+		else
+			world->generate(world->findChunk(0, (y - WORLD::Y / 2) * CHUNK::Y, 0));
+	}
+	double deadline = now_ms() + 5000;
+	while (client && client->getPending() && now_ms() < deadline)
+		client->poll(world, 10);
+	position = glm::vec3(0.5f, world->getHeight(0, 0) + 2.5f, 0.5f);
+	angle = glm::vec3(0, -0.5, 0);
+	update_vectors();
+}
+
+static glm::mat4 view_matrix() {
+	return glm::lookAt(position, position + lookat, up);
+}
+
+static glm::mat4 projection_matrix() {
+	return glm::perspective(45.0f, 1.0f*ww / wh, 0.01f, 1000.0f);
+}
+
+// gpu is the GPU time of the frame in milliseconds, 0 when it wasn't measured. The
+// governor columns are 0 when there is no governor; the budget is the world's either way.
+static void print_frame_stats(size_t frame, double gpu) {
+	const FrameStats &stats = world->getStats();
+	const MemoryStats &memory = world->getMemoryStats();
+	const RenderBudget &budget = world->getBudget();
+	GovernorStats governed;
+	memset(&governed, 0, sizeof(governed));
+	if (governor)
+		governed = governor->getStats();
+
+	if (frame == 0)
+		printf("frame,generate_ms,mesh_ms,upload_ms,draw_ms,gpu_ms,chunks,draw_calls,vertices,generated,meshed,deferred,voxel_kb,mesh_kb,mesh_evictions,voxel_evictions,"
+			"budget_distance,budget_generate,budget_mesh,governor_average_ms,governor_sleep_ms,budget_cuts,budget_raises\n");
+	printf("%u,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%d,%d,%d,%u,%u,%d,%d,%.0f,%d,%d,%.3f,%.3f,%d,%d\n", (unsigned)frame, stats.generate, stats.mesh, stats.upload, stats.draw, gpu,
+		stats.chunks, stats.drawCalls, stats.vertices, stats.generated, stats.meshed, stats.deferred,
+		(unsigned)(memory.voxels >> 10), (unsigned)(memory.meshes >> 10), memory.meshEvictions, memory.voxelEvictions,
+		budget.distance, budget.generate, budget.mesh, governed.average, governed.sleep, governed.cuts, governed.raises);
+}
+
+// Moves the camera to the next recorded frame and applies the edits that came before it.
+// Returns false when the recording is over.
+static bool play_frame() {
+	if (replay_frame >= replay->frames.size())
+		return false;
+
+	const ReplayFrame &frame = replay->frames[replay_frame];
+	for (size_t i = 0; i < frame.edits.size(); ++i) {
+		const ReplayEdit &edit = frame.edits[i];
+		world->setBlock(edit.x, edit.y, edit.z, edit.type);
+		if (ticker)
+			ticker->activate(edit.x, edit.y, edit.z);
+	}
+
+	if (ticker)
+		ticker->update(frame.dt);
+	if (frame.dt > 0)
+		velocity = (frame.position - position) / frame.dt;
+	position = frame.position;
+	world->updateStorage(position);
+	angle = frame.angle;
+	update_vectors();
+	return true;
+}
+
+static void finish_replay() {
+	fprintf(stderr, "replayed %u frames in %.1f ms\n", (unsigned)replay_frame, now_ms() - replay_start);
+}
+
+// Runs a recording without a window. Generation and meshing happen as usual, GL work is skipped.
+static int run_headless_replay() {
+	init_world();
+	world->setHeadless(true);
+	replay_start = now_ms();
+
+	ww = WINDOW::WIDTH;
+	wh = WINDOW::HEIGHT;
+
+	while (play_frame()) {
+		world->schedule(position, lookat, velocity);
+		world->render(projection_matrix() * view_matrix());
+		print_frame_stats(replay_frame++, 0);
+	}
+
+	finish_replay();
+	return 0;
+}
+
 static int init_resources() {
 	program = create_program("baseShader.vert", "baseShader.frag");
 
@@ -59,7 +236,8 @@ static int init_resources() {
 		return 0;
 
 	PROGRAM::attribute_coord = get_attrib(program, "coord");
-	PROGRAM::uniform_mvp = get_uniform(program, "mvp");
+	PROGRAM::uniform_mvp = program_mvp = get_uniform(program, "mvp");
+	uniform_tiles = get_uniform(program, "tiles");
 
 	if (PROGRAM::attribute_coord == -1 || PROGRAM::uniform_mvp == -1)
 		return 0;
@@ -73,18 +251,37 @@ static int init_resources() {
 	glGenerateMipmap(GL_TEXTURE_2D);
 
 
-	world = new World;
-
-	position = glm::vec3(0, CHUNK::Y + 1, 0);
-	angle = glm::vec3(0, -0.5, 0);
-	update_vectors();
+	init_world();
 
 
 	glGenBuffers(1, &cursor_vbo);
 
+	// GPU timings are only read back when frames are being measured, since waiting for them stalls
+	if (GLEW_ARB_timer_query && (replay || offscreen))
+		glGenQueries(1, &timer_query);
+
+
+	if (pull) {
+		if (!GLEW_VERSION_3_1) {
+			fprintf(stderr, "No support for OpenGL 3.1 found, which vertex pulling needs\n");
+			return 0;
+		}
+
+		pull_program = create_program("pullShader.vert", "baseShader.frag");
+		if (pull_program == 0)
+			return 0;
+		pull_mvp = get_uniform(pull_program, "mvp");
+
+		glUseProgram(pull_program);
+		glUniform1i(get_uniform(pull_program, "texture"), 0);
+		glUniform1i(get_uniform(pull_program, "faces"), 1);
+		glUniform1f(get_uniform(pull_program, "tiles"), (float)(textures.width / textures.height));
+		world->setPulling(true);
+	}
 
 	glUseProgram(program);
 	glUniform1i(uniform_texture, 0);
+	glUniform1f(uniform_tiles, (float)(textures.width / textures.height));
 	glClearColor(0.6, 0.8, 1.0, 0.0);
 	glEnable(GL_CULL_FACE);
 
@@ -104,6 +301,18 @@ static void reshape(int w, int h) {
 	glViewport(0, 0, w, h);
 }
 
+// Makes the program that draws chunks current, or with pulling false the one that draws
+// vertices, which the cursor also uses.
+static void use_program(bool pulling) {
+	glUseProgram(pulling ? pull_program : program);
+	PROGRAM::uniform_mvp = pulling ? pull_mvp : program_mvp;
+	// Pulled faces have no vertex attributes
+	if (pulling)
+		glDisableVertexAttribArray(PROGRAM::attribute_coord);
+	else
+		glEnableVertexAttribArray(PROGRAM::attribute_coord);
+}
+
 static float fract(float value) {
 	float f = value - floorf(value);
 	if (f > 0.5)
@@ -112,21 +321,46 @@ static float fract(float value) {
 		return f;
 }
 
-static void display() {
-	glm::mat4 view = glm::lookAt(position, position + lookat, up);
-	glm::mat4 projection = glm::perspective(45.0f, 1.0f*ww / wh, 0.01f, 1000.0f);
-
-	glm::mat4 mvp = projection * view;
-
+// Clears the frame and draws the world. Returns the GPU time that took in milliseconds,
+// or 0 when it isn't being measured.
+static double render_world(const glm::mat4 &mvp) {
+	if (pull_program)
+		use_program(true);
 	glUniformMatrix4fv(PROGRAM::uniform_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_POLYGON_OFFSET_FILL);
 
+	if (timer_query)
+		glBeginQuery(GL_TIME_ELAPSED, timer_query);
 
+	world->schedule(position, lookat, velocity);
 	world->render(mvp);
 
+	if (pull_program)
+		use_program(false);
+
+	if (!timer_query)
+		return 0;
+
+	GLuint64 elapsed = 0;
+	glEndQuery(GL_TIME_ELAPSED);
+	glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &elapsed);
+	return elapsed * 1.0e-6;
+}
+
+static void display() {
+	glm::mat4 view = view_matrix();
+	glm::mat4 projection = projection_matrix();
+
+	glm::mat4 mvp = projection * view;
+
+	double gpu = render_world(mvp);
+
+	if (replay)
+		print_frame_stats(replay_frame++, gpu);
+
 
 	//Find block at the center of the window
 
@@ -212,7 +446,19 @@ static void display() {
 	glVertexAttribPointer(PROGRAM::attribute_coord, 4, GL_FLOAT, GL_FALSE, 0, 0);
 	glDrawArrays(GL_LINES, 0, 24);
 
+	// Adjust the budget to how long this frame took, then sleep off the time left over
+	if (governor) {
+		governor->frame(now_ms() - frame_start);
+		world->setBudget(governor->getBudget());
+	}
+
 	glutSwapBuffers();
+
+	if (governor) {
+		double sleep = governor->sleep(now_ms() - frame_start);
+		if (sleep > 0)
+			std::this_thread::sleep_for(std::chrono::microseconds((long long)(sleep * 1000)));
+	}
 }
 
 static void keyboardPress(unsigned char key, int x, int y) {
@@ -280,23 +526,54 @@ static void specialkey(int key, int x, int y) {
 static void idle() {
 	static int pt = 0;
 	static const float movespeed = 10;
+	static const glm::vec3 camera_size(0.3f, 0.3f, 0.3f);
 
 	int t = glutGet(GLUT_ELAPSED_TIME);
 	float dt = (t - pt) * 1.0e-3;
 	pt = t;
+	frame_start = now_ms();
+
+	// A replay drives the camera instead of the input
+	if (replay) {
+		if (!play_frame()) {
+			finish_replay();
+			exit(0);
+		}
+		glutPostRedisplay();
+		return;
+	}
+
+	glm::vec3 move(0, 0, 0);
 
 	if (keys & 1)
-		position += forward * movespeed * dt;
+		move += forward * movespeed * dt;
 	if (keys & 2)
-		position -= right * movespeed * dt;
+		move -= right * movespeed * dt;
 	if (keys & 4)
-		position -= forward * movespeed * dt;
+		move -= forward * movespeed * dt;
 	if (keys & 8)
-		position += right * movespeed * dt;
+		move += right * movespeed * dt;
 	if (keys & 16)
-		position.y += movespeed * dt;
+		move.y += movespeed * dt;
 	if (keys & 32)
-		position.y -= movespeed * dt;
+		move.y -= movespeed * dt;
+
+	// Don't fly through terrain
+	glm::vec3 last = position;
+	position = physics->move(position, camera_size, move);
+	if (dt > 0)
+		velocity = (position - last) / dt;
+	world->updateStorage(position);
+
+	if (ticker)
+		ticker->update(dt);
+
+	if (recorder)
+		recorder->frame(dt, position, angle);
+	if (journal)
+		journal->update(world);
+	if (client)
+		client->poll(world, 0);
 
 	glutPostRedisplay();
 }
@@ -305,6 +582,9 @@ static void motion(int x, int y) {
 	static bool warp = false;
 	static const float mousespeed = 0.001;
 
+	if (replay)
+		return;
+
 	if (!warp) {
 		angle.x -= (x - ww / 2) * mousespeed;
 		angle.y -= (y - wh / 2) * mousespeed;
@@ -329,7 +609,7 @@ static void motion(int x, int y) {
 }
 
 static void mouse(int button, int state, int x, int y) {
-	if (state != GLUT_DOWN)
+	if (state != GLUT_DOWN || replay)
 		return;
 
 	if (button == 0) {
@@ -346,18 +626,240 @@ static void mouse(int button, int state, int x, int y) {
 		if (face == 5)
 			mz--;
 		world->setBlock(mx, my, mz, 6);
+		if (recorder)
+			recorder->edit(mx, my, mz, 6);
+		if (journal)
+			journal->append(mx, my, mz, 6);
+		if (client)
+			client->edit(mx, my, mz, 6);
 	}
 	else {
 		world->setBlock(mx, my, mz, 0);
+		if (recorder)
+			recorder->edit(mx, my, mz, 0);
+		if (journal)
+			journal->append(mx, my, mz, 0);
+		if (client)
+			client->edit(mx, my, mz, 0);
 	}
+
+	// Let water and sand around the edit react to it
+	if (ticker)
+		ticker->activate(mx, my, mz);
 }
 
 static void free_resources() {
+	delete physics;
+	delete ticker;
+	delete pool;
+	// Saving may still be running in the background; let it finish before the world goes
+	delete journal;
 	delete world;
+	delete mesh_cache;
+	delete client;
+	delete governor;
+	delete recorder;
+	delete replay;
 	glDeleteProgram(program);
+	if (pull_program)
+		glDeleteProgram(pull_program);
+}
+
+// Renders into an offscreen framebuffer instead of a window, either a replay or frames
+// frames from the start position, and saves each frame as <capture>NNNN.png if given.
+static int run_offscreen(int frames, const char *capture) {
+	Offscreen target;
+	if (!target.create(WINDOW::WIDTH, WINDOW::HEIGHT))
+		return 1;
+
+	ww = WINDOW::WIDTH;
+	wh = WINDOW::HEIGHT;
+	if (!init_resources())
+		return 1;
+
+	replay_start = now_ms();
+
+	for (size_t frame = 0; replay ? play_frame() : frame < (size_t)frames; ++frame) {
+		if (!replay) {
+			if (ticker)
+				ticker->update(1.0f / 60);
+			world->updateStorage(position);
+		}
+		if (client)
+			client->poll(world, 0);
+
+		double gpu = render_world(projection_matrix() * view_matrix());
+		print_frame_stats(frame, gpu);
+
+		if (capture) {
+			char number[16];
+			sprintf(number, "%04u.png", (unsigned)frame);
+			if (!target.capture((std::string(capture) + number).c_str()))
+				fprintf(stderr, "Error: could not write frame %u\n", (unsigned)frame);
+		}
+
+		if (replay)
+			++replay_frame;
+	}
+
+	if (replay)
+		finish_replay();
+
+	free_resources();
+	return 0;
+}
+
+// Writes a top-down map of the whole world and a view from the start position as PNG
+// images, raymarched on the CPU, so no window or GL context is needed.
+static int run_thumbnails(const char *map_file, const char *view_file) {
+	init_world();
+	for (int x = 0; x < WORLD::X; ++x)
+		for (int y = 0; y < WORLD::Y; ++y)
+			for (int z = 0; z < WORLD::Z; ++z)
+				world->generate(world->getChunk(x, y, z));
+
+	Raymarcher raymarcher(world, pool);
+	std::vector<uint8_t> rgba;
+	int result = 0;
+
+	if (map_file) {
+		float half = (float)CHUNK::X * (WORLD::X / 2);
+		raymarcher.renderMap(-half, -half, 2 * half, 512, rgba);
+		if (!write_png(map_file, 512, 512, &rgba[0], false)) {
+			fprintf(stderr, "Error: could not write %s\n", map_file);
+			result = 1;
+		}
+	}
+
+	if (view_file) {
+		raymarcher.renderView(position, position + lookat, 45.0f * (float)M_PI / 180, WINDOW::WIDTH, WINDOW::HEIGHT, rgba);
+		if (!write_png(view_file, WINDOW::WIDTH, WINDOW::HEIGHT, &rgba[0], false)) {
+			fprintf(stderr, "Error: could not write %s\n", view_file);
+			result = 1;
+		}
+	}
+
+	return result;
+}
+
+// Runs a world server without a window: it generates chunks as clients ask for them and
+// passes edits between clients, until it is killed.
+static int run_server(int port) {
+	World server_world(time(0));
+	ChunkServer server(&server_world);
+	if (!server.listen(port))
+		return 1;
+	printf("serving seed %lld on port %d\n", (long long)server_world.getSeed(), server.getPort());
+
+	double report = now_ms() + 10000;
+	for (;;) {
+		server.serve(10);
+		if (now_ms() > report) {
+			printf("%d clients, %llu chunks and %llu edits sent\n", server.getClients(),
+				(unsigned long long)server.getChunksSent(), (unsigned long long)server.getEditsSent());
+			report += 10000;
+		}
+	}
 }
 
 int main(int argc, char* argv[]) {
+	// Block types come from blocks.txt next to the shaders; without it the built-in ones stay
+	BlockRegistry::get().load("blocks.txt");
+
+	if (argc > 1 && !strcmp(argv[1], "--bench"))
+		return run_benchmark(argc - 2, argv + 2);
+
+	// --record <file> saves the camera path and edits, --replay <file> plays them back
+	// and prints per-frame timings; add --headless to replay without a window.
+	// --offscreen renders without a window into a framebuffer, the replay if there is one,
+	// otherwise --frames <n> frames; --capture <prefix> saves them as PNG images.
+	// --map <file> and --screenshot <file> raymarch a map and a view on the CPU instead.
+	// --world <name> loads and saves block edits in <name>.world and <name>.journal.*,
+	// and keeps chunk meshes between sessions in <name>.meshes.
+	// --server [port] runs a headless world server, --connect <host>[:port] plays in its
+	// world, which is then streamed from it; water and sand don't move while connected.
+	// --target <ms> is the frame time the window aims for, 0 to draw as fast as possible;
+	// a replay in a window only aims for it when given, to log what the governor does.
+	// --pull draws chunks from packed faces expanded in the vertex shader; needs OpenGL 3.1.
+	// --memory <MB> limits the memory of chunk voxels and meshes, evicting the least
+	// recently used beyond it.
+	const char *record_file = 0;
+	const char *capture = 0;
+	const char *map_file = 0;
+	const char *view_file = 0;
+	int frames = 1;
+	double target = GOVERNOR::TARGET_MS;
+	bool targeted = false;
+	bool headless = false;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+			record_file = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+			replay = new Replay;
+			if (!replay->load(argv[++i])) {
+				fprintf(stderr, "Error: could not read replay %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "--headless")) {
+			headless = true;
+		}
+		else if (!strcmp(argv[i], "--offscreen")) {
+			offscreen = true;
+		}
+		else if (!strcmp(argv[i], "--pull")) {
+			pull = true;
+		}
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+			capture = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--world") && i + 1 < argc) {
+			world_name = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+			map_file = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--screenshot") && i + 1 < argc) {
+			view_file = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--memory") && i + 1 < argc) {
+			memory_limits.total = (size_t)atoi(argv[++i]) << 20;
+		}
+		else if (!strcmp(argv[i], "--target") && i + 1 < argc) {
+			target = atof(argv[++i]);
+			targeted = true;
+		}
+		else if (!strcmp(argv[i], "--server")) {
+			return run_server(i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1]) : NET::PORT);
+		}
+		else if (!strcmp(argv[i], "--connect") && i + 1 < argc) {
+			std::string host = argv[++i];
+			int port = NET::PORT;
+			size_t colon = host.find(':');
+			if (colon != std::string::npos) {
+				port = atoi(host.c_str() + colon + 1);
+				host.resize(colon);
+			}
+
+			client = new ChunkClient;
+			if (!client->connect(host.c_str(), port))
+				return 1;
+		}
+	}
+
+	if (map_file || view_file)
+		return run_thumbnails(map_file, view_file);
+
+	if (replay && headless)
+		return run_headless_replay();
+	if (offscreen)
+		return run_offscreen(frames, capture);
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
 	glutInitWindowSize(WINDOW::WIDTH, WINDOW::HEIGHT);
@@ -375,6 +877,20 @@ int main(int argc, char* argv[]) {
 	}
 
 	if (init_resources()) {
+		if (record_file) {
+			recorder = new ReplayRecorder;
+			if (!recorder->open(record_file, world->getSeed())) {
+				fprintf(stderr, "Error: could not write %s\n", record_file);
+				return 1;
+			}
+		}
+		if (replay)
+			replay_start = now_ms();
+		// Replays are measured, so they run unthrottled with the default budget unless a
+		// target was asked for
+		if (target > 0 && (!replay || targeted))
+			governor = new FrameGovernor(target);
+
 		glutSetCursor(GLUT_CURSOR_NONE);
 		glutWarpPointer(WINDOW::WIDTH / 2, WINDOW::HEIGHT / 2);
 		glutDisplayFunc(display);
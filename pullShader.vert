@@ -0,0 +1,28 @@
+#version 140
+
+// Vertex pulling: there are no vertex attributes, each face of a chunk is a 32-bit record
+// in the buffer texture faces, packed by ChunkShape::pack, and its six vertices are
+// expanded here from gl_VertexID.
+uniform usamplerBuffer faces;
+uniform mat4 mvp;
+out vec4 texcoord;
+
+const vec2 corners[6] = vec2[6](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(1, 1), vec2(0, 1), vec2(0, 0));
+
+void main(void) {
+	uint face = texelFetch(faces, gl_VertexID / 6).r;
+	vec3 block = vec3(float(face & 127u), float((face >> 7) & 127u), float((face >> 14) & 127u));
+	int orientation = int((face >> 21) & 7u);
+	float tile = float((face >> 24) & 127u);
+	vec2 corner = corners[gl_VertexID % 6];
+
+	// Front, back; top, bottom; left, right, as in ChunkShape::unpack
+	if (orientation < 2)
+		texcoord = vec4(block + vec3(corner, float(orientation)), tile);
+	else if (orientation < 4)
+		texcoord = vec4(block + vec3(corner.x, float(orientation == 2), corner.y), tile - 128.0);
+	else
+		texcoord = vec4(block + vec3(float(orientation == 5), corner.y, corner.x), tile);
+
+	gl_Position = mvp * vec4(texcoord.xyz, 1);
+}
\ No newline at end of file